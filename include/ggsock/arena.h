@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <new>
+#include <scoped_allocator>
+#include <string>
+#include <vector>
+
+namespace GGSock {
+    // Monotonic allocator - allocations are bumped from large blocks and released all at once by reset() or when
+    // the arena is destroyed. Meant for decoding large messages into the Arena* containers below.
+    // Not thread-safe.
+    class Arena {
+        public:
+            // blocks of at least blockSize_bytes are taken from the heap as needed
+            Arena(size_t blockSize_bytes = 64*1024);
+            ~Arena();
+
+            Arena(const Arena & ) = delete;
+            Arena & operator=(const Arena & ) = delete;
+
+            void * allocate(size_t nBytes, size_t alignment);
+
+            // everything allocated from the arena is released - containers using it must not be used afterwards
+            // the first block is kept for reuse
+            void reset();
+
+            size_t getNumBytesAllocated() const;
+            size_t getNumBytesReserved() const;
+
+        private:
+            struct Data;
+            std::unique_ptr<Data> data_;
+            Data & getData() { return *data_; }
+            const Data & getData() const { return *data_; }
+    };
+
+    // allocates from the arena it was constructed with - memory is never freed individually
+    // converts implicitly from Arena &, so the containers below are constructed as e.g. ArenaVector<int> v(arena)
+    template <typename T>
+    class ArenaAllocator {
+        public:
+            using value_type = T;
+
+            using propagate_on_container_copy_assignment = std::true_type;
+            using propagate_on_container_move_assignment = std::true_type;
+            using propagate_on_container_swap = std::true_type;
+
+            ArenaAllocator(Arena & arena) : arena(&arena) {}
+
+            template <typename U>
+            ArenaAllocator(const ArenaAllocator<U> & other) : arena(other.getArena()) {}
+
+            T * allocate(size_t n) {
+                return static_cast<T *>(arena->allocate(n*sizeof(T), alignof(T)));
+            }
+
+            void deallocate(T * , size_t ) {
+            }
+
+            Arena * getArena() const { return arena; }
+
+        private:
+            Arena * arena;
+    };
+
+    template <typename T, typename U>
+    bool operator==(const ArenaAllocator<T> & a, const ArenaAllocator<U> & b) { return a.getArena() == b.getArena(); }
+
+    template <typename T, typename U>
+    bool operator!=(const ArenaAllocator<T> & a, const ArenaAllocator<U> & b) { return a.getArena() != b.getArena(); }
+
+    // same wire format as the std containers
+    // the vector and the map pass their arena to the elements they construct, so nested Arena* containers, such as
+    // the ones Unserialize creates, allocate from the same arena
+    using ArenaString = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+
+    template <typename T>
+    using ArenaVector = std::vector<T, std::scoped_allocator_adaptor<ArenaAllocator<T>>>;
+
+    template <typename Key, typename Value>
+    using ArenaMap = std::map<Key, Value, std::less<Key>, std::scoped_allocator_adaptor<ArenaAllocator<std::pair<const Key, Value>>>>;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "ggsock/serialization.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace GGSock {
+namespace BufferPool {
+    // Process-wide pool of buffers in power-of-two size classes from 64 B to 1 MiB, with a small cache per thread
+    // in front of it. Used for frames and receive buffers - applications can use it to build payloads as well.
+
+    // returns an empty buffer with capacity() >= nBytes
+    SerializationBuffer acquire(size_t nBytes);
+
+    // the buffer is left empty. buffers with capacity outside of the pooled size classes are freed
+    void release(std::vector<char> & buffer);
+
+    // capacity of the buffers kept in the shared pool, not counting the per-thread caches
+    // a buffer can be up to twice the size of its class, so this is the memory held rather than the class sizes
+    size_t getNumBytesCached();
+}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "ggsock/communicator.h"
+
+#include <memory>
+
+namespace GGSock {
+    // Sends the same message to many connections.
+    // The frame is encoded once and the buffer is shared by the send queues of all members. It is released after
+    // the slowest member has sent it.
+    class CommunicatorGroup {
+        public:
+            using TCommunicator = std::shared_ptr<Communicator>;
+
+            // what to do with a member whose send queue is full
+            enum class SlowConsumerPolicy {
+                Drop,       // skip the message for this member
+                Disconnect, // disconnect the member
+                Block,      // wait for room in the queue, up to blockTimeout_ms, then drop
+            };
+
+            struct Parameters {
+                SlowConsumerPolicy policy = SlowConsumerPolicy::Drop;
+
+                // Block only - the members have to be updated by their own worker or by another thread
+                int32_t blockTimeout_ms = 100;
+            };
+
+            struct Stats {
+                uint64_t nFramesEncoded = 0;
+                uint64_t nMessagesQueued = 0;
+                uint64_t nMessagesDropped = 0;
+                uint64_t nDisconnects = 0;
+                uint64_t nBlocks = 0;
+            };
+
+            CommunicatorGroup();
+            CommunicatorGroup(const Parameters & parameters);
+            ~CommunicatorGroup();
+
+            bool add(const TCommunicator & communicator);
+            bool remove(const TCommunicator & communicator);
+            void clear();
+            int32_t size() const;
+
+            // return the number of members the message was queued to
+            // members that are not connected are skipped
+            int32_t send(Communicator::TMessageType type);
+            int32_t send(Communicator::TMessageType type, const char * dataBuffer, Communicator::TBufferSize dataSize);
+            int32_t send(const Communicator::TSharedFrame & frame);
+
+            Stats getStats() const;
+
+        private:
+            struct Data;
+            std::unique_ptr<Data> data_;
+            Data & getData() { return *data_; }
+            const Data & getData() const { return *data_; }
+    };
+}
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "ggsock/common.h"
+#include "ggsock/buffer-pool.h"
+#include "ggsock/rate-limiter.h"
+#include "ggsock/serialization.h"
 
 #include <memory>
 #include <functional>
@@ -9,35 +12,208 @@ namespace GGSock {
     class Communicator {
         public:
             using TErrorCode = int16_t;
-            using TBufferSize = uint32_t;
+            using TBufferSize = uint64_t;
             using TMessageType = uint16_t;
 
+            // an encoded frame that can be queued to many connections without copying
+            using TSharedFrame = std::shared_ptr<const std::string>;
+
             using CBError = std::function<void(TErrorCode errorCode)>;
+            using CBConnect = std::function<void()>;
+            using CBSendQueue = std::function<void()>;
             using CBMessage = std::function<uint16_t(const char * dataBuffer, TBufferSize dataSize)>;
 
+            // message types >= MsgReserved are used internally and are never passed to the message callbacks
+            enum ReservedMessageType : TMessageType {
+                MsgReserved = 0xFF00,
+            };
+
+            // reported through the error callback, in addition to the socket error codes
+            enum ErrorCode : TErrorCode {
+                ErrorSessionLost   = -1,  // the peer could not resume the session - application state has to be resynchronized
+                ErrorChecksum      = -2,  // a frame failed the integrity check - the connection is dropped
+                ErrorDecompression = -3,  // a compressed frame could not be decoded - the connection is dropped
+                ErrorIdleTimeout   = -4,  // nothing was received within the idle timeout - the connection is dropped
+                ErrorFrameSize     = -5,  // a frame header is malformed or exceeds the max message size - the connection is dropped
+                ErrorFrameTooLarge = -6,  // an outgoing frame does not fit in the header negotiated with the peer - the frame is dropped
+            };
+
+            enum class WorkerMode {
+                Sleep,      // update, then sleep for 1 ms
+                BusyPoll,   // spin on the socket for an adaptive budget, then block until the socket is ready
+            };
+
+            struct WorkerParameters {
+                WorkerMode mode = WorkerMode::Sleep;
+
+                // the spin budget follows the observed message inter-arrival time within these limits
+                int32_t spinBudgetMin_us = 50;
+                int32_t spinBudgetMax_us = 2000;
+
+                // max time to block waiting for socket readiness after the spin budget is exhausted
+                int32_t idleWait_ms = 1;
+            };
+
+            // optional session layer on top of the connection
+            // frames are numbered and kept until the peer acknowledges them, so after a connection drop, only the
+            // frames that the peer did not receive are sent again. the client reconnects automatically with exponential
+            // backoff. the server resumes the session when the application starts listening again and the same client
+            // connects. both sides have to enable the session
+            struct SessionParameters {
+                int32_t reconnectBackoffMin_ms = 100;
+                int32_t reconnectBackoffMax_ms = 10000;
+                int32_t reconnectAttemptTimeout_ms = 2000;
+
+                // cumulative acknowledgements are sent after this many messages or this much time, whichever comes first
+                int32_t ackEveryMessages = 32;
+                int32_t ackInterval_ms = 50;
+
+                // unacknowledged frames beyond this size are dropped and the session cannot be resumed past them
+                int64_t maxReplayBytes = 64*1024*1024;
+            };
+
+            enum class FrameHeader {
+                Fixed,  // [u32 size, u16 type] - frames up to 4 GiB, or 1 GiB with checksum or compression
+                Varint, // varint-encoded size and type - 2-3 bytes for small messages, frames beyond 4 GiB
+            };
+
+            enum class CompressionCodec {
+                None,
+                LZ4,    // built-in, LZ4 block format
+                Zstd,   // requires GGSOCK_ZSTD
+            };
+
+            // per-message payload compression, used only if the peer enables compression as well
+            // LZ4 is always accepted when compression is enabled, zstd only if both sides were built with it
+            struct CompressionParameters {
+                CompressionCodec codec = CompressionCodec::LZ4;
+
+                // smaller messages are sent uncompressed
+                int32_t minSize_bytes = 256;
+
+                // zstd only
+                int32_t level = 3;
+            };
+
+            struct Stats {
+                uint64_t nMessagesSent = 0;
+                uint64_t nMessagesReceived = 0;
+                uint64_t nBytesSent = 0;
+                uint64_t nBytesReceived = 0;
+                uint64_t nSendsThrottled = 0;
+                uint64_t nChecksumErrors = 0;
+                uint64_t nMessagesCompressed = 0;
+                uint64_t nBytesBeforeCompression = 0;
+                uint64_t nBytesAfterCompression = 0;
+
+                // session
+                uint64_t nReconnectAttempts = 0;
+                uint64_t nReconnects = 0;
+                uint64_t nSessionResumes = 0;
+                uint64_t nFramesReplayed = 0;
+
+                // own worker only
+                uint64_t nSpins = 0;
+                uint64_t nIdleWaits = 0;
+                uint64_t tSpin_us = 0;
+                uint64_t tIdle_us = 0;
+                int32_t spinBudget_us = 0;
+
+                float getSpinRatio() const { return tSpin_us + tIdle_us > 0 ? float(tSpin_us)/(tSpin_us + tIdle_us) : 0.0f; }
+            };
+
             Communicator(bool startOwnWorker);
+            Communicator(bool startOwnWorker, const WorkerParameters & workerParameters);
             ~Communicator();
 
             bool update();
 
             bool listen(TPort port, int32_t timeout_ms, int32_t maxConnections = 1);
+
+            // timeout_ms > 0 - wait up to timeout_ms for the connection
+            // otherwise return immediately and keep connecting from update() until connected or disconnect() is called
             bool connect(const TAddress & address, TPort port, int32_t timeout_ms);
 
             bool disconnect();
             bool stopListening();
             bool isConnected() const;
             bool isConnecting() const;
+
+            // incremented for every established connection, 0 before the first one
+            // does not lock, so it can be called from the callbacks
+            uint64_t getConnectionId() const;
+
             TAddress getPeerAddress() const;
+            Stats getStats() const;
+            int32_t getNumPendingMessages() const;
+
+            // approximate heap bytes held by this connection - buffers shared with other connections are not included
+            size_t getMemoryUsage() const;
 
             bool send(TMessageType type);
             bool send(TMessageType type, const char * dataBuffer, TBufferSize dataSize);
 
+            // the frame is queued by reference and released after it has been sent
+            // shared frames are sent without checksum and compression
+            bool send(const TSharedFrame & frame);
+            bool isSendQueueFull() const;
+
+            // frame builder - beginFrame returns a pooled buffer with room for the header, followed by dataSize bytes
+            // of payload starting at getFrameDataOffset(). write the payload in place, then queue it with commitFrame,
+            // which consumes the buffer whether or not the frame is queued
+            static SerializationBuffer beginFrame(TBufferSize dataSize);
+            static size_t getFrameDataOffset();
+            bool commitFrame(TMessageType type, SerializationBuffer && frame);
+
+            // serialize obj directly into the frame
+            template <typename T>
+            bool sendSerialized(TMessageType type, const T & obj);
+
             bool setErrorCallback(CBError && callback);
             bool setMessageCallback(TMessageType type, CBMessage && callback);
 
             bool removeErrorCallback();
             bool removeMessageCallback(TMessageType type);
 
+            // called when a connection is established, both after connect() and after accepting a client
+            bool setConnectCallback(CBConnect && callback);
+            bool removeConnectCallback();
+
+            // called when the send queue has room again after it was full, e.g. to resume a blocked sender
+            bool setSendQueueCallback(CBSendQueue && callback);
+            bool removeSendQueueCallback();
+
+            // must be called while disconnected
+            bool enableSession(const SessionParameters & parameters);
+            bool disableSession();
+
+            // append a CRC32C to every frame, if the peer supports it as well
+            // must be called while disconnected
+            bool setFrameChecksum(bool enable);
+
+            // the varint header is used only if the peer enables it as well, otherwise frames keep the fixed header
+            // must be called while disconnected
+            bool setFrameHeader(FrameHeader header);
+
+            // incoming messages larger than this drop the connection with ErrorFrameSize, 4 GiB by default
+            bool setMaxMessageSize(TBufferSize maxSize_bytes);
+
+            // send a heartbeat when nothing has been sent for heartbeatInterval_ms and drop the connection when nothing
+            // has been received for idleTimeout_ms. 0 disables either. the peer's heartbeat interval has to be shorter
+            // than the idle timeout
+            bool setKeepAlive(int32_t heartbeatInterval_ms, int32_t idleTimeout_ms);
+
+            // must be called while disconnected, fails if the codec is not available in this build
+            bool setCompression(const CompressionParameters & parameters);
+
+            // limit the outgoing bandwidth of this connection, maxRate_Bps <= 0 disables the limit
+            // useKernelPacing additionally sets SO_MAX_PACING_RATE on the socket where supported
+            bool setRateLimit(RateLimiter::TRate maxRate_Bps, int64_t maxBurst_bytes = 0, bool useKernelPacing = false);
+
+            // limit the aggregate outgoing bandwidth of all Communicators sharing the limiter
+            bool setSharedRateLimiter(const std::shared_ptr<RateLimiter> & limiter);
+
+            static TSharedFrame makeSharedFrame(TMessageType type, const char * dataBuffer = nullptr, TBufferSize dataSize = 0);
             static TAddress getLocalAddress();
 
         private:
@@ -46,4 +222,20 @@ namespace GGSock {
             Data & getData() { return *data_; }
             const Data & getData() const { return *data_; }
     };
+
+    template <typename T>
+    bool Communicator::sendSerialized(TMessageType type, const T & obj) {
+        auto frame = beginFrame(SerializedSize()(obj));
+
+        // the payload is appended after the header
+        size_t offset = getFrameDataOffset();
+        frame.resize(offset);
+
+        if (Serialize()(obj, frame, offset) == false) {
+            BufferPool::release(frame);
+            return false;
+        }
+
+        return commitFrame(type, std::move(frame));
+    }
 }
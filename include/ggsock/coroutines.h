@@ -0,0 +1,589 @@
+#pragma once
+
+// C++20 coroutine interface on top of Communicator
+// header-only, so the library itself keeps building as C++14. requires a compiler with coroutine support
+
+#if defined(__cpp_impl_coroutine)
+
+#include "ggsock/communicator.h"
+#include "ggsock/serialization.h"
+#include "ggsock/timer-wheel.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace GGSock {
+namespace Co {
+    // Runs the coroutines that are ready to resume and fires the timeouts
+    // I/O completions are posted here from the Communicator workers, so the coroutines never block a worker.
+    // any number of threads can run the same scheduler
+    class Scheduler {
+        public:
+            Scheduler(int32_t tickResolution_ms = 1) : timers(tickResolution_ms) {}
+
+            void post(std::coroutine_handle<> handle) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    ready.push_back(handle);
+                }
+                cv.notify_one();
+            }
+
+            // resume the ready coroutines, waiting up to maxWait_ms for one or for the next timer,
+            // return the number of resumed coroutines
+            int32_t runOnce(int32_t maxWait_ms = 1) {
+                timers.update();
+
+                std::deque<std::coroutine_handle<>> cur;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    if (ready.empty() && isStopped == false) {
+                        int32_t wait_ms = timers.getTimeToNext_ms();
+                        if (wait_ms < 0 || wait_ms > maxWait_ms) {
+                            wait_ms = maxWait_ms;
+                        }
+                        if (wait_ms > 0) {
+                            cv.wait_for(lock, std::chrono::milliseconds(wait_ms));
+                        }
+                    }
+                }
+
+                // the timers that expired while waiting post their coroutines
+                timers.update();
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    cur.swap(ready);
+                }
+
+                for (auto & handle : cur) {
+                    handle.resume();
+                }
+
+                return (int32_t) cur.size();
+            }
+
+            // until stop() is called. sleeps until a coroutine is posted or the next timer is due
+            // timers scheduled directly on getTimers() from other threads do not wake it up, so the wait is bounded
+            void run() {
+                while (isRunning()) {
+                    runOnce(kMaxRunWait_ms);
+                }
+            }
+
+            void stop() {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    isStopped = true;
+                }
+                cv.notify_all();
+            }
+
+            bool isRunning() const {
+                std::lock_guard<std::mutex> lock(mutex);
+                return isStopped == false;
+            }
+
+            TimerWheel & getTimers() { return timers; }
+
+            // co_await scheduler.yield() - continue on the scheduler, after the coroutines that are already ready
+            auto yield() {
+                struct Awaiter {
+                    Scheduler & scheduler;
+
+                    bool await_ready() const noexcept { return false; }
+                    void await_suspend(std::coroutine_handle<> handle) { scheduler.post(handle); }
+                    void await_resume() const noexcept {}
+                };
+
+                return Awaiter { *this };
+            }
+
+            // co_await scheduler.sleep(ms)
+            auto sleep(int32_t delay_ms) {
+                struct Awaiter {
+                    Scheduler & scheduler;
+                    int32_t delay_ms;
+
+                    bool await_ready() const noexcept { return delay_ms <= 0; }
+                    void await_suspend(std::coroutine_handle<> handle) {
+                        auto & scheduler = this->scheduler;
+                        scheduler.timers.schedule(delay_ms, [&scheduler, handle]() { scheduler.post(handle); });
+                    }
+                    void await_resume() const noexcept {}
+                };
+
+                return Awaiter { *this, delay_ms };
+            }
+
+        private:
+            static constexpr int32_t kMaxRunWait_ms = 100;
+
+            TimerWheel timers;
+
+            bool isStopped = false;
+            std::deque<std::coroutine_handle<>> ready;
+
+            mutable std::mutex mutex;
+            std::condition_variable cv;
+    };
+
+    // Lazily started coroutine returning T - starts when awaited
+    template <typename T = void>
+    class Task;
+
+    namespace detail {
+        struct PromiseBase {
+            struct FinalAwaiter {
+                bool await_ready() const noexcept { return false; }
+
+                template <typename Promise>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+                    auto continuation = handle.promise().continuation;
+                    return continuation ? continuation : std::noop_coroutine();
+                }
+
+                void await_resume() const noexcept {}
+            };
+
+            std::suspend_always initial_suspend() const noexcept { return {}; }
+            FinalAwaiter final_suspend() const noexcept { return {}; }
+            void unhandled_exception() { exception = std::current_exception(); }
+
+            std::coroutine_handle<> continuation;
+            std::exception_ptr exception;
+        };
+
+        template <typename T>
+        struct Promise : PromiseBase {
+            Task<T> get_return_object();
+            void return_value(T value) { result = std::move(value); }
+
+            T getResult() {
+                if (exception) std::rethrow_exception(exception);
+                return std::move(*result);
+            }
+
+            std::optional<T> result;
+        };
+
+        template <>
+        struct Promise<void> : PromiseBase {
+            Task<void> get_return_object();
+            void return_void() const noexcept {}
+
+            void getResult() {
+                if (exception) std::rethrow_exception(exception);
+            }
+        };
+
+        // shared between a suspended awaiter, the I/O callback and the timeout, whichever completes first wins
+        template <typename T>
+        struct Completion : std::enable_shared_from_this<Completion<T>> {
+            Completion(Scheduler & scheduler) : scheduler(scheduler) {}
+
+            bool complete(T && value) {
+                std::coroutine_handle<> handle;
+                TimerWheel::TTimerId timerId = 0;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (isDone) return false;
+                    isDone = true;
+                    result = std::move(value);
+                    handle = this->handle;
+                    timerId = this->timerId;
+                }
+
+                if (timerId != 0) {
+                    scheduler.getTimers().cancel(timerId);
+                }
+
+                scheduler.post(handle);
+
+                return true;
+            }
+
+            // complete with timeoutResult, unless completed earlier
+            void setTimeout(int32_t timeout_ms, T timeoutResult) {
+                if (timeout_ms <= 0) {
+                    return;
+                }
+
+                std::weak_ptr<Completion> self = this->shared_from_this();
+                auto id = scheduler.getTimers().schedule(timeout_ms, [self, timeoutResult]() mutable {
+                    if (auto completion = self.lock()) {
+                        completion->complete(std::move(timeoutResult));
+                    }
+                });
+
+                std::lock_guard<std::mutex> lock(mutex);
+                if (isDone) {
+                    scheduler.getTimers().cancel(id);
+                } else {
+                    timerId = id;
+                }
+            }
+
+            Scheduler & scheduler;
+
+            std::mutex mutex;
+            bool isDone = false;
+            T result {};
+            std::coroutine_handle<> handle;
+            TimerWheel::TTimerId timerId = 0;
+        };
+
+        struct Detached {
+            struct promise_type {
+                Detached get_return_object() const noexcept { return {}; }
+                std::suspend_never initial_suspend() const noexcept { return {}; }
+                std::suspend_never final_suspend() const noexcept { return {}; }
+                void return_void() const noexcept {}
+                void unhandled_exception() const noexcept { std::terminate(); }
+            };
+        };
+    }
+
+    template <typename T>
+    class Task {
+        public:
+            using promise_type = detail::Promise<T>;
+            using THandle = std::coroutine_handle<promise_type>;
+
+            Task(Task && other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+            Task(const Task & ) = delete;
+            Task & operator=(const Task & ) = delete;
+            ~Task() {
+                if (handle) handle.destroy();
+            }
+
+            bool await_ready() const noexcept { return handle == nullptr || handle.done(); }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+                handle.promise().continuation = continuation;
+                return handle;
+            }
+
+            T await_resume() { return handle.promise().getResult(); }
+
+        private:
+            friend promise_type;
+
+            explicit Task(THandle handle) : handle(handle) {}
+
+            THandle handle;
+    };
+
+    namespace detail {
+        template <typename T>
+        inline Task<T> Promise<T>::get_return_object() {
+            return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+        }
+
+        inline Task<void> Promise<void>::get_return_object() {
+            return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+        }
+
+        inline Detached spawn(Scheduler & scheduler, Task<void> task) {
+            co_await scheduler.yield();
+            co_await std::move(task);
+        }
+    }
+
+    // start a task on the scheduler - it runs to completion without anyone awaiting it
+    inline void spawn(Scheduler & scheduler, Task<void> && task) {
+        detail::spawn(scheduler, std::move(task));
+    }
+
+    struct Message {
+        bool isValid = false;   // false on timeout
+        Communicator::TMessageType type = 0;
+        SerializationBuffer data;
+    };
+
+    // Awaitable operations on a Communicator
+    // installs the connect and send queue callbacks and the message callbacks for the received types on the communicator.
+    // messages of a type are queued until they are received, starting from the first receive() of that type,
+    // or from the constructor for the types passed there
+    class Connection {
+        public:
+            Connection(Scheduler & scheduler, Communicator & communicator, std::initializer_list<Communicator::TMessageType> types = {}) :
+                scheduler(scheduler), communicator(communicator) {
+                communicator.setConnectCallback([this]() { onConnect(); });
+                communicator.setSendQueueCallback([this]() { onSendQueue(); });
+                for (auto type : types) {
+                    addType(type);
+                }
+            }
+
+            ~Connection() {
+                communicator.removeConnectCallback();
+                communicator.removeSendQueueCallback();
+
+                // the callbacks are removed without holding the lock - they run under the communicator lock
+                std::vector<Communicator::TMessageType> types;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    for (const auto & channel : channels) {
+                        types.push_back(channel.first);
+                    }
+                }
+
+                for (auto type : types) {
+                    communicator.removeMessageCallback(type);
+                }
+            }
+
+            // co_await connection.connect(...) -> true when connected, false on timeout
+            auto connect(const TAddress & address, TPort port, int32_t timeout_ms) {
+                struct Awaiter {
+                    Connection & connection;
+                    TAddress address;
+                    TPort port;
+                    int32_t timeout_ms;
+
+                    std::shared_ptr<detail::Completion<bool>> completion;
+
+                    bool await_ready() const { return connection.communicator.isConnected(); }
+
+                    // the coroutine can be resumed from another thread as soon as the waiter is registered,
+                    // so only locals are used from that point on
+                    void await_suspend(std::coroutine_handle<> handle) {
+                        completion = std::make_shared<detail::Completion<bool>>(connection.scheduler);
+                        completion->handle = handle;
+
+                        auto completion = this->completion;
+                        auto & connection = this->connection;
+                        auto & communicator = connection.communicator;
+                        const auto address = this->address;
+                        const auto port = this->port;
+                        const auto timeout_ms = this->timeout_ms;
+
+                        {
+                            std::lock_guard<std::mutex> lock(connection.mutex);
+                            connection.connectWaiters.push_back(completion);
+                        }
+
+                        completion->setTimeout(timeout_ms, false);
+
+                        // the connection may have been established before the waiter was registered
+                        if (communicator.connect(address, port, 0) == false && communicator.isConnected()) {
+                            completion->complete(true);
+                        }
+                    }
+
+                    bool await_resume() {
+                        if (completion == nullptr) return true;
+                        if (completion->result == false) {
+                            connection.communicator.disconnect();
+                        }
+                        return completion->result;
+                    }
+                };
+
+                return Awaiter { *this, address, port, timeout_ms, nullptr };
+            }
+
+            // co_await connection.receive(type) -> the next message of this type, timeout_ms <= 0 - no timeout
+            auto receive(Communicator::TMessageType type, int32_t timeout_ms = 0) {
+                struct Awaiter {
+                    Connection & connection;
+                    Communicator::TMessageType type;
+                    int32_t timeout_ms;
+
+                    Message message;
+                    std::shared_ptr<detail::Completion<Message>> completion;
+
+                    bool await_ready() {
+                        connection.addType(type);
+
+                        std::lock_guard<std::mutex> lock(connection.mutex);
+                        auto & inbox = connection.channels[type].inbox;
+                        if (inbox.empty()) {
+                            return false;
+                        }
+
+                        message = std::move(inbox.front());
+                        inbox.pop_front();
+
+                        return true;
+                    }
+
+                    bool await_suspend(std::coroutine_handle<> handle) {
+                        completion = std::make_shared<detail::Completion<Message>>(connection.scheduler);
+                        completion->handle = handle;
+
+                        auto completion = this->completion;
+                        const auto timeout_ms = this->timeout_ms;
+                        {
+                            std::lock_guard<std::mutex> lock(connection.mutex);
+                            auto & channel = connection.channels[type];
+
+                            // arrived since await_ready()
+                            if (channel.inbox.empty() == false) {
+                                message = std::move(channel.inbox.front());
+                                channel.inbox.pop_front();
+                                this->completion = nullptr;
+                                return false;
+                            }
+
+                            channel.waiters.push_back(completion);
+                        }
+
+                        completion->setTimeout(timeout_ms, Message {});
+
+                        return true;
+                    }
+
+                    Message await_resume() {
+                        return completion ? std::move(completion->result) : std::move(message);
+                    }
+                };
+
+                return Awaiter { *this, type, timeout_ms, {}, nullptr };
+            }
+
+            // co_await connection.waitForSendQueue() - until the send queue has room, resumed by the send queue callback
+            auto waitForSendQueue() {
+                struct Awaiter {
+                    Connection & connection;
+
+                    std::shared_ptr<detail::Completion<bool>> completion;
+
+                    bool await_ready() const { return connection.communicator.isSendQueueFull() == false; }
+
+                    void await_suspend(std::coroutine_handle<> handle) {
+                        completion = std::make_shared<detail::Completion<bool>>(connection.scheduler);
+                        completion->handle = handle;
+
+                        auto completion = this->completion;
+                        auto & communicator = connection.communicator;
+                        {
+                            std::lock_guard<std::mutex> lock(connection.mutex);
+                            connection.sendWaiters.push_back(completion);
+                        }
+
+                        // the queue may have been drained before the waiter was registered
+                        if (communicator.isSendQueueFull() == false) {
+                            completion->complete(true);
+                        }
+                    }
+
+                    void await_resume() const noexcept {}
+                };
+
+                return Awaiter { *this, nullptr };
+            }
+
+            // co_await connection.send(...) -> false if not connected
+            // waits for room while the send queue is full. the data is copied before the first suspension
+            Task<bool> send(Communicator::TMessageType type, const char * dataBuffer = nullptr, Communicator::TBufferSize dataSize = 0) {
+                if (communicator.send(type, dataBuffer, dataSize)) {
+                    co_return true;
+                }
+
+                SerializationBuffer data(dataBuffer, dataBuffer + dataSize);
+                while (true) {
+                    if (communicator.isSendQueueFull() == false && communicator.isConnected() == false) {
+                        co_return false;
+                    }
+
+                    co_await waitForSendQueue();
+
+                    if (communicator.send(type, data.data(), (Communicator::TBufferSize) data.size())) {
+                        co_return true;
+                    }
+                }
+            }
+
+        private:
+            struct Channel {
+                bool isRegistered = false;
+                std::deque<Message> inbox;
+                std::deque<std::shared_ptr<detail::Completion<Message>>> waiters;
+            };
+
+            void addType(Communicator::TMessageType type) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (channels[type].isRegistered) {
+                        return;
+                    }
+                    channels[type].isRegistered = true;
+                }
+
+                communicator.setMessageCallback(type, [this, type](const char * dataBuffer, Communicator::TBufferSize dataSize) {
+                    onMessage(type, dataBuffer, dataSize);
+                    return 0;
+                });
+            }
+
+            void onSendQueue() {
+                std::deque<std::shared_ptr<detail::Completion<bool>>> waiters;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    waiters.swap(sendWaiters);
+                }
+
+                for (auto & waiter : waiters) {
+                    waiter->complete(true);
+                }
+            }
+
+            void onConnect() {
+                std::deque<std::shared_ptr<detail::Completion<bool>>> waiters;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    waiters.swap(connectWaiters);
+                }
+
+                for (auto & waiter : waiters) {
+                    waiter->complete(true);
+                }
+            }
+
+            void onMessage(Communicator::TMessageType type, const char * dataBuffer, Communicator::TBufferSize dataSize) {
+                Message message;
+                message.isValid = true;
+                message.type = type;
+                message.data.assign(dataBuffer, dataBuffer + dataSize);
+
+                std::lock_guard<std::mutex> lock(mutex);
+
+                auto & channel = channels[type];
+                while (channel.waiters.empty() == false) {
+                    auto waiter = std::move(channel.waiters.front());
+                    channel.waiters.pop_front();
+
+                    // skip the waiters that have timed out
+                    if (waiter->complete(std::move(message))) {
+                        return;
+                    }
+                }
+
+                channel.inbox.push_back(std::move(message));
+            }
+
+            Scheduler & scheduler;
+            Communicator & communicator;
+
+            std::map<Communicator::TMessageType, Channel> channels;
+            std::deque<std::shared_ptr<detail::Completion<bool>>> connectWaiters;
+            std::deque<std::shared_ptr<detail::Completion<bool>>> sendWaiters;
+
+            std::mutex mutex;
+    };
+}
+}
+
+#endif
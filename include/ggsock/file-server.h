@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ggsock/common.h"
+#include "ggsock/serialization.h"
 
 #include <memory>
 #include <map>
@@ -48,6 +49,15 @@ namespace GGSock {
                 int64_t pLen = 0;
             };
 
+            // same wire format as FileChunkResponseData, but the chunk data points into the received message
+            struct FileChunkResponseView {
+                TURI uri = "";
+                TChunkId chunkId = 0;
+                BlobView data;
+                int64_t pStart = 0;
+                int64_t pLen = 0;
+            };
+
             struct Parameters {
                 int32_t nWorkerThreads = 4;
                 int32_t nMaxClients = 8;
@@ -55,6 +65,13 @@ namespace GGSock {
                 int32_t nDefaultFileChunks = 128;
 
                 TPort listenPort = 22765;
+
+                // outgoing bandwidth limits in bytes per second, 0 - unlimited
+                int64_t maxRatePerClient_Bps = 0;
+                int64_t maxRateTotal_Bps = 0;
+
+                // LZ4-compress messages to clients that enable compression as well
+                bool useCompression = false;
             };
 
             struct FileInfo {
@@ -108,3 +125,8 @@ namespace GGSock {
     };
 
 }
+
+GGSOCK_SERIALIZABLE(GGSock::FileServer::FileInfo, uri, filesize, filename, nChunks)
+GGSOCK_SERIALIZABLE(GGSock::FileServer::FileChunkRequestData, uri, chunkId, nChunksHave, nChunksExpected)
+GGSOCK_SERIALIZABLE(GGSock::FileServer::FileChunkResponseData, uri, chunkId, data, pStart, pLen)
+GGSOCK_SERIALIZABLE(GGSock::FileServer::FileChunkResponseView, uri, chunkId, data, pStart, pLen)
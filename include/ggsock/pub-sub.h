@@ -0,0 +1,79 @@
+#pragma once
+
+#include "ggsock/communicator.h"
+#include "ggsock/communicator-group.h"
+
+#include <memory>
+#include <functional>
+
+namespace GGSock {
+    // Topic-based publish/subscribe on top of Communicators
+    // the broker keeps an index of subscribers per topic. a published message is encoded once and queued to all
+    // subscribers of its topic by reference, including the publisher, if it is subscribed
+    // messages published by the peers are queued by their callbacks and delivered by update(), so a slow subscriber
+    // is never waited for while a communicator lock is held
+    class PubSubBroker {
+        public:
+            using TTopic = uint32_t;
+            using TCommunicator = std::shared_ptr<Communicator>;
+
+            enum MessageType : Communicator::TMessageType {
+                MsgSubscribe = 0xFD00,  // [topic]
+                MsgUnsubscribe,         // [topic]
+                MsgPublish,             // [topic, data]
+            };
+
+            struct Parameters {
+                CommunicatorGroup::Parameters delivery;
+            };
+
+            PubSubBroker();
+            PubSubBroker(const Parameters & parameters);
+            ~PubSubBroker();
+
+            // installs message callbacks on the peer's communicator
+            bool addPeer(const TCommunicator & communicator);
+            bool removePeer(const TCommunicator & communicator);
+
+            // delivers the messages published by the peers and drops the subscriptions of peers whose connection has
+            // dropped - call periodically, not from a Communicator callback
+            bool update();
+
+            // publish from the broker side, returns the number of subscribers the message was queued to
+            // must not be called from a Communicator callback
+            int32_t publish(TTopic topic, const char * dataBuffer, Communicator::TBufferSize dataSize);
+
+            int32_t getNumSubscribers(TTopic topic) const;
+
+        private:
+            struct Data;
+            std::unique_ptr<Data> data_;
+            Data & getData() { return *data_; }
+            const Data & getData() const { return *data_; }
+    };
+
+    // Client side of the broker protocol
+    class PubSubClient {
+        public:
+            using TTopic = PubSubBroker::TTopic;
+
+            using CBMessage = std::function<void(TTopic topic, const char * dataBuffer, Communicator::TBufferSize dataSize)>;
+
+            // installs a message callback for MsgPublish on the communicator
+            PubSubClient(Communicator & communicator);
+            ~PubSubClient();
+
+            // subscriptions are sent again after a reconnect - call periodically
+            bool update();
+
+            bool subscribe(TTopic topic, CBMessage && callback);
+            bool unsubscribe(TTopic topic);
+            bool publish(TTopic topic, const char * dataBuffer, Communicator::TBufferSize dataSize);
+
+        private:
+            struct Data;
+            std::unique_ptr<Data> data_;
+            Data & getData() { return *data_; }
+            const Data & getData() const { return *data_; }
+    };
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+namespace GGSock {
+    // Token bucket limiting the number of bytes per second.
+    // Can be shared between multiple Communicators to limit their aggregate bandwidth. In that case,
+    // senders that have been blocked are served in FIFO order, so a single greedy sender cannot starve the rest.
+    class RateLimiter {
+        public:
+            using TRate = int64_t;
+            using TOwner = const void *;
+
+            // maxBurst_bytes <= 0 selects a burst of ~100 ms worth of data
+            RateLimiter(TRate maxRate_Bps, int64_t maxBurst_bytes = 0);
+            ~RateLimiter();
+
+            // consume nBytes if available, otherwise enqueue the owner and return false
+            // messages larger than the burst size are let through when the bucket is full and paid for by the next ones
+            bool acquire(TOwner owner, int64_t nBytes);
+            bool isAvailable(int64_t nBytes) const;
+            void consume(int64_t nBytes);
+
+            // time until nBytes become available, 0 if they already are
+            int64_t getTimeToAvailable_us(int64_t nBytes) const;
+
+            // remove the owner from the queue of blocked senders
+            void cancel(TOwner owner);
+
+            TRate getMaxRate() const;
+            int64_t getMaxBurst() const;
+
+        private:
+            struct Data;
+            std::unique_ptr<Data> data_;
+            Data & getData() { return *data_; }
+            const Data & getData() const { return *data_; }
+    };
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "ggsock/buffer-pool.h"
+#include "ggsock/serialization.h"
+
+#include <memory>
+#include <string>
+
+namespace GGSock {
+    // Persistent sequence of serialized records with an offset table at the end, for snapshots of large state.
+    // The writer streams the records to disk one at a time. The reader maps the file into memory, so opening it
+    // is O(1) and a record is read from disk only when it is accessed.
+    //
+    // [magic, version] [record 0] ... [record n - 1] [offsets of the records and of the table, u64 x (n + 1)]
+    // [number of records u64, table offset u64, magic]
+
+    class RecordFileWriter {
+        public:
+            RecordFileWriter();
+            ~RecordFileWriter();
+
+            // writes to path + ".tmp" - an existing file at path stays intact until close()
+            bool open(const std::string & path);
+
+            // writes the offset table and renames the file to path. if anything failed, the file is removed and
+            // path is not touched. called by the destructor
+            bool close();
+
+            bool append(const char * dataBuffer, size_t dataSize);
+
+            template <typename T>
+            bool append(const T & obj) {
+                auto buffer = BufferPool::acquire(SerializedSize()(obj));
+                bool res = Serialize()(obj, buffer) && append(buffer.data(), buffer.size());
+                BufferPool::release(buffer);
+
+                return res;
+            }
+
+            size_t getNumRecords() const;
+
+        private:
+            struct Data;
+            std::unique_ptr<Data> data_;
+            Data & getData() { return *data_; }
+            const Data & getData() const { return *data_; }
+    };
+
+    class RecordFileReader {
+        public:
+            RecordFileReader();
+            ~RecordFileReader();
+
+            // maps the file and checks the footer - the records are checked when they are accessed
+            bool open(const std::string & path);
+            bool close();
+            bool isOpen() const;
+
+            size_t getNumRecords() const;
+
+            // points into the mapping, valid while the file is open. empty if the record is out of range or corrupt
+            BlobView getRecord(size_t idx) const;
+
+            // unserialize a single record - BlobView and StringView fields point into the mapping
+            template <typename T>
+            bool read(size_t idx, T & obj, Unserialize & op) const {
+                auto record = getRecord(idx);
+                if (record.data == nullptr) {
+                    return false;
+                }
+
+                size_t offset = 0;
+                return op(obj, record.data, record.size, offset);
+            }
+
+            template <typename T>
+            bool read(size_t idx, T & obj) const {
+                Unserialize op;
+                return read(idx, obj, op);
+            }
+
+        private:
+            struct Data;
+            std::unique_ptr<Data> data_;
+            Data & getData() { return *data_; }
+            const Data & getData() const { return *data_; }
+    };
+}
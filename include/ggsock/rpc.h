@@ -0,0 +1,76 @@
+#pragma once
+
+#include "ggsock/communicator.h"
+#include "ggsock/serialization.h"
+
+#include <future>
+#include <memory>
+#include <functional>
+
+namespace GGSock {
+    // Request/response calls on top of a Communicator
+    // every request carries an id, so many calls can be in flight on one connection and complete in any order.
+    // both sides of the connection can issue and serve calls at the same time
+    class Rpc {
+        public:
+            using TRequestId = uint32_t;
+            using TMethod = uint16_t;
+
+            enum MessageType : Communicator::TMessageType {
+                MsgRpcRequest = 0xFE00,  // [request id, method, data]
+                MsgRpcResponse,          // [request id, status, data]
+            };
+
+            enum Status : int32_t {
+                Ok = 0,
+                Pending,                // returned by a handler that will call respond() later
+                ErrorTimeout,
+                ErrorUnknownMethod,
+                ErrorSendFailed,
+                ErrorHandler,
+                ErrorDisconnected,      // the connection dropped before the response arrived
+            };
+
+            struct Response {
+                Status status = Ok;
+                SerializationBuffer data;
+            };
+
+            using CBResponse = std::function<void(Status status, const char * dataBuffer, size_t dataSize)>;
+            using CBHandler = std::function<Status(TRequestId requestId, const char * dataBuffer, size_t dataSize, SerializationBuffer & response)>;
+
+            // installs message callbacks for msgRequest and msgResponse on the communicator
+            Rpc(Communicator & communicator, Communicator::TMessageType msgRequest = MsgRpcRequest, Communicator::TMessageType msgResponse = MsgRpcResponse);
+            ~Rpc();
+
+            // expires the calls whose deadline has passed and fails the calls made on a connection that has dropped
+            // call periodically
+            bool update();
+
+            // timeout_ms <= 0 - no deadline
+            TRequestId call(TMethod method, const char * dataBuffer, size_t dataSize, int32_t timeout_ms, CBResponse && callback);
+            std::future<Response> call(TMethod method, const char * dataBuffer, size_t dataSize, int32_t timeout_ms);
+
+            template <typename T>
+            std::future<Response> call(TMethod method, const T & request, int32_t timeout_ms) {
+                SerializationBuffer buffer;
+                Serialize()(request, buffer);
+                return call(method, buffer.data(), buffer.size(), timeout_ms);
+            }
+
+            bool cancel(TRequestId requestId);
+            int32_t getNumPendingCalls() const;
+
+            bool setHandler(TMethod method, CBHandler && handler);
+            bool removeHandler(TMethod method);
+
+            // complete a request for which the handler returned Pending
+            bool respond(TRequestId requestId, Status status, const char * dataBuffer, size_t dataSize);
+
+        private:
+            struct Data;
+            std::unique_ptr<Data> data_;
+            Data & getData() { return *data_; }
+            const Data & getData() const { return *data_; }
+    };
+}
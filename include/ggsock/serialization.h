@@ -1,16 +1,60 @@
 #pragma once
 
+#include "ggsock/arena.h"
+
+#include <array>
 #include <cstddef>
 #include <vector>
 #include <cstdint>
 #include <map>
 #include <memory>
 #include <string>
+#include <tuple>
+#include <type_traits>
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 
 namespace GGSock {
 
 struct SerializationBuffer : public std::vector<char> { using vector::vector; };
 
+// views into the buffer that was unserialized - valid only as long as that buffer is
+// same wire format as std::string and std::vector<char>, so either side can use the owning or the view type
+struct BlobView {
+    const char * data = nullptr;
+    size_t size = 0;
+
+    const char * begin() const { return data; }
+    const char * end() const { return data + size; }
+};
+
+struct StringView : BlobView {
+    std::string str() const { return std::string(data, size); }
+};
+
+// types that are written as their raw bytes, so vectors and arrays of them are copied with a single memcpy
+// plain structs opt in with GGSOCK_SERIALIZE_AS_BYTES
+template <typename T> struct IsTriviallySerializable : std::integral_constant<bool, std::is_arithmetic<T>::value> {};
+
+// wire encoding of integers wider than one byte, including the length prefixes of strings and containers
+// both ends have to use the same encoding
+enum class Encoding {
+    Fixed,  // native width
+    Varint, // LEB128, zigzag for signed types - smaller for small values, but vectors of integers are not memcpy'd
+};
+
+template <typename T> using IsVarintEncoded = std::integral_constant<bool, (std::is_integral<T>::value && sizeof(T) > 1)>;
+
+// lower bound of the bytes an element takes on the wire, used to reject length prefixes before allocating
+// every serialized type takes at least one byte
+template <typename T> size_t getMinSerializedSize(Encoding encoding) {
+    if (IsTriviallySerializable<T>::value == false) return 1;
+
+    return encoding == Encoding::Varint && IsVarintEncoded<T>::value ? 1 : sizeof(T);
+}
+
 // if the following macro is defined, include the STL serialization overloads
 struct Serialize {
     template <typename T>                       bool operator()(const T & obj,                        SerializationBuffer & buffer, size_t & offset);
@@ -19,12 +63,25 @@ struct Serialize {
     template <typename T>                       bool operator()(const T & obj,                        SerializationBuffer & buffer);
 
     // STL
-    template <typename T>                       bool operator()(const std::vector<T> & obj,           SerializationBuffer & buffer, size_t & offset);
+    template <typename T, typename A>           bool operator()(const std::vector<T, A> & obj,        SerializationBuffer & buffer, size_t & offset);
+    template <typename T, size_t N>             bool operator()(const std::array<T, N> & obj,         SerializationBuffer & buffer, size_t & offset);
     template <typename T>                       bool operator()(const std::shared_ptr<T> & obj,       SerializationBuffer & buffer, size_t & offset);
     template <typename First, typename Second>  bool operator()(const std::pair<First, Second> & obj, SerializationBuffer & buffer, size_t & offset);
-    template <typename Key, typename Value>     bool operator()(const std::map<Key, Value> & obj,     SerializationBuffer & buffer, size_t & offset);
+    template <typename K, typename V, typename C, typename A> bool operator()(const std::map<K, V, C, A> & obj, SerializationBuffer & buffer, size_t & offset);
+
+    // raw bytes, without a length prefix
+    bool serializeBytes(const void * src, size_t nBytes, SerializationBuffer & buffer, size_t & offset);
+
+    Encoding encoding = Encoding::Fixed;
 
     uint64_t nBytesProcessed = 0;
+
+private:
+    template <typename T> bool serializeBulk(const T * objs, size_t n, SerializationBuffer & buffer, size_t & offset, std::true_type);
+    template <typename T> bool serializeBulk(const T * objs, size_t n, SerializationBuffer & buffer, size_t & offset, std::false_type);
+    template <typename T> bool serializeVarints(const T * objs, size_t n, SerializationBuffer & buffer, size_t & offset);
+    template <typename TContainer> bool serializeElements(const TContainer & obj, SerializationBuffer & buffer, size_t & offset, std::true_type);
+    template <typename TContainer> bool serializeElements(const TContainer & obj, SerializationBuffer & buffer, size_t & offset, std::false_type);
 };
 
 struct Unserialize {
@@ -35,21 +92,226 @@ struct Unserialize {
     template <typename T>                       bool operator()(T & obj,                        const SerializationBuffer & buffer, size_t & offset);
 
     // STL
-    template <typename T>                       bool operator()(std::vector<T> & obj,           const char * bufferData, size_t bufferSize, size_t & offset);
+    template <typename T, typename A>           bool operator()(std::vector<T, A> & obj,        const char * bufferData, size_t bufferSize, size_t & offset);
+    template <typename T, size_t N>             bool operator()(std::array<T, N> & obj,         const char * bufferData, size_t bufferSize, size_t & offset);
     template <typename T>                       bool operator()(std::shared_ptr<T> & obj,       const char * bufferData, size_t bufferSize, size_t & offset);
     template <typename First, typename Second>  bool operator()(std::pair<First, Second> & obj, const char * bufferData, size_t bufferSize, size_t & offset);
-    template <typename Key, typename Value>     bool operator()(std::map<Key, Value> & obj,     const char * bufferData, size_t bufferSize, size_t & offset);
+    template <typename K, typename V, typename C, typename A> bool operator()(std::map<K, V, C, A> & obj, const char * bufferData, size_t bufferSize, size_t & offset);
+
+    // raw bytes, without a length prefix
+    bool unserializeBytes(void * dst, size_t nBytes, const char * bufferData, size_t bufferSize, size_t & offset);
+
+    // validate a length prefix before allocating for it - each of the n elements has to take at least
+    // minSize_bytes of the remaining input. the allocSize_bytes per element count towards maxBytesAllocated
+    bool checkLength(int32_t n, size_t minSize_bytes, size_t allocSize_bytes, size_t bufferSize, size_t offset);
 
     // bool deepCopy = true;
 
+    Encoding encoding = Encoding::Fixed;
+
+    // limit the memory that the length prefixes in the input can make this Unserialize allocate, 0 - unlimited
+    uint64_t maxBytesAllocated = 0;
+
     uint64_t nBytesProcessed = 0;
+    uint64_t nBytesAllocated = 0;
+
+private:
+    template <typename T> bool unserializeBulk(T * objs, size_t n, const char * bufferData, size_t bufferSize, size_t & offset, std::true_type);
+    template <typename T> bool unserializeBulk(T * objs, size_t n, const char * bufferData, size_t bufferSize, size_t & offset, std::false_type);
+    template <typename T> bool unserializeVarints(T * objs, size_t n, const char * bufferData, size_t bufferSize, size_t & offset);
+    template <typename TContainer> bool unserializeElements(TContainer & obj, const char * bufferData, size_t bufferSize, size_t & offset, std::true_type);
+    template <typename TContainer> bool unserializeElements(TContainer & obj, const char * bufferData, size_t bufferSize, size_t & offset, std::false_type);
+    template <typename A> bool unserializeElements(std::vector<bool, A> & obj, const char * bufferData, size_t bufferSize, size_t & offset, std::false_type);
+};
+
+// the number of bytes Serialize writes for obj - user types that specialize Serialize have to specialize it as well
+struct SerializedSize {
+    template <typename T>                       size_t operator()(const T & obj);
+
+    // STL
+    template <typename T, typename A>           size_t operator()(const std::vector<T, A> & obj);
+    template <typename T, size_t N>             size_t operator()(const std::array<T, N> & obj);
+    template <typename T>                       size_t operator()(const std::shared_ptr<T> & obj);
+    template <typename First, typename Second>  size_t operator()(const std::pair<First, Second> & obj);
+    template <typename K, typename V, typename C, typename A> size_t operator()(const std::map<K, V, C, A> & obj);
+
+    Encoding encoding = Encoding::Fixed;
+
+private:
+    template <typename T> size_t sizeOfBulk(const T * objs, size_t n, std::true_type);
+    template <typename T> size_t sizeOfBulk(const T * objs, size_t n, std::false_type);
+    template <typename T> size_t sizeOfVarints(const T * objs, size_t n);
+    template <typename TContainer> size_t sizeOfElements(const TContainer & obj, std::true_type);
+    template <typename TContainer> size_t sizeOfElements(const TContainer & obj, std::false_type);
 };
 
+// the elements of a container are copied with a single memcpy if they are stored contiguously as raw bytes
+// std::vector<bool> is packed, so it is written element by element
+template <typename T> using IsBulkSerializable = std::integral_constant<bool, IsTriviallySerializable<T>::value && std::is_same<T, bool>::value == false>;
+
+// write a plain struct of trivially copyable members as its raw bytes, also in vectors and arrays
+// the layout has to be the same on both ends. use at global scope, before T is first serialized
+#define GGSOCK_SERIALIZE_AS_BYTES(T)                                                                                        \
+    namespace GGSock {                                                                                                      \
+        static_assert(std::is_trivially_copyable<T>::value, #T " is not trivially copyable");                               \
+                                                                                                                            \
+        template <> struct IsTriviallySerializable<T> : std::true_type {};                                                  \
+                                                                                                                            \
+        template <>                                                                                                         \
+        inline bool Serialize::operator()<T>(const T & obj, SerializationBuffer & buffer, size_t & offset) {                \
+            return serializeBytes(&obj, sizeof(T), buffer, offset);                                                         \
+        }                                                                                                                   \
+                                                                                                                            \
+        template <>                                                                                                         \
+        inline bool Unserialize::operator()<T>(T & obj, const char * bufferData, size_t bufferSize, size_t & offset) {      \
+            return unserializeBytes(&obj, sizeof(T), bufferData, bufferSize, offset);                                       \
+        }                                                                                                                   \
+                                                                                                                            \
+        template <>                                                                                                         \
+        inline size_t SerializedSize::operator()<T>(const T & ) {                                                           \
+            return sizeof(T);                                                                                               \
+        }                                                                                                                   \
+    }
+
+// field lists for GGSOCK_SERIALIZABLE
+// runs of adjacent trivially serializable fields without padding in between are copied with a single memcpy,
+// except for varint-encoded integers. the wire format is the same as writing the fields one by one
+
+template <typename T>
+inline bool serializeFields(Serialize & op, const T & , SerializationBuffer & buffer, size_t & offset, const char * runBegin, size_t runSize) {
+    return runSize == 0 || op.serializeBytes(runBegin, runSize, buffer, offset);
+}
+
+template <typename T, typename C, typename M, typename ... Rest>
+inline bool serializeFields(Serialize & op, const T & obj, SerializationBuffer & buffer, size_t & offset, const char * runBegin, size_t runSize, M C::* field, Rest ... rest);
+
+template <typename T, typename C, typename M, typename ... Rest>
+inline bool serializeField(std::false_type, Serialize & op, const T & obj, SerializationBuffer & buffer, size_t & offset, const char * runBegin, size_t runSize, M C::* field, Rest ... rest) {
+    return
+        serializeFields(op, obj, buffer, offset, runBegin, runSize) &&
+        op(obj.*field, buffer, offset) &&
+        serializeFields(op, obj, buffer, offset, nullptr, 0, rest...);
+}
+
+template <typename T, typename C, typename M, typename ... Rest>
+inline bool serializeField(std::true_type, Serialize & op, const T & obj, SerializationBuffer & buffer, size_t & offset, const char * runBegin, size_t runSize, M C::* field, Rest ... rest) {
+    if (op.encoding == Encoding::Varint && IsVarintEncoded<M>::value) {
+        return serializeField(std::false_type(), op, obj, buffer, offset, runBegin, runSize, field, rest...);
+    }
+
+    const char * p = reinterpret_cast<const char *>(&(obj.*field));
+    if (runSize > 0 && runBegin + runSize == p) {
+        return serializeFields(op, obj, buffer, offset, runBegin, runSize + sizeof(M), rest...);
+    }
+
+    return
+        serializeFields(op, obj, buffer, offset, runBegin, runSize) &&
+        serializeFields(op, obj, buffer, offset, p, sizeof(M), rest...);
+}
+
+template <typename T, typename C, typename M, typename ... Rest>
+inline bool serializeFields(Serialize & op, const T & obj, SerializationBuffer & buffer, size_t & offset, const char * runBegin, size_t runSize, M C::* field, Rest ... rest) {
+    return serializeField(IsTriviallySerializable<M>(), op, obj, buffer, offset, runBegin, runSize, field, rest...);
+}
+
+template <typename T>
+inline bool unserializeFields(Unserialize & op, T & , const char * bufferData, size_t bufferSize, size_t & offset, char * runBegin, size_t runSize) {
+    return runSize == 0 || op.unserializeBytes(runBegin, runSize, bufferData, bufferSize, offset);
+}
+
+template <typename T, typename C, typename M, typename ... Rest>
+inline bool unserializeFields(Unserialize & op, T & obj, const char * bufferData, size_t bufferSize, size_t & offset, char * runBegin, size_t runSize, M C::* field, Rest ... rest);
+
+template <typename T, typename C, typename M, typename ... Rest>
+inline bool unserializeField(std::false_type, Unserialize & op, T & obj, const char * bufferData, size_t bufferSize, size_t & offset, char * runBegin, size_t runSize, M C::* field, Rest ... rest) {
+    return
+        unserializeFields(op, obj, bufferData, bufferSize, offset, runBegin, runSize) &&
+        op(obj.*field, bufferData, bufferSize, offset) &&
+        unserializeFields(op, obj, bufferData, bufferSize, offset, nullptr, 0, rest...);
+}
+
+template <typename T, typename C, typename M, typename ... Rest>
+inline bool unserializeField(std::true_type, Unserialize & op, T & obj, const char * bufferData, size_t bufferSize, size_t & offset, char * runBegin, size_t runSize, M C::* field, Rest ... rest) {
+    if (op.encoding == Encoding::Varint && IsVarintEncoded<M>::value) {
+        return unserializeField(std::false_type(), op, obj, bufferData, bufferSize, offset, runBegin, runSize, field, rest...);
+    }
+
+    char * p = reinterpret_cast<char *>(&(obj.*field));
+    if (runSize > 0 && runBegin + runSize == p) {
+        return unserializeFields(op, obj, bufferData, bufferSize, offset, runBegin, runSize + sizeof(M), rest...);
+    }
+
+    return
+        unserializeFields(op, obj, bufferData, bufferSize, offset, runBegin, runSize) &&
+        unserializeFields(op, obj, bufferData, bufferSize, offset, p, sizeof(M), rest...);
+}
+
+template <typename T, typename C, typename M, typename ... Rest>
+inline bool unserializeFields(Unserialize & op, T & obj, const char * bufferData, size_t bufferSize, size_t & offset, char * runBegin, size_t runSize, M C::* field, Rest ... rest) {
+    return unserializeField(IsTriviallySerializable<M>(), op, obj, bufferData, bufferSize, offset, runBegin, runSize, field, rest...);
+}
+
+template <typename T>
+inline size_t serializedSizeOfFields(SerializedSize & , const T & ) {
+    return 0;
+}
+
+template <typename T, typename C, typename M, typename ... Rest>
+inline size_t serializedSizeOfFields(SerializedSize & op, const T & obj, M C::* field, Rest ... rest) {
+    return op(obj.*field) + serializedSizeOfFields(op, obj, rest...);
+}
+
+// generate Serialize, Unserialize and SerializedSize for a struct from the list of its fields, in wire order
+// use at global scope, before T is first serialized. up to 16 fields
+#define GGSOCK_SERIALIZABLE(T, ...)                                                                                         \
+    namespace GGSock {                                                                                                      \
+        template <>                                                                                                         \
+        inline bool Serialize::operator()<T>(const T & obj, SerializationBuffer & buffer, size_t & offset) {                \
+            return serializeFields(*this, obj, buffer, offset, nullptr, 0, GGSOCK_FIELDS(T, __VA_ARGS__));                  \
+        }                                                                                                                   \
+                                                                                                                            \
+        template <>                                                                                                         \
+        inline bool Unserialize::operator()<T>(T & obj, const char * bufferData, size_t bufferSize, size_t & offset) {      \
+            return unserializeFields(*this, obj, bufferData, bufferSize, offset, nullptr, 0, GGSOCK_FIELDS(T, __VA_ARGS__)); \
+        }                                                                                                                   \
+                                                                                                                            \
+        template <>                                                                                                         \
+        inline size_t SerializedSize::operator()<T>(const T & obj) {                                                        \
+            return serializedSizeOfFields(*this, obj, GGSOCK_FIELDS(T, __VA_ARGS__));                                       \
+        }                                                                                                                   \
+    }
+
+#define GGSOCK_EXPAND(x) x
+#define GGSOCK_FIELDS_1(T, a) &T::a
+#define GGSOCK_FIELDS_2(T, a, ...) &T::a, GGSOCK_EXPAND(GGSOCK_FIELDS_1(T, __VA_ARGS__))
+#define GGSOCK_FIELDS_3(T, a, ...) &T::a, GGSOCK_EXPAND(GGSOCK_FIELDS_2(T, __VA_ARGS__))
+#define GGSOCK_FIELDS_4(T, a, ...) &T::a, GGSOCK_EXPAND(GGSOCK_FIELDS_3(T, __VA_ARGS__))
+#define GGSOCK_FIELDS_5(T, a, ...) &T::a, GGSOCK_EXPAND(GGSOCK_FIELDS_4(T, __VA_ARGS__))
+#define GGSOCK_FIELDS_6(T, a, ...) &T::a, GGSOCK_EXPAND(GGSOCK_FIELDS_5(T, __VA_ARGS__))
+#define GGSOCK_FIELDS_7(T, a, ...) &T::a, GGSOCK_EXPAND(GGSOCK_FIELDS_6(T, __VA_ARGS__))
+#define GGSOCK_FIELDS_8(T, a, ...) &T::a, GGSOCK_EXPAND(GGSOCK_FIELDS_7(T, __VA_ARGS__))
+#define GGSOCK_FIELDS_9(T, a, ...) &T::a, GGSOCK_EXPAND(GGSOCK_FIELDS_8(T, __VA_ARGS__))
+#define GGSOCK_FIELDS_10(T, a, ...) &T::a, GGSOCK_EXPAND(GGSOCK_FIELDS_9(T, __VA_ARGS__))
+#define GGSOCK_FIELDS_11(T, a, ...) &T::a, GGSOCK_EXPAND(GGSOCK_FIELDS_10(T, __VA_ARGS__))
+#define GGSOCK_FIELDS_12(T, a, ...) &T::a, GGSOCK_EXPAND(GGSOCK_FIELDS_11(T, __VA_ARGS__))
+#define GGSOCK_FIELDS_13(T, a, ...) &T::a, GGSOCK_EXPAND(GGSOCK_FIELDS_12(T, __VA_ARGS__))
+#define GGSOCK_FIELDS_14(T, a, ...) &T::a, GGSOCK_EXPAND(GGSOCK_FIELDS_13(T, __VA_ARGS__))
+#define GGSOCK_FIELDS_15(T, a, ...) &T::a, GGSOCK_EXPAND(GGSOCK_FIELDS_14(T, __VA_ARGS__))
+#define GGSOCK_FIELDS_16(T, a, ...) &T::a, GGSOCK_EXPAND(GGSOCK_FIELDS_15(T, __VA_ARGS__))
+#define GGSOCK_FIELDS_N(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, N, ...) N
+#define GGSOCK_FIELDS(T, ...) GGSOCK_EXPAND(GGSOCK_FIELDS_N(__VA_ARGS__, GGSOCK_FIELDS_16, GGSOCK_FIELDS_15, GGSOCK_FIELDS_14, GGSOCK_FIELDS_13, GGSOCK_FIELDS_12, GGSOCK_FIELDS_11, GGSOCK_FIELDS_10, GGSOCK_FIELDS_9, GGSOCK_FIELDS_8, GGSOCK_FIELDS_7, GGSOCK_FIELDS_6, GGSOCK_FIELDS_5, GGSOCK_FIELDS_4, GGSOCK_FIELDS_3, GGSOCK_FIELDS_2, GGSOCK_FIELDS_1)(T, __VA_ARGS__))
+
 //
 // Serialize helpers
 //
 
 template <typename T>bool Serialize::operator()(const T & obj, SerializationBuffer & buffer) {
+    // allocate once - the fields are then appended without growing the buffer
+    SerializedSize size;
+    size.encoding = encoding;
+    buffer.clear();
+    buffer.reserve(size(obj));
+
     size_t offset = 0;
     return operator()(obj, buffer, offset);
 }
@@ -73,11 +335,39 @@ template <typename T>bool Unserialize::operator()(T & obj, const SerializationBu
 
 // std::vector
 
-template <typename T> bool Serialize::operator()(const std::vector<T> & t, SerializationBuffer & buffer, size_t & offset) {
+// integers are memcpy'd only with the fixed encoding - the varint paths are defined in serialization.cpp
+
+template <typename T> bool Serialize::serializeBulk(const T * objs, size_t n, SerializationBuffer & buffer, size_t & offset, std::true_type) {
+    return encoding == Encoding::Varint ? serializeVarints(objs, n, buffer, offset) : serializeBytes(objs, n*sizeof(T), buffer, offset);
+}
+
+template <typename T> bool Serialize::serializeBulk(const T * objs, size_t n, SerializationBuffer & buffer, size_t & offset, std::false_type) {
+    return serializeBytes(objs, n*sizeof(T), buffer, offset);
+}
+
+template <typename T> bool Unserialize::unserializeBulk(T * objs, size_t n, const char * bufferData, size_t bufferSize, size_t & offset, std::true_type) {
+    return encoding == Encoding::Varint ? unserializeVarints(objs, n, bufferData, bufferSize, offset) : unserializeBytes(objs, n*sizeof(T), bufferData, bufferSize, offset);
+}
+
+template <typename T> bool Unserialize::unserializeBulk(T * objs, size_t n, const char * bufferData, size_t bufferSize, size_t & offset, std::false_type) {
+    return unserializeBytes(objs, n*sizeof(T), bufferData, bufferSize, offset);
+}
+
+template <typename T> size_t SerializedSize::sizeOfBulk(const T * objs, size_t n, std::true_type) {
+    return encoding == Encoding::Varint ? sizeOfVarints(objs, n) : n*sizeof(T);
+}
+
+template <typename T> size_t SerializedSize::sizeOfBulk(const T * , size_t n, std::false_type) {
+    return n*sizeof(T);
+}
+
+template <typename TContainer> bool Serialize::serializeElements(const TContainer & t, SerializationBuffer & buffer, size_t & offset, std::true_type) {
+    return serializeBulk(t.data(), t.size(), buffer, offset, IsVarintEncoded<typename TContainer::value_type>());
+}
+
+template <typename TContainer> bool Serialize::serializeElements(const TContainer & t, SerializationBuffer & buffer, size_t & offset, std::false_type) {
     bool res = true;
 
-    int32_t n = (int32_t) t.size();
-    res &= operator()(n, buffer, offset);
     for (const auto & p : t) {
         res &= operator()(p, buffer, offset);
     }
@@ -85,26 +375,96 @@ template <typename T> bool Serialize::operator()(const std::vector<T> & t, Seria
     return res;
 }
 
-template <typename T> bool Unserialize::operator()(std::vector<T> & t, const char * bufferData, size_t bufferSize, size_t & offset) {
+template <typename TContainer> bool Unserialize::unserializeElements(TContainer & t, const char * bufferData, size_t bufferSize, size_t & offset, std::true_type) {
+    return unserializeBulk(t.data(), t.size(), bufferData, bufferSize, offset, IsVarintEncoded<typename TContainer::value_type>());
+}
+
+template <typename TContainer> bool Unserialize::unserializeElements(TContainer & t, const char * bufferData, size_t bufferSize, size_t & offset, std::false_type) {
     bool res = true;
 
-    int32_t n = 0;
-    res &= operator()(n, bufferData, bufferSize, offset);
+    for (auto & p : t) {
+        if (operator()(p, bufferData, bufferSize, offset) == false) {
+            return false;
+        }
+    }
 
-    t.resize(n);
-    for (int i = 0; i < n; ++i) {
-        res &= operator()(t[i], bufferData, bufferSize, offset);
+    return res;
+}
+
+// the elements of std::vector<bool> are proxies to the packed bits
+template <typename A> bool Unserialize::unserializeElements(std::vector<bool, A> & t, const char * bufferData, size_t bufferSize, size_t & offset, std::false_type) {
+    for (size_t i = 0; i < t.size(); ++i) {
+        bool p = false;
+        if (operator()(p, bufferData, bufferSize, offset) == false) {
+            return false;
+        }
+        t[i] = p;
     }
 
     return true;
 }
 
+template <typename TContainer> size_t SerializedSize::sizeOfElements(const TContainer & t, std::true_type) {
+    return sizeOfBulk(t.data(), t.size(), IsVarintEncoded<typename TContainer::value_type>());
+}
+
+template <typename TContainer> size_t SerializedSize::sizeOfElements(const TContainer & t, std::false_type) {
+    size_t res = 0;
+    for (const auto & p : t) {
+        res += operator()(p);
+    }
+
+    return res;
+}
+
+template <typename T, typename A> bool Serialize::operator()(const std::vector<T, A> & t, SerializationBuffer & buffer, size_t & offset) {
+    bool res = true;
+
+    int32_t n = (int32_t) t.size();
+    res &= operator()(n, buffer, offset);
+    res &= serializeElements(t, buffer, offset, IsBulkSerializable<T>());
+
+    return res;
+}
+
+template <typename T, typename A> size_t SerializedSize::operator()(const std::vector<T, A> & t) {
+    return operator()((int32_t) t.size()) + sizeOfElements(t, IsBulkSerializable<T>());
+}
+
+template <typename T, typename A> bool Unserialize::operator()(std::vector<T, A> & t, const char * bufferData, size_t bufferSize, size_t & offset) {
+    int32_t n = 0;
+    if (operator()(n, bufferData, bufferSize, offset) == false) return false;
+    if (checkLength(n, getMinSerializedSize<T>(encoding), sizeof(T), bufferSize, offset) == false) return false;
+
+    t.resize(n);
+
+    return unserializeElements(t, bufferData, bufferSize, offset, IsBulkSerializable<T>());
+}
+
+// std::array
+
+template <typename T, size_t N> bool Serialize::operator()(const std::array<T, N> & t, SerializationBuffer & buffer, size_t & offset) {
+    return serializeElements(t, buffer, offset, IsBulkSerializable<T>());
+}
+
+template <typename T, size_t N> size_t SerializedSize::operator()(const std::array<T, N> & t) {
+    return sizeOfElements(t, IsBulkSerializable<T>());
+}
+
+template <typename T, size_t N> bool Unserialize::operator()(std::array<T, N> & t, const char * bufferData, size_t bufferSize, size_t & offset) {
+    return unserializeElements(t, bufferData, bufferSize, offset, IsBulkSerializable<T>());
+}
+
 // std::shared_ptr
 
 template <typename T> bool Serialize::operator()(const std::shared_ptr<T> & t, SerializationBuffer & buffer, size_t & offset) {
     return t ? operator()(*t, buffer, offset) : false;
 }
 
+template <typename T> size_t SerializedSize::operator()(const std::shared_ptr<T> & t) {
+    return t ? operator()(*t) : 0;
+}
+
 template <typename T> bool Unserialize::operator()(std::shared_ptr<T> & t, const char * bufferData, size_t bufferSize, size_t & offset) {
     bool res = true;
 
@@ -112,7 +472,7 @@ template <typename T> bool Unserialize::operator()(std::shared_ptr<T> & t, const
     res &= operator()(*tmp, bufferData, bufferSize, offset);
     t = tmp;
 
-    return true;
+    return res;
 }
 
 // std::pair
@@ -126,6 +486,10 @@ template <typename First, typename Second> bool Serialize::operator()(const std:
     return res;
 }
 
+template <typename First, typename Second> size_t SerializedSize::operator()(const std::pair<First, Second> & t) {
+    return operator()(t.first) + operator()(t.second);
+}
+
 template <typename First, typename Second> bool Unserialize::operator()( std::pair<First, Second> & t, const char * bufferData, size_t bufferSize, size_t & offset) {
     bool res = true;
 
@@ -137,7 +501,11 @@ template <typename First, typename Second> bool Unserialize::operator()( std::pa
 
 // std::map
 
-template <typename Key, typename Value> bool Serialize::operator()(const std::map<Key, Value> & t, SerializationBuffer & buffer, size_t & offset) {
+// keys that take an allocator, e.g. the ArenaString keys of an ArenaMap, are constructed with the map's
+template <typename T, typename A> T makeElement(const A & , std::false_type) { return T(); }
+template <typename T, typename A> T makeElement(const A & allocator, std::true_type) { return T(allocator); }
+
+template <typename K, typename V, typename C, typename A> bool Serialize::operator()(const std::map<K, V, C, A> & t, SerializationBuffer & buffer, size_t & offset) {
     bool res = true;
 
     int32_t n = (int32_t) t.size();
@@ -150,20 +518,86 @@ template <typename Key, typename Value> bool Serialize::operator()(const std::ma
     return res;
 }
 
-template <typename Key, typename Value> bool Unserialize::operator()(std::map<Key, Value> & t, const char * bufferData, size_t bufferSize, size_t & offset) {
+template <typename K, typename V, typename C, typename A> size_t SerializedSize::operator()(const std::map<K, V, C, A> & t) {
+    size_t res = operator()((int32_t) t.size());
+    for (const auto & p : t) {
+        res += operator()(p.first);
+        res += operator()(p.second);
+    }
+
+    return res;
+}
+
+template <typename K, typename V, typename C, typename A> bool Unserialize::operator()(std::map<K, V, C, A> & t, const char * bufferData, size_t bufferSize, size_t & offset) {
     bool res = true;
 
     int32_t n = 0;
-    res &= operator()(n, bufferData, bufferSize, offset);
-    for (int i = 0; i < n; ++i) {
-        Key k;
-        Value v;
+    if (operator()(n, bufferData, bufferSize, offset) == false) return false;
+    if (checkLength(n, getMinSerializedSize<K>(encoding) + getMinSerializedSize<V>(encoding), sizeof(typename std::map<K, V, C, A>::value_type), bufferSize, offset) == false) return false;
+
+    for (int i = 0; i < n && res; ++i) {
+        K k = makeElement<K>(t.get_allocator(), std::uses_allocator<K, A>());
         res &= operator()(k, bufferData, bufferSize, offset);
-        res &= operator()(v, bufferData, bufferSize, offset);
-        t[k] = std::move(v);
+
+        // the keys were written in order, so each one goes to the end - the value is unserialized in place
+        const size_t nBefore = t.size();
+        auto it = t.emplace_hint(t.end(), std::piecewise_construct, std::forward_as_tuple(std::move(k)), std::forward_as_tuple());
+
+        // a key that is already in the map gets the new value instead of having it merged into the old one
+        if (t.size() == nBefore) {
+            it->second = makeElement<V>(t.get_allocator(), std::uses_allocator<V, A>());
+        }
+        res &= operator()(it->second, bufferData, bufferSize, offset);
     }
 
     return res;
 }
 
+// BlobView, StringView - defined in serialization.cpp
+
+template <> bool Serialize::operator()<BlobView>(const BlobView & t, SerializationBuffer & buffer, size_t & offset);
+template <> bool Serialize::operator()<StringView>(const StringView & t, SerializationBuffer & buffer, size_t & offset);
+template <> size_t SerializedSize::operator()<BlobView>(const BlobView & t);
+template <> size_t SerializedSize::operator()<StringView>(const StringView & t);
+template <> bool Unserialize::operator()<BlobView>(BlobView & t, const char * bufferData, size_t bufferSize, size_t & offset);
+template <> bool Unserialize::operator()<StringView>(StringView & t, const char * bufferData, size_t bufferSize, size_t & offset);
+
+// ArenaString - defined in serialization.cpp
+
+template <> bool Serialize::operator()<ArenaString>(const ArenaString & t, SerializationBuffer & buffer, size_t & offset);
+template <> size_t SerializedSize::operator()<ArenaString>(const ArenaString & t);
+template <> bool Unserialize::operator()<ArenaString>(ArenaString & t, const char * bufferData, size_t bufferSize, size_t & offset);
+
+#if __cplusplus >= 201703L
+
+// std::string_view
+
+template <> inline bool Serialize::operator()<std::string_view>(const std::string_view & t, SerializationBuffer & buffer, size_t & offset) {
+    StringView view;
+    view.data = t.data();
+    view.size = t.size();
+
+    return operator()(view, buffer, offset);
+}
+
+template <> inline size_t SerializedSize::operator()<std::string_view>(const std::string_view & t) {
+    StringView view;
+    view.data = t.data();
+    view.size = t.size();
+
+    return operator()(view);
+}
+
+template <> inline bool Unserialize::operator()<std::string_view>(std::string_view & t, const char * bufferData, size_t bufferSize, size_t & offset) {
+    StringView view;
+    if (operator()(view, bufferData, bufferSize, offset) == false) {
+        return false;
+    }
+    t = std::string_view(view.data, view.size);
+
+    return true;
+}
+
+#endif
+
 }
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace GGSock {
+    // Hierarchical timer wheel - O(1) schedule and cancel for large numbers of timers
+    // 4 levels of 256 slots each, so the longest delay is 2^32 ticks. expired timers fire from update(), which
+    // should be called from the application's event loop at least once per tick
+    class TimerWheel {
+        public:
+            using TTimerId = uint64_t;
+            using CBTimer = std::function<void()>;
+
+            TimerWheel(int32_t tickResolution_ms = 1);
+            ~TimerWheel();
+
+            // fire the timers whose deadline has passed, return the number of fired timers
+            // the callbacks are invoked without holding the internal lock, so they can schedule and cancel timers
+            int32_t update();
+
+            // returns 0 on failure, delay_ms is rounded up to whole ticks
+            TTimerId schedule(int32_t delay_ms, CBTimer && callback);
+
+            // move the deadline of a pending timer, e.g. to extend an idle timeout
+            bool reschedule(TTimerId id, int32_t delay_ms);
+            bool cancel(TTimerId id);
+
+            int32_t getNumTimers() const;
+
+            // time until the earliest pending deadline, 0 if already due, -1 if there are no timers
+            int32_t getTimeToNext_ms() const;
+
+        private:
+            struct Data;
+            std::unique_ptr<Data> data_;
+            Data & getData() { return *data_; }
+            const Data & getData() const { return *data_; }
+    };
+}
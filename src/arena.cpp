@@ -0,0 +1,77 @@
+#include "ggsock/arena.h"
+
+#include <algorithm>
+
+namespace GGSock {
+    struct Arena::Data {
+        size_t blockSize_bytes = 0;
+
+        std::vector<std::unique_ptr<char[]>> blocks;
+        std::vector<size_t> blockSizes;
+
+        char * cur = nullptr;
+        char * end = nullptr;
+
+        size_t nBytesAllocated = 0;
+        size_t nBytesReserved = 0;
+
+        void addBlock(size_t nBytes) {
+            nBytes = (std::max)(nBytes, blockSize_bytes);
+
+            blocks.emplace_back(new char[nBytes]);
+            blockSizes.push_back(nBytes);
+
+            cur = blocks.back().get();
+            end = cur + nBytes;
+
+            nBytesReserved += nBytes;
+        }
+    };
+
+    Arena::Arena(size_t blockSize_bytes) : data_(new Data()) {
+        getData().blockSize_bytes = (std::max)(blockSize_bytes, (size_t) 1024);
+    }
+
+    Arena::~Arena() {
+    }
+
+    void * Arena::allocate(size_t nBytes, size_t alignment) {
+        auto & data = getData();
+
+        uintptr_t p = ((uintptr_t) data.cur + alignment - 1) & ~(uintptr_t) (alignment - 1);
+        if (data.cur == nullptr || p + nBytes > (uintptr_t) data.end) {
+            data.addBlock(nBytes + alignment);
+            p = ((uintptr_t) data.cur + alignment - 1) & ~(uintptr_t) (alignment - 1);
+        }
+
+        data.cur = (char *) (p + nBytes);
+        data.nBytesAllocated += nBytes;
+
+        return (void *) p;
+    }
+
+    void Arena::reset() {
+        auto & data = getData();
+
+        if (data.blocks.empty()) {
+            return;
+        }
+
+        data.blocks.resize(1);
+        data.blockSizes.resize(1);
+
+        data.cur = data.blocks[0].get();
+        data.end = data.cur + data.blockSizes[0];
+
+        data.nBytesAllocated = 0;
+        data.nBytesReserved = data.blockSizes[0];
+    }
+
+    size_t Arena::getNumBytesAllocated() const {
+        return getData().nBytesAllocated;
+    }
+
+    size_t Arena::getNumBytesReserved() const {
+        return getData().nBytesReserved;
+    }
+}
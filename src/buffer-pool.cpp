@@ -0,0 +1,170 @@
+#include "ggsock/buffer-pool.h"
+
+#include <algorithm>
+#include <array>
+#include <mutex>
+
+namespace {
+    using TBuffer = ::GGSock::SerializationBuffer;
+
+    constexpr size_t kMinClassBits = 6;
+    constexpr size_t kMaxClassBits = 20;
+    constexpr size_t kNumClasses = kMaxClassBits - kMinClassBits + 1;
+
+    // idle buffers kept per size class - the counts limit the small classes, the bytes the large ones
+    constexpr size_t kMaxCachedBytesPerClass = 4*1024*1024;
+    constexpr size_t kMaxCachedBuffersPerClass = 1024;
+    constexpr size_t kMaxThreadCachedBytesPerClass = 256*1024;
+    constexpr size_t kMaxThreadCachedBuffersPerClass = 64;
+
+    size_t getClassSize(size_t id) {
+        return (size_t) 1 << (kMinClassBits + id);
+    }
+
+    // smallest class that fits nBytes
+    size_t getClassIdToFit(size_t nBytes) {
+        size_t id = 0;
+        while (getClassSize(id) < nBytes) {
+            ++id;
+        }
+
+        return id;
+    }
+
+    // largest class that a buffer with this capacity can serve, kNumClasses if none
+    size_t getClassIdOfCapacity(size_t capacity) {
+        if (capacity < getClassSize(0) || capacity >= 2*getClassSize(kNumClasses - 1)) {
+            return kNumClasses;
+        }
+
+        size_t id = 0;
+        while (id + 1 < kNumClasses && getClassSize(id + 1) <= capacity) {
+            ++id;
+        }
+
+        return id;
+    }
+
+    size_t getMaxCached(size_t id) {
+        return (std::min)(kMaxCachedBuffersPerClass, kMaxCachedBytesPerClass/getClassSize(id));
+    }
+
+    size_t getMaxThreadCached(size_t id) {
+        return (std::max)((size_t) 1, (std::min)(kMaxThreadCachedBuffersPerClass, kMaxThreadCachedBytesPerClass/getClassSize(id)));
+    }
+
+    struct Pool {
+        std::mutex mutex;
+        std::array<std::vector<TBuffer>, kNumClasses> freeBuffers;
+        size_t nBytesCached = 0;
+    };
+
+    // never destroyed, so buffers can be released from static destructors
+    Pool & getPool() {
+        static Pool * pool = new Pool();
+        return *pool;
+    }
+
+    void releaseToPool(TBuffer && buffer, size_t id) {
+        auto & pool = getPool();
+
+        std::lock_guard<std::mutex> lock(pool.mutex);
+
+        auto & freeBuffers = pool.freeBuffers[id];
+        if (freeBuffers.size() < getMaxCached(id)) {
+            pool.nBytesCached += buffer.capacity();
+            freeBuffers.emplace_back(std::move(buffer));
+        }
+    }
+
+    // set when the cache of the current thread has been destroyed, so late releases go to the shared pool
+    thread_local bool isThreadCacheDestroyed = false;
+
+    struct ThreadCache {
+        ~ThreadCache() {
+            isThreadCacheDestroyed = true;
+            for (size_t id = 0; id < kNumClasses; ++id) {
+                for (auto & buffer : freeBuffers[id]) {
+                    releaseToPool(std::move(buffer), id);
+                }
+            }
+        }
+
+        std::array<std::vector<TBuffer>, kNumClasses> freeBuffers;
+    };
+
+    ThreadCache * getThreadCache() {
+        if (isThreadCacheDestroyed) {
+            return nullptr;
+        }
+
+        static thread_local ThreadCache cache;
+        return &cache;
+    }
+}
+
+namespace GGSock {
+namespace BufferPool {
+    SerializationBuffer acquire(size_t nBytes) {
+        SerializationBuffer result;
+
+        if (nBytes > ::getClassSize(kNumClasses - 1)) {
+            result.reserve(nBytes);
+            return result;
+        }
+
+        const size_t id = ::getClassIdToFit(nBytes);
+
+        auto cache = ::getThreadCache();
+        if (cache && cache->freeBuffers[id].empty() == false) {
+            result = std::move(cache->freeBuffers[id].back());
+            cache->freeBuffers[id].pop_back();
+            return result;
+        }
+
+        {
+            auto & pool = ::getPool();
+
+            std::lock_guard<std::mutex> lock(pool.mutex);
+
+            auto & freeBuffers = pool.freeBuffers[id];
+            if (freeBuffers.empty() == false) {
+                result = std::move(freeBuffers.back());
+                freeBuffers.pop_back();
+                pool.nBytesCached -= result.capacity();
+                return result;
+            }
+        }
+
+        result.reserve(::getClassSize(id));
+
+        return result;
+    }
+
+    void release(std::vector<char> & buffer) {
+        const size_t id = ::getClassIdOfCapacity(buffer.capacity());
+        if (id < kNumClasses) {
+            TBuffer pooled;
+            static_cast<std::vector<char> &>(pooled).swap(buffer);
+            pooled.clear();
+
+            auto cache = ::getThreadCache();
+            if (cache && cache->freeBuffers[id].size() < ::getMaxThreadCached(id)) {
+                cache->freeBuffers[id].emplace_back(std::move(pooled));
+            } else {
+                ::releaseToPool(std::move(pooled), id);
+            }
+        }
+
+        std::vector<char>().swap(buffer);
+    }
+
+    size_t getNumBytesCached() {
+        auto & pool = ::getPool();
+
+        std::lock_guard<std::mutex> lock(pool.mutex);
+
+        return pool.nBytesCached;
+    }
+}
+}
@@ -0,0 +1,161 @@
+#include "ggsock/communicator-group.h"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace GGSock {
+    struct CommunicatorGroup::Data {
+        using TClock = std::chrono::steady_clock;
+
+        Data(const Parameters & parameters) : parameters(parameters) {}
+
+        bool waitForRoom(Communicator & communicator) const {
+            const auto tEnd = TClock::now() + std::chrono::milliseconds(parameters.blockTimeout_ms);
+            while (communicator.isSendQueueFull()) {
+                if (communicator.isConnected() == false || TClock::now() >= tEnd) {
+                    return false;
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+
+            return true;
+        }
+
+        const Parameters parameters;
+
+        mutable std::mutex mutex;
+        std::vector<TCommunicator> members;
+
+        Stats stats;
+    };
+
+    CommunicatorGroup::CommunicatorGroup() : data_(new Data(Parameters())) {
+    }
+
+    CommunicatorGroup::CommunicatorGroup(const Parameters & parameters) : data_(new Data(parameters)) {
+    }
+
+    CommunicatorGroup::~CommunicatorGroup() {
+    }
+
+    bool CommunicatorGroup::add(const TCommunicator & communicator) {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+
+        if (communicator == nullptr) return false;
+        if (std::find(data.members.begin(), data.members.end(), communicator) != data.members.end()) return false;
+
+        data.members.push_back(communicator);
+
+        return true;
+    }
+
+    bool CommunicatorGroup::remove(const TCommunicator & communicator) {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+
+        auto it = std::find(data.members.begin(), data.members.end(), communicator);
+        if (it == data.members.end()) return false;
+
+        data.members.erase(it);
+
+        return true;
+    }
+
+    void CommunicatorGroup::clear() {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+
+        data.members.clear();
+    }
+
+    int32_t CommunicatorGroup::size() const {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+
+        return (int32_t) data.members.size();
+    }
+
+    int32_t CommunicatorGroup::send(Communicator::TMessageType type) {
+        return send(Communicator::makeSharedFrame(type));
+    }
+
+    int32_t CommunicatorGroup::send(Communicator::TMessageType type, const char * dataBuffer, Communicator::TBufferSize dataSize) {
+        return send(Communicator::makeSharedFrame(type, dataBuffer, dataSize));
+    }
+
+    int32_t CommunicatorGroup::send(const Communicator::TSharedFrame & frame) {
+        auto & data = getData();
+
+        if (frame == nullptr) return 0;
+
+        // the members are called without holding the group lock, which may be taken under a member's lock
+        std::vector<TCommunicator> members;
+        {
+            std::lock_guard<std::mutex> lock(data.mutex);
+            members = data.members;
+        }
+
+        Stats stats;
+        stats.nFramesEncoded = 1;
+
+        int32_t nQueued = 0;
+        for (auto & member : members) {
+            if (member->send(frame)) {
+                ++nQueued;
+                continue;
+            }
+
+            // a disconnected member keeps its full queue until it is updated
+            if (member->isConnected() == false) {
+                continue;
+            }
+
+            switch (data.parameters.policy) {
+                case SlowConsumerPolicy::Drop:
+                    break;
+                case SlowConsumerPolicy::Disconnect:
+                    member->disconnect();
+                    ++stats.nDisconnects;
+                    break;
+                case SlowConsumerPolicy::Block:
+                    ++stats.nBlocks;
+                    if (data.waitForRoom(*member) && member->send(frame)) {
+                        ++nQueued;
+                        continue;
+                    }
+                    break;
+            }
+
+            ++stats.nMessagesDropped;
+        }
+
+        stats.nMessagesQueued = nQueued;
+
+        {
+            std::lock_guard<std::mutex> lock(data.mutex);
+            data.stats.nFramesEncoded += stats.nFramesEncoded;
+            data.stats.nMessagesQueued += stats.nMessagesQueued;
+            data.stats.nMessagesDropped += stats.nMessagesDropped;
+            data.stats.nDisconnects += stats.nDisconnects;
+            data.stats.nBlocks += stats.nBlocks;
+        }
+
+        return nQueued;
+    }
+
+    CommunicatorGroup::Stats CommunicatorGroup::getStats() const {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+
+        return data.stats;
+    }
+}
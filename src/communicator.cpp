@@ -1,6 +1,18 @@
 #include "ggsock/communicator.h"
 
+#include "ggsock/buffer-pool.h"
+#include "ggsock/timer-wheel.h"
+
+#include "compression.h"
+#include "crc32c.h"
+
 #ifdef _WIN32
+// WSAPoll is available since Windows Vista
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600
+#elif _WIN32_WINNT < 0x0600
+#error "ggsock requires _WIN32_WINNT >= 0x0600 (Windows Vista) for WSAPoll"
+#endif
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #define close closesocket
@@ -12,8 +24,10 @@
 #include <netinet/in.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netdb.h>
 #include <netinet/tcp.h>
+#include <poll.h>
 #include <signal.h>
 #endif
 #include <sys/types.h>
@@ -23,6 +37,10 @@
 #include <mutex>
 #include <thread>
 #include <array>
+#include <deque>
+#include <random>
+#include <atomic>
+#include <chrono>
 #include <vector>
 #include <condition_variable>
 
@@ -84,21 +102,331 @@ namespace {
 #endif
     }
 
+    // block until the socket is ready or the timeout expires, returns > 0 if ready
+    // poll() instead of select(), so descriptors beyond FD_SETSIZE can be waited on
+    int waitForSocket(TSocketDescriptor sock, bool write, int32_t timeout_ms) {
+#ifdef _WIN32
+        WSAPOLLFD pfd;
+        pfd.fd = sock;
+        pfd.events = write ? POLLWRNORM : POLLRDNORM;
+        pfd.revents = 0;
+
+        return WSAPoll(&pfd, 1, timeout_ms);
+#else
+        pollfd pfd;
+        pfd.fd = sock;
+        pfd.events = write ? POLLOUT : POLLIN;
+        pfd.revents = 0;
+
+        return poll(&pfd, 1, timeout_ms);
+#endif
+    }
+
+    // block until the socket is writable, e.g. a non-blocking connect has completed or failed
+    bool waitForWritable(TSocketDescriptor sock, int32_t timeout_ms) {
+        return waitForSocket(sock, true, timeout_ms) > 0;
+    }
+
+    TSocketDescriptor createSocket() {
+        TSocketDescriptor sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+        int enable = 1;
+        if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (char *)&enable, sizeof(int)) < 0) {
+            fprintf(stderr, "setsockopt(SO_REUSEADDR) failed");
+        }
+
+#ifndef _WIN32
+        if (setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, (char *)&enable, sizeof(int)) < 0) {
+            fprintf(stderr, "setsockopt(SO_REUSEPORT) failed");
+        }
+#endif
+
+        //{
+        //    linger lin;
+        //    lin.l_onoff = 0;
+        //    lin.l_linger = 0;
+        //    if (setsockopt(sock, SOL_SOCKET, SO_LINGER, (const char *)&lin, sizeof(lin)) < 0) {
+        //        fprintf(stderr, "setsockopt(SO_LINGER) failed");
+        //    }
+        //}
+
+        ::setNonBlocking(sock);
+
+        return sock;
+    }
+
+    void setPacingRate(TSocketDescriptor sock, int64_t rate_Bps) {
+#ifdef SO_MAX_PACING_RATE
+        uint32_t rate = (uint32_t) (std::min)(rate_Bps, (int64_t) UINT32_MAX);
+        if (setsockopt(sock, SOL_SOCKET, SO_MAX_PACING_RATE, (char *) &rate, sizeof(rate)) < 0) {
+            fprintf(stderr, "setsockopt(SO_MAX_PACING_RATE) failed");
+        }
+#else
+        (void) sock;
+        (void) rate_Bps;
+#endif
+    }
+
     struct MessageHeader {
-        ::GGSock::Communicator::TBufferSize  size;
+        uint32_t sizeAndFlags;
         ::GGSock::Communicator::TMessageType type;
 
         static constexpr size_t getSizeInBytes() {
             return
-                sizeof(::GGSock::Communicator::TBufferSize) +
+                sizeof(uint32_t) +
                 sizeof(::GGSock::Communicator::TMessageType);
         }
     };
+
+    // the upper bits of the size field in the header carry per-frame flags
+    // flags are set only after the peer has announced support for the corresponding feature
+    // without checksum and compression, the whole size field is used, as in the original frame format
+    constexpr uint32_t kFrameFlagChecksum   = 1u << 31;  // the payload is followed by a CRC32C of the frame
+    constexpr uint32_t kFrameFlagCompressed = 1u << 30;  // the payload is [codec, original size, compressed data]
+    constexpr uint32_t kFrameSizeMask       = (1u << 30) - 1;
+    constexpr uint64_t kFrameSizeMax        = UINT32_MAX;
+
+    constexpr size_t kChecksumSize = sizeof(uint32_t);
+    constexpr size_t kCompressedHeaderSize = sizeof(uint8_t) + sizeof(uint32_t);
+
+    // frames are queued with the fixed header - larger frames have 0 in the size field. they are re-framed when sent,
+    // either with the varint header or, if the peer does not use frame flags, with the whole 32-bit size field
+    void writeFixedHeader(char * dst, uint64_t frameSize, uint32_t flags, ::GGSock::Communicator::TMessageType type) {
+        uint32_t sizeAndFlags = (frameSize <= kFrameSizeMask ? (uint32_t) frameSize : 0u) | flags;
+
+        memcpy(dst, &sizeAndFlags, sizeof(sizeAndFlags));
+        memcpy(dst + sizeof(sizeAndFlags), &type, sizeof(type));
+    }
+
+    // varint header: [varint (body size << 2 | flags)][varint type], where the body is the payload and the checksum
+    // the checksum still covers the equivalent fixed header, so queued frames are re-framed without recomputing it
+    constexpr uint64_t kVarintFlagChecksum   = 1 << 0;
+    constexpr uint64_t kVarintFlagCompressed = 1 << 1;
+    constexpr uint64_t kVarintMaxBodySize    = (1ull << 62) - 1;
+
+    constexpr size_t kVarintMaxSize = 10;
+    constexpr size_t kVarintHeaderMaxSize = kVarintMaxSize + 3;
+
+    size_t encodeVarint(uint64_t value, char * dst) {
+        size_t n = 0;
+        while (value >= 0x80) {
+            dst[n++] = (char) ((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        dst[n++] = (char) value;
+
+        return n;
+    }
+
+    // returns the number of bytes read, 0 if more bytes are needed or -1 if the value does not fit in 64 bits
+    int32_t decodeVarint(const char * src, size_t nAvailable, uint64_t & value) {
+        value = 0;
+        for (size_t i = 0; i < kVarintMaxSize; ++i) {
+            if (i == nAvailable) {
+                return 0;
+            }
+
+            const uint64_t byte = (uint8_t) src[i];
+            if (i == kVarintMaxSize - 1 && byte > 1) {
+                return -1;
+            }
+
+            value |= (byte & 0x7F) << (7*i);
+            if ((byte & 0x80) == 0) {
+                return (int32_t) i + 1;
+            }
+        }
+
+        return -1;
+    }
+
+    size_t encodeVarintHeader(char * dst, uint64_t bodySize, uint32_t flags, ::GGSock::Communicator::TMessageType type) {
+        uint64_t sizeAndFlags = bodySize << 2;
+        if (flags & kFrameFlagChecksum)   sizeAndFlags |= kVarintFlagChecksum;
+        if (flags & kFrameFlagCompressed) sizeAndFlags |= kVarintFlagCompressed;
+
+        size_t n = encodeVarint(sizeAndFlags, dst);
+        n += encodeVarint(type, dst + n);
+
+        return n;
+    }
+
+    // same return value as decodeVarint
+    int32_t decodeVarintHeader(const char * src, size_t nAvailable, uint64_t & bodySize, uint32_t & flags, ::GGSock::Communicator::TMessageType & type) {
+        uint64_t sizeAndFlags = 0;
+        int32_t n0 = decodeVarint(src, nAvailable, sizeAndFlags);
+        if (n0 <= 0) {
+            return n0;
+        }
+
+        uint64_t value = 0;
+        int32_t n1 = decodeVarint(src + n0, nAvailable - n0, value);
+        if (n1 <= 0) {
+            return n1;
+        }
+        if (value > UINT16_MAX) {
+            return -1;
+        }
+
+        bodySize = sizeAndFlags >> 2;
+        flags =
+            ((sizeAndFlags & kVarintFlagChecksum)   ? kFrameFlagChecksum   : 0u) |
+            ((sizeAndFlags & kVarintFlagCompressed) ? kFrameFlagCompressed : 0u);
+        type = (::GGSock::Communicator::TMessageType) value;
+
+        return n0 + n1;
+    }
+
+    // msg holds space for the header, followed by the payload
+    template <typename TMsg>
+    void finalizeMessage(TMsg & msg, ::GGSock::Communicator::TMessageType type, uint32_t flags) {
+        const bool withChecksum = (flags & kFrameFlagChecksum) != 0;
+
+        writeFixedHeader(&msg[0], msg.size() + (withChecksum ? kChecksumSize : 0), flags, type);
+
+        if (withChecksum) {
+            uint32_t crc = ::GGSock::CRC32C::compute(msg.data(), msg.size());
+            msg.insert(msg.end(), reinterpret_cast<const char*>(&crc), reinterpret_cast<const char*>(&crc)+sizeof(crc));
+        }
+    }
+
+    // msg must be empty, with enough capacity to avoid reallocations
+    template <typename TMsg>
+    void encodeMessage(TMsg & msg, ::GGSock::Communicator::TMessageType type, const char * dataBuffer, ::GGSock::Communicator::TBufferSize dataSize, bool withChecksum) {
+        msg.resize(::MessageHeader::getSizeInBytes());
+        if (dataSize > 0) {
+            msg.insert(msg.end(), dataBuffer, dataBuffer + dataSize);
+        }
+
+        ::finalizeMessage(msg, type, withChecksum ? kFrameFlagChecksum : 0);
+    }
+
+    size_t getMessageSize(::GGSock::Communicator::TBufferSize dataSize, bool withChecksum) {
+        return ::MessageHeader::getSizeInBytes() + dataSize + (withChecksum ? kChecksumSize : 0);
+    }
+
+    ::GGSock::SerializationBuffer makeMessage(::GGSock::Communicator::TMessageType type, const char * dataBuffer, ::GGSock::Communicator::TBufferSize dataSize, bool withChecksum = false) {
+        auto msg = ::GGSock::BufferPool::acquire(getMessageSize(dataSize, withChecksum));
+        encodeMessage(msg, type, dataBuffer, dataSize, withChecksum);
+
+        return msg;
+    }
+
+    // grow the buffer to at least nBytes, taking a larger one from the pool if needed
+    void reserveBuffer(::GGSock::SerializationBuffer & buffer, size_t nBytes) {
+        if (buffer.capacity() < nBytes) {
+            ::GGSock::BufferPool::release(buffer);
+            buffer = ::GGSock::BufferPool::acquire(nBytes);
+        }
+        if (buffer.size() < nBytes) {
+            buffer.resize(nBytes);
+        }
+    }
+
+    // grow the buffer to at least nBytes, keeping its first nKeep bytes
+    void growBuffer(::GGSock::SerializationBuffer & buffer, size_t nBytes, size_t nKeep) {
+        auto grown = ::GGSock::BufferPool::acquire(nBytes);
+        grown.insert(grown.end(), buffer.begin(), buffer.begin() + nKeep);
+        grown.resize(grown.capacity());
+
+        ::GGSock::BufferPool::release(buffer);
+        buffer = std::move(grown);
+    }
+
+    // send the header and the start of the body with a single system call
+    int64_t sendGather(TSocketDescriptor sock, const char * header, size_t headerSize, const char * body, size_t bodySize) {
+#ifdef _WIN32
+        WSABUF buffers[2];
+        buffers[0].buf = const_cast<char *>(header);
+        buffers[0].len = (ULONG) headerSize;
+        buffers[1].buf = const_cast<char *>(body);
+        buffers[1].len = (ULONG) bodySize;
+
+        DWORD nSent = 0;
+        if (WSASend(sock, buffers, 2, &nSent, 0, NULL, NULL) != 0) {
+            return -1;
+        }
+
+        return nSent;
+#else
+        iovec buffers[2];
+        buffers[0].iov_base = const_cast<char *>(header);
+        buffers[0].iov_len = headerSize;
+        buffers[1].iov_base = const_cast<char *>(body);
+        buffers[1].iov_len = bodySize;
+
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = buffers;
+        msg.msg_iovlen = 2;
+
+        return sendmsg(sock, &msg, 0);
+#endif
+    }
+
+    // the send queue and the receive buffers are allocated on demand and released when the connection is idle
+    constexpr int32_t kSendQueueSize = 128;
+    constexpr size_t kRecvChunk_bytes = 16*1024;
+    constexpr size_t kRecvBufferKeep_bytes = 64*1024;
+    constexpr int64_t kIdleRelease_ms = 1000;
+
+    // longest wait for a throttled frame - shorter than the shared rate limiter's waiter timeout
+    constexpr int64_t kThrottleWaitMax_ms = 50;
+
+    // a queued frame, either owned by this connection or shared with other connections
+    struct OutgoingFrame {
+        OutgoingFrame() = default;
+        OutgoingFrame(::GGSock::SerializationBuffer && owned) : owned(std::move(owned)) {}
+
+        ::GGSock::SerializationBuffer owned;
+        ::GGSock::Communicator::TSharedFrame shared;
+
+        const char * data() const { return shared ? shared->data() : owned.data(); }
+        size_t size() const { return shared ? shared->size() : owned.size(); }
+
+        // owned buffers go back to the pool
+        void clear() {
+            ::GGSock::BufferPool::release(owned);
+            shared.reset();
+        }
+    };
+
+    // internal messages, never passed to the message callbacks
+    enum ControlMessageType : ::GGSock::Communicator::TMessageType {
+        MsgHello = ::GGSock::Communicator::MsgReserved, // [features, session id, last received seq]
+        MsgSessionAck,                                  // [last received seq]
+        MsgHeartbeat,                                   // []
+        MsgFrameHeader,                                 // [] - the sender's following frames have the varint header
+    };
+
+    // optional protocol features, announced in the hello message and used only if both sides support them
+    enum Feature : uint32_t {
+        FeatureSession      = 1 << 0,
+        FeatureChecksum     = 1 << 1,
+        FeatureCompressLZ4  = 1 << 2,
+        FeatureCompressZstd = 1 << 3,
+        FeatureVarintHeader = 1 << 4,
+    };
+
+    // features that need flags in the size field of the fixed header
+    constexpr uint32_t kFrameFlagFeatures = FeatureChecksum | FeatureCompressLZ4 | FeatureCompressZstd;
+
+    struct Hello {
+        uint32_t features = 0;
+        uint64_t sessionId = 0;
+        uint64_t seq = 0;
+
+        static constexpr size_t getSizeInBytes() {
+            return sizeof(features) + sizeof(sessionId) + sizeof(seq);
+        }
+    };
 }
 
 namespace GGSock {
     struct Communicator::Data {
-        Data(bool startOwnWorker) {
+        using TClock = std::chrono::high_resolution_clock;
+
+        Data(bool startOwnWorker, const WorkerParameters & workerParameters) : workerParameters(workerParameters) {
             // todo : maybe move this to a static method
             static bool isFirst = true;
             if (isFirst) {
@@ -122,20 +450,35 @@ namespace GGSock {
 
             std::lock_guard<std::mutex> lock(mutex);
 
-            bufferDataRecv.resize(256*1024, 0);
+            stats.spinBudget_us = workerParameters.spinBudgetMin_us;
 
             if (startOwnWorker) {
                 isRunning = true;
                 worker = std::thread([this]() {
-                    while (isRunning) {
-                        update();
-                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
-                    }
+                    switch (this->workerParameters.mode) {
+                        case WorkerMode::Sleep:
+                            {
+                                while (isRunning) {
+                                    update();
+                                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                                }
+                            }
+                            break;
+                        case WorkerMode::BusyPoll:
+                            {
+                                workerBusyPoll();
+                            }
+                            break;
+                    };
                 });
             }
         }
 
         ~Data() {
+            if (sharedRateLimiter) {
+                sharedRateLimiter->cancel(this);
+            }
+
             {
                 std::lock_guard<std::mutex> lock(mutex);
                 isRunning = false;
@@ -153,6 +496,9 @@ namespace GGSock {
 
         bool update() {
             std::lock_guard<std::mutex> lock(mutex);
+            if (timers) {
+                timers->update();
+            }
             if (isServer && isListening) {
                 doListen();
             } else if (isServer && isListening == false && isConnected) {
@@ -162,276 +508,1164 @@ namespace GGSock {
             } else if (isServer == false && isConnecting == false && isConnected) {
                 doRead();
             }
+            bool hasSendQueueRoom = false;
+            int32_t nFramesRejected = 0;
             {
                 std::lock_guard<std::mutex> lock(mutexSend);
-                if (isConnected && (rbHead != rbEnd)) {
+                const bool wasSendQueueFull = isSendQueueFull();
+                if (isConnected && hasSession && sessionReady) {
+                    updateSessionAck();
+                }
+                if (isConnected && hasPendingSend()) {
                     doSend();
                 }
                 if (isConnected == false) {
-                    rbHead = rbEnd;
+                    // with a session, the queue is kept until the connection is resumed
+                    if (hasSession == false) {
+                        clearSendQueue();
+                    }
+                    if (sharedRateLimiter) {
+                        sharedRateLimiter->cancel(this);
+                    }
+                    nBytesThrottled = 0;
+                }
+                if (ringBufferSend.empty() == false && rbHead == rbEnd && (isConnected == false || isIdle())) {
+                    std::vector<::OutgoingFrame>().swap(ringBufferSend);
+                    rbHead = rbEnd = 0;
                 }
+                hasSendQueueRoom = wasSendQueueFull && isSendQueueFull() == false;
+                nFramesRejected = nFramesTooLarge;
+                nFramesTooLarge = 0;
             }
 
+            for (int32_t i = 0; i < nFramesRejected && errorCallback; ++i) {
+                errorCallback(ErrorFrameTooLarge);
+            }
+
+            // outside of the send lock, so the callback can send
+            if (hasSendQueueRoom && sendQueueCallback) {
+                sendQueueCallback();
+            }
+
+            releaseReceiveBuffers();
+
             return true;
         }
 
-        bool doListen() {
-            FD_ZERO(&master_set);
-            max_sd = sd;
-            FD_SET(sd, &master_set);
+        bool isIdle() const {
+            auto tNow = TClock::now();
+            return
+                std::chrono::duration_cast<std::chrono::milliseconds>(tNow - tLastReceive).count() > ::kIdleRelease_ms &&
+                std::chrono::duration_cast<std::chrono::milliseconds>(tNow - tLastSend).count() > ::kIdleRelease_ms;
+        }
 
-            memcpy(&working_set, &master_set, sizeof(master_set));
+        //
+        // timers - fired from update(), with the mutex held
+        //
 
-            timeout.tv_sec  = timeoutListen_ms/1000;
-            timeout.tv_usec = (timeoutListen_ms%1000)*1000;
+        TimerWheel & getTimers() {
+            if (timers == nullptr) {
+                timers.reset(new TimerWheel());
+            }
 
-            int rc = select(max_sd + 1, &working_set, NULL, NULL, &timeout);
-            if (rc < 0) {
-                return false;
+            return *timers;
+        }
+
+        void scheduleTimer(TimerWheel::TTimerId & id, int64_t delay_ms, TimerWheel::CBTimer && callback) {
+            cancelTimer(id);
+            id = getTimers().schedule((int32_t) (std::min)(delay_ms, (int64_t) INT32_MAX), std::move(callback));
+        }
+
+        void cancelTimer(TimerWheel::TTimerId & id) {
+            if (id != 0 && timers) {
+                timers->cancel(id);
+            }
+            id = 0;
+        }
+
+        //
+        // keep-alive
+        //
+
+        void startKeepAlive() {
+            if (idleTimeout_ms > 0) {
+                scheduleTimer(idleTimerId, idleTimeout_ms, [this]() { onIdleTimer(); });
+            } else {
+                cancelTimer(idleTimerId);
             }
 
-            if (rc == 0) {
-                return false;
+            if (heartbeatInterval_ms > 0) {
+                scheduleTimer(heartbeatTimerId, heartbeatInterval_ms, [this]() { onHeartbeatTimer(); });
+            } else {
+                cancelTimer(heartbeatTimerId);
+            }
+        }
+
+        void stopKeepAlive() {
+            cancelTimer(idleTimerId);
+            cancelTimer(heartbeatTimerId);
+        }
+
+        // the timer is not moved on every received frame - when it fires, it is re-armed for the remaining time
+        void onIdleTimer() {
+            idleTimerId = 0;
+            if (isConnected == false || idleTimeout_ms <= 0) {
+                return;
             }
 
-            int ndesc = rc;
-            if (ndesc != 1) {
-                printf("WARNING: ndesc = %d\n", ndesc);
+            const int64_t tElapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(TClock::now() - tLastReceive).count();
+            if (tElapsed_ms >= idleTimeout_ms) {
+                onConnectionLost(ErrorIdleTimeout);
+                return;
             }
 
-            if (FD_ISSET(sd, &working_set)) {
-                --ndesc;
+            scheduleTimer(idleTimerId, idleTimeout_ms - tElapsed_ms, [this]() { onIdleTimer(); });
+        }
 
-                do {
-                    sdpeer = accept(sd, NULL, NULL);
-                    if (sdpeer < 0) {
-                        if (e_wouldBlock() == false) {
-                            perror("  accept() failed");
-                        }
-                        return false;
+        void onHeartbeatTimer() {
+            heartbeatTimerId = 0;
+            if (isConnected == false || heartbeatInterval_ms <= 0) {
+                return;
+            }
+
+            int64_t tElapsed_ms = 0;
+            {
+                std::lock_guard<std::mutex> lockSend(mutexSend);
+
+                tElapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(TClock::now() - tLastSend).count();
+                if (tElapsed_ms >= heartbeatInterval_ms) {
+                    if (controlSend.empty()) {
+                        controlSend.push_back(::makeMessage(::MsgHeartbeat, nullptr, 0));
                     }
+                    tElapsed_ms = 0;
+                }
+            }
 
-                    socklen_t len;
-                    len = sizeof(peeraddr);
-                    getpeername(sdpeer, (struct sockaddr*)&peeraddr, &len);
+            scheduleTimer(heartbeatTimerId, heartbeatInterval_ms - tElapsed_ms, [this]() { onHeartbeatTimer(); });
+        }
 
-                    printf("  New incoming connection - %d, %d, ip = %s\n", sd, sdpeer, inet_ntoa(peeraddr.sin_addr));
+        // give the receive buffers back to the pool after a large message and when the connection goes idle
+        void releaseReceiveBuffers() {
+            if (isConnected == false) {
+                recvBegin = recvEnd = 0;
+            }
 
-                    ::setNonBlocking(sdpeer);
+            if (bufferRecv.capacity() == 0 && bufferDecompressed.capacity() == 0) {
+                return;
+            }
 
-                    isListening = false;
-                    isConnected = true;
+            const bool release = isConnected == false || isIdle();
 
-                    // stop listening for connections
-                    ::closeAndReset(sd);
+            // a partially received frame is kept
+            if (recvBegin == recvEnd && (release || bufferRecv.capacity() > ::kRecvBufferKeep_bytes)) {
+                BufferPool::release(bufferRecv);
+                recvBegin = recvEnd = 0;
+            }
+            if (release || bufferDecompressed.capacity() > ::kRecvBufferKeep_bytes) {
+                BufferPool::release(bufferDecompressed);
+            }
+        }
 
-                    break;
-                } while (sdpeer != -1);
-            } else {
-                return false;
+        size_t getMemoryUsage() const {
+            size_t result = sizeof(Data);
+
+            result += bufferRecv.capacity() + bufferDecompressed.capacity();
+            result += ringBufferSend.capacity()*sizeof(::OutgoingFrame);
+            for (const auto & frame : ringBufferSend) {
+                result += frame.owned.capacity();
+            }
+            for (const auto & frame : sessionReplay) {
+                result += sizeof(frame) + frame.second.owned.capacity();
+            }
+            for (const auto & frame : controlSend) {
+                result += sizeof(frame) + frame.owned.capacity();
             }
 
-            return true;
+            return result;
         }
 
-        bool doConnect() {
-            auto tStart = std::chrono::high_resolution_clock::now();
+        void onConnectionLost(TErrorCode errorCode) {
+            isConnected = false;
+            isListening = false;
+            ::closeAndReset(sdpeer);
+            ::closeAndReset(sd);
 
-            while (isConnecting) {
-                auto rc = ::connect(sd, (struct sockaddr *) &addr, sizeof(addr));
-                if (rc < 0 && e_isConnected() == false) {
-                    if (e_inProgress() == false && e_wouldBlock() == false) {
-                        ::closeAndReset(sd);
-                        sd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            stopKeepAlive();
 
-                        int enable = 1;
-                        if (setsockopt(sd, SOL_SOCKET, SO_REUSEADDR, (char *)&enable, sizeof(int)) < 0) {
-                            fprintf(stderr, "setsockopt(SO_REUSEADDR) failed");
-                        }
+            if (hasSession && isServer == false && isReconnecting == false) {
+                isReconnecting = true;
+                reconnectBackoff_ms = sessionParameters.reconnectBackoffMin_ms;
+                scheduleTimer(reconnectTimerId, reconnectBackoff_ms, [this]() { startReconnect(); });
+            }
 
-#ifndef _WIN32
-                        if (setsockopt(sd, SOL_SOCKET, SO_REUSEPORT, (char *)&enable, sizeof(int)) < 0) {
-                            fprintf(stderr, "setsockopt(SO_REUSEPORT) failed");
-                        }
-#endif
+            if (errorCallback) {
+                errorCallback(errorCode);
+            }
+        }
 
-                        //{
-                        //    linger lin;
-                        //    lin.l_onoff = 0;
-                        //    lin.l_linger = 0;
-                        //    if (setsockopt(sd, SOL_SOCKET, SO_LINGER, (const char *)&lin, sizeof(lin)) < 0) {
-                        //        fprintf(stderr, "setsockopt(SO_LINGER) failed");
-                        //    }
-                        //}
+        //
+        // session
+        //
 
-                        ::setNonBlocking(sd);
-                    }
-                    if (timeoutConnect_ms > 0) {
-                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        // the connection is then driven by update(), an attempt that does not complete in time is abandoned
+        void startReconnect() {
+            reconnectTimerId = 0;
+            if (isReconnecting == false || isConnected || isConnecting) {
+                return;
+            }
 
-                        auto tEnd = std::chrono::high_resolution_clock::now();
-                        if (std::chrono::duration_cast<std::chrono::milliseconds>(tEnd - tStart).count() >= timeoutConnect_ms) {
-                            ::closeAndReset(sd);
-                            isConnecting = false;
-                        }
-                        continue;
-                    }
+            ::closeAndReset(sd);
+            sd = ::createSocket();
 
-                    return false;
-                }
+            isConnecting = true;
+            timeoutConnect_ms = 0;
+            ++stats.nReconnectAttempts;
 
-                sdpeer = sd;
+            scheduleTimer(reconnectTimerId, sessionParameters.reconnectAttemptTimeout_ms, [this]() { onReconnectTimeout(); });
+        }
 
-                printf("Connected successfully, sd = %d\n", sd);
+        void onReconnectTimeout() {
+            reconnectTimerId = 0;
+            if (isReconnecting == false || isConnecting == false) {
+                return;
+            }
 
-                isConnecting = false;
-                isConnected = true;
+            ::closeAndReset(sd);
+            isConnecting = false;
+            scheduleReconnect();
+        }
 
-                return true;
+        void scheduleReconnect() {
+            reconnectBackoff_ms = (std::min)(2*reconnectBackoff_ms, sessionParameters.reconnectBackoffMax_ms);
+            scheduleTimer(reconnectTimerId, reconnectBackoff_ms, [this]() { startReconnect(); });
+        }
+
+        uint32_t getLocalFeatures() const {
+            return
+                (hasSession  ? (uint32_t) ::FeatureSession  : 0u) |
+                (useChecksum ? (uint32_t) ::FeatureChecksum : 0u) |
+                (compressionCodec != Compression::None ? (uint32_t) ::FeatureCompressLZ4 : 0u) |
+                (compressionCodec != Compression::None && Compression::isAvailable(Compression::Zstd) ? (uint32_t) ::FeatureCompressZstd : 0u) |
+                (useVarintHeader ? (uint32_t) ::FeatureVarintHeader : 0u);
+        }
+
+        // the largest frame that the peer can read with the negotiated header
+        // until the hello is received, the configured features are assumed - frames queued by then that turn out to be
+        // too large are dropped when sent
+        uint64_t getMaxFrameSize() const {
+            const uint32_t features = isHelloReceived ? negotiatedFeatures : getLocalFeatures();
+            if (features & ::FeatureVarintHeader) {
+                return ::kVarintMaxBodySize;
             }
 
-            return false;
+            // the peer may read the upper bits as flags
+            return (features & ::kFrameFlagFeatures) ? ::kFrameSizeMask : ::kFrameSizeMax;
         }
 
-        void doRead() {
-            int rc = (int) recv(sdpeer, bufferHeaderRecv.data(), bufferHeaderRecv.size(), 0);
-            if (rc < 0) {
-                if (e_wouldBlock() == false) {
-                    isConnected = false;
-                    ::closeAndReset(sdpeer);
-                    ::closeAndReset(sd);
+        // reported from update(), outside of the send lock
+        bool checkFrameSize(uint64_t frameSize) {
+            if (frameSize > getMaxFrameSize()) {
+                ++nFramesTooLarge;
+                return false;
+            }
 
-                    TErrorCode errorCode = errno;
-                    if (errorCallback) {
-                        errorCallback(errorCode);
-                    }
-                }
-                return;
+            return true;
+        }
+
+        void updateTxCodec() {
+            txCodec = Compression::None;
+            if (compressionCodec == Compression::Zstd && (negotiatedFeatures & ::FeatureCompressZstd)) {
+                txCodec = Compression::Zstd;
+            } else if (negotiatedFeatures & ::FeatureCompressLZ4) {
+                txCodec = Compression::LZ4;
             }
+        }
 
-            if (rc == 0) {
-                isConnected = false;
-                isListening = false;
-                ::closeAndReset(sdpeer);
-                ::closeAndReset(sd);
+        // the original size in the compressed payload is 32-bit
+        bool isCompressible(TBufferSize dataSize) const {
+            return txCodec != Compression::None && dataSize >= (TBufferSize) compressionParameters.minSize_bytes && dataSize <= ::kFrameSizeMask;
+        }
+
+        // build a frame for an application message, using the features negotiated with the peer
+        SerializationBuffer makeFrame(TMessageType type, const char * dataBuffer, TBufferSize dataSize) {
+            const bool withChecksum = (negotiatedFeatures & ::FeatureChecksum) != 0;
+
+            if (isCompressible(dataSize)) {
+                const size_t offset = ::MessageHeader::getSizeInBytes() + ::kCompressedHeaderSize;
+                const size_t maxSize = Compression::getMaxCompressedSize(txCodec, dataSize);
+
+                auto msg = BufferPool::acquire(offset + maxSize + ::kChecksumSize);
+                msg.resize(offset + maxSize);
 
-                TErrorCode errorCode = errno;
-                if (errorCallback) {
-                    errorCallback(errorCode);
+                size_t compressedSize = Compression::compress(txCodec, dataBuffer, dataSize, &msg[offset], maxSize, compressionParameters.level);
+
+                // send as it is, if it does not compress
+                if (compressedSize > 0 && ::kCompressedHeaderSize + compressedSize < dataSize) {
+                    msg.resize(offset + compressedSize);
+
+                    const uint8_t codec = txCodec;
+                    const uint32_t originalSize = (uint32_t) dataSize;
+                    memcpy(&msg[::MessageHeader::getSizeInBytes()], &codec, sizeof(codec));
+                    memcpy(&msg[::MessageHeader::getSizeInBytes()] + sizeof(codec), &originalSize, sizeof(originalSize));
+
+                    ::finalizeMessage(msg, type, ::kFrameFlagCompressed | (withChecksum ? ::kFrameFlagChecksum : 0));
+
+                    ++stats.nMessagesCompressed;
+                    stats.nBytesBeforeCompression += dataSize;
+                    stats.nBytesAfterCompression += ::kCompressedHeaderSize + compressedSize;
+
+                    return msg;
                 }
 
-                return;
+                BufferPool::release(msg);
             }
 
-            //printf("  %d bytes received, %d %d\n", rc,
-            //       (int)(*reinterpret_cast<int32_t *>(bufferHeaderRecv.data())),
-            //       (int)(*reinterpret_cast<int16_t *>(bufferHeaderRecv.data() + sizeof(int32_t)))
-            //       );
+            return ::makeMessage(type, dataBuffer, dataSize, withChecksum);
+        }
 
-            if (rc == (int) bufferHeaderRecv.size()) {
-                TBufferSize size = 0;
-                TMessageType type = 0;
-                memcpy(&size, bufferHeaderRecv.data(), sizeof(size));
-                memcpy(&type, bufferHeaderRecv.data() + sizeof(size), sizeof(type));
-                if (size == ::MessageHeader::getSizeInBytes()) {
-                    if (const auto & cb = messageCallback[type]) {
-                        cb(bufferDataRecv.data(), 0);
-                    }
-                } else if (size > ::MessageHeader::getSizeInBytes()) {
-                    lastMessageType = type;
-                    leftToReceive = size - ::MessageHeader::getSizeInBytes();
-                    offsetReceive = 0;
-                    if (leftToReceive > (int) bufferDataRecv.size()) {
-                        printf("Extend receive buffer to %d bytes\n", (int) bufferDataRecv.size());
-                        bufferDataRecv.resize(leftToReceive);
-                    }
+        // finish a frame whose payload was written in place - compressed payloads still need a new buffer
+        SerializationBuffer finishFrame(TMessageType type, SerializationBuffer && frame) {
+            const size_t offset = ::MessageHeader::getSizeInBytes();
 
-                    while (leftToReceive > 0) {
-                        //printf("left = %d\n", (int) leftToReceive);
-                        size_t curSize = (std::min)(65536, (int) leftToReceive);
+            if (isCompressible(frame.size() - offset)) {
+                auto msg = makeFrame(type, frame.data() + offset, frame.size() - offset);
+                BufferPool::release(frame);
 
-                        int rc = (int) recv(sdpeer, bufferDataRecv.data() + offsetReceive, curSize, 0);
-                        if (rc < 0) {
-                            if (e_wouldBlock() == false) {
-                                isConnected = false;
-                                ::closeAndReset(sdpeer);
-                                ::closeAndReset(sd);
+                return msg;
+            }
 
-                                if (errorCallback) {
-                                    TErrorCode errorCode = errno;
-                                    errorCallback(errorCode);
-                                }
+            ::finalizeMessage(frame, type, (negotiatedFeatures & ::FeatureChecksum) ? ::kFrameFlagChecksum : 0);
 
-                                break;
-                            }
+            return std::move(frame);
+        }
 
-                            continue;
-                        }
+        void onConnected() {
+            ++connectionId;
 
-                        if (rc == 0) {
-                            isConnected = false;
-                            isListening = false;
-                            ::closeAndReset(sdpeer);
-                            ::closeAndReset(sd);
+            startKeepAlive();
+
+            {
+                std::lock_guard<std::mutex> lock(mutexSend);
+
+                negotiatedFeatures = 0;
+                isHelloReceived = false;
+                updateTxCodec();
+                sessionReady = false;
+                controlSend.clear();
+
+                // every connection starts with fixed headers
+                txVarintHeader = false;
+                rxVarintHeader = false;
+                recvBegin = recvEnd = 0;
+
+                tLastReceive = TClock::now();
+                tLastSend = tLastReceive;
+
+                // the client initiates the handshake, the server replies
+                if (isServer == false && getLocalFeatures() != 0) {
+                    sendHello();
+                }
+            }
+
+            if (connectCallback) {
+                connectCallback();
+            }
+        }
+
+        void sendHello() {
+            Hello hello;
+            hello.features = getLocalFeatures();
+            hello.sessionId = sessionId;
+            hello.seq = rxSeq;
+
+            char payload[Hello::getSizeInBytes()];
+            memcpy(payload, &hello.features, sizeof(hello.features));
+            memcpy(payload + sizeof(hello.features), &hello.sessionId, sizeof(hello.sessionId));
+            memcpy(payload + sizeof(hello.features) + sizeof(hello.sessionId), &hello.seq, sizeof(hello.seq));
+
+            controlSend.push_back(::makeMessage(::MsgHello, payload, sizeof(payload)));
+        }
+
+        void sendSessionAck() {
+            controlSend.push_back(::makeMessage(::MsgSessionAck, reinterpret_cast<const char *>(&rxSeq), sizeof(rxSeq)));
+
+            rxSeqAcked = rxSeq;
+            tLastAck = TClock::now();
+        }
+
+        void updateSessionAck() {
+            if (rxSeq == rxSeqAcked) {
+                return;
+            }
+
+            if (rxSeq - rxSeqAcked >= (uint64_t) sessionParameters.ackEveryMessages ||
+                TClock::now() - tLastAck >= std::chrono::milliseconds(sessionParameters.ackInterval_ms)) {
+                sendSessionAck();
+            }
+        }
+
+        void resetSession() {
+            sessionId = 0;
+            sessionReady = false;
+            txSeq = 0;
+            rxSeq = 0;
+            rxSeqAcked = 0;
+            sessionReplay.clear();
+            sessionReplayBytes = 0;
+            sessionResendId = 0;
+        }
+
+        void trimSessionReplay(uint64_t seqAcked) {
+            while (sessionReplay.empty() == false && sessionReplay.front().first <= seqAcked) {
+                sessionReplayBytes -= sessionReplay.front().second.size();
+                sessionReplay.front().second.clear();
+                sessionReplay.pop_front();
+                if (sessionResendId > 0) {
+                    --sessionResendId;
+                }
+            }
+        }
+
+        void onHello(const char * dataBuffer, TBufferSize dataSize) {
+            // a peer that never announced any features is talked to with plain frames
+            if (getLocalFeatures() == 0 || dataSize < Hello::getSizeInBytes()) {
+                return;
+            }
+
+            Hello hello;
+            memcpy(&hello.features, dataBuffer, sizeof(hello.features));
+            memcpy(&hello.sessionId, dataBuffer + sizeof(hello.features), sizeof(hello.sessionId));
+            memcpy(&hello.seq, dataBuffer + sizeof(hello.features) + sizeof(hello.sessionId), sizeof(hello.seq));
+
+            bool isLost = false;
+            bool isRestart = false;
+
+            {
+                std::lock_guard<std::mutex> lock(mutexSend);
+
+                negotiatedFeatures = getLocalFeatures() & hello.features;
+                isHelloReceived = true;
+                updateTxCodec();
+
+                if (hasSession) {
+                    if (negotiatedFeatures & ::FeatureSession) {
+                        updateSession(hello, isLost, isRestart);
+                    } else {
+                        // the peer does not support sessions - each connection starts from scratch
+                        resetSession();
+                        sessionReady = true;
+                    }
+                }
+
+                if (isServer) {
+                    sendHello();
+                }
+
+                // the last frame with a fixed header - the peer switches its parser when it receives it
+                if (negotiatedFeatures & ::FeatureVarintHeader) {
+                    controlSend.push_back(::makeMessage(::MsgFrameHeader, nullptr, 0));
+                }
+            }
+
+            if (isRestart) {
+                onConnectionLost(ErrorSessionLost);
+                return;
+            }
+
+            if (isLost && errorCallback) {
+                errorCallback(ErrorSessionLost);
+            }
+        }
+
+        void updateSession(const Hello & hello, bool & isLost, bool & isRestart) {
+            const bool isSameSession = hello.sessionId != 0 && hello.sessionId == sessionId;
+
+            bool isResumed = isSameSession;
+            isLost = sessionId != 0 && isResumed == false;
+            isRestart = false;
+
+            if (isResumed) {
+                trimSessionReplay(hello.seq);
+
+                // the frames the peer is missing are no longer available
+                if (sessionReplay.empty() ? txSeq != hello.seq : sessionReplay.front().first != hello.seq + 1) {
+                    isResumed = false;
+                    isLost = true;
+                }
+            }
+
+            if (isResumed) {
+                sessionResendId = 0;
+                ++stats.nSessionResumes;
+            } else {
+                resetSession();
+                if (isServer) {
+                    static std::mt19937_64 rng(std::random_device{}());
+                    while (sessionId == 0) {
+                        sessionId = rng();
+                    }
+                } else if (isSameSession) {
+                    // the server resumed, but we cannot - reconnect and start a new session
+                    isRestart = true;
+                } else {
+                    sessionId = hello.sessionId;
+                }
+            }
+
+            sessionReady = isRestart == false;
+        }
+
+        void onControlMessage(TMessageType type, const char * dataBuffer, TBufferSize dataSize) {
+            switch (type) {
+                case ::MsgHello:
+                    {
+                        onHello(dataBuffer, dataSize);
+                    }
+                    break;
+                case ::MsgSessionAck:
+                    {
+                        if (hasSession && dataSize >= sizeof(uint64_t)) {
+                            uint64_t seqAcked = 0;
+                            memcpy(&seqAcked, dataBuffer, sizeof(seqAcked));
+
+                            std::lock_guard<std::mutex> lock(mutexSend);
+                            trimSessionReplay(seqAcked);
+                        }
+                    }
+                    break;
+                case ::MsgFrameHeader:
+                    {
+                        if (useVarintHeader) {
+                            rxVarintHeader = true;
+                        } else {
+                            onFrameSizeError();
+                        }
+                    }
+                    break;
+                default:
+                    break;
+            };
+        }
+
+        void onMessage(TMessageType type, const char * dataBuffer, TBufferSize dataSize) {
+            if (type >= MsgReserved) {
+                onControlMessage(type, dataBuffer, dataSize);
+                return;
+            }
+
+            onMessageReceived(::MessageHeader::getSizeInBytes() + dataSize);
+
+            if (hasSession) {
+                ++rxSeq;
+            }
+
+            if (const auto & cb = messageCallback[type]) {
+                cb(dataBuffer, dataSize);
+            }
+        }
+
+        void workerBusyPoll() {
+            uint64_t nSpins = 0;
+            int32_t spinBudget_us = 0;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                spinBudget_us = stats.spinBudget_us;
+            }
+
+            while (isRunning) {
+                // spin until nothing happens for the duration of the budget
+                auto tSpinStart = TClock::now();
+                auto tLastActivity = tSpinStart;
+                auto tNow = tSpinStart;
+                while (isRunning) {
+                    uint64_t nActivityLast = nActivity;
+                    update();
+                    ++nSpins;
+
+                    tNow = TClock::now();
+                    if (nActivity != nActivityLast) {
+                        tLastActivity = tNow;
+                    } else if (std::chrono::duration_cast<std::chrono::microseconds>(tNow - tLastActivity).count() >= spinBudget_us) {
+                        break;
+                    }
+                }
+
+                // traffic went idle - block until the socket becomes ready
+                auto tSpin_us = std::chrono::duration_cast<std::chrono::microseconds>(tNow - tSpinStart).count();
+                auto tIdleStart = TClock::now();
+                waitForActivity();
+                auto tIdle_us = std::chrono::duration_cast<std::chrono::microseconds>(TClock::now() - tIdleStart).count();
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stats.nSpins += nSpins;
+                    stats.nIdleWaits += 1;
+                    stats.tSpin_us += tSpin_us;
+                    stats.tIdle_us += tIdle_us;
+                    spinBudget_us = stats.spinBudget_us;
+                }
+
+                nSpins = 0;
+            }
+        }
+
+        bool waitForActivity() {
+            TSocketDescriptor sdWait = -1;
+            bool waitWrite = false;
+            int64_t wait_ms = workerParameters.idleWait_ms;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (isConnected) {
+                    sdWait = sdpeer;
+                } else if (isListening) {
+                    sdWait = sd;
+                } else if (isConnecting) {
+                    sdWait = sd;
+                    waitWrite = true;
+                }
+
+                std::lock_guard<std::mutex> lockSend(mutexSend);
+                if (isConnected && hasPendingSend()) {
+                    // a throttled frame has to wait for the rate limiter to refill
+                    const int64_t wait_us = getThrottleWait_us();
+                    if (wait_us == 0) {
+                        return true;
+                    }
+                    wait_ms = (std::min)((wait_us + 999)/1000, ::kThrottleWaitMax_ms);
+                }
+            }
+
+            if (sdWait == -1) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(wait_ms));
+                return false;
+            }
+
+            return ::waitForSocket(sdWait, waitWrite, (int32_t) wait_ms) > 0;
+        }
+
+        void onMessageReceived(TBufferSize size) {
+            ++nActivity;
+            ++stats.nMessagesReceived;
+            stats.nBytesReceived += size;
+
+            // adapt the spin budget to the message inter-arrival time
+            auto tNow = TClock::now();
+            if (stats.nMessagesReceived > 1) {
+                int64_t tGap_us = std::chrono::duration_cast<std::chrono::microseconds>(tNow - tLastMessage).count();
+                avgGap_us = avgGap_us == 0 ? tGap_us : (7*avgGap_us + tGap_us)/8;
+
+                if (2*avgGap_us > workerParameters.spinBudgetMax_us) {
+                    // messages are too sparse for spinning to pay off
+                    stats.spinBudget_us = workerParameters.spinBudgetMin_us;
+                } else {
+                    stats.spinBudget_us = (std::max)(workerParameters.spinBudgetMin_us, (int32_t) (2*avgGap_us));
+                }
+            }
+            tLastMessage = tNow;
+        }
+
+        bool doListen() {
+            int rc = ::waitForSocket(sd, false, timeoutListen_ms);
+            if (rc < 0) {
+                return false;
+            }
+
+            if (rc == 0) {
+                return false;
+            }
+
+            do {
+                sdpeer = accept(sd, NULL, NULL);
+                if (sdpeer < 0) {
+                    if (e_wouldBlock() == false) {
+                        perror("  accept() failed");
+                    }
+                    return false;
+                }
+
+                socklen_t len;
+                len = sizeof(peeraddr);
+                getpeername(sdpeer, (struct sockaddr*)&peeraddr, &len);
+
+                printf("  New incoming connection - %d, %d, ip = %s\n", sd, sdpeer, inet_ntoa(peeraddr.sin_addr));
+
+                ::setNonBlocking(sdpeer);
+                if (usePacingRate && rateLimiter) {
+                    ::setPacingRate(sdpeer, rateLimiter->getMaxRate());
+                }
+
+                isListening = false;
+                isConnected = true;
+                ++nActivity;
+
+                // stop listening for connections
+                ::closeAndReset(sd);
+
+                onConnected();
+
+                break;
+            } while (sdpeer != -1);
+
+            return true;
+        }
+
+        bool doConnect() {
+            auto tStart = TClock::now();
+
+            while (isConnecting) {
+                auto rc = ::connect(sd, (struct sockaddr *) &addr, sizeof(addr));
+                if (rc < 0 && e_isConnected() == false) {
+                    const bool isInProgress = e_inProgress() || e_wouldBlock();
+                    if (isInProgress == false) {
+                        ::closeAndReset(sd);
+
+                        // the reconnect attempt failed - back off
+                        if (isReconnecting) {
+                            isConnecting = false;
+                            scheduleReconnect();
+                            return false;
+                        }
+
+                        sd = ::createSocket();
+                    }
+                    if (timeoutConnect_ms > 0) {
+                        int32_t tLeft_ms = timeoutConnect_ms - (int32_t) std::chrono::duration_cast<std::chrono::milliseconds>(TClock::now() - tStart).count();
+                        if (tLeft_ms <= 0) {
+                            ::closeAndReset(sd);
+                            isConnecting = false;
+                            continue;
+                        }
+
+                        if (isInProgress) {
+                            ::waitForWritable(sd, tLeft_ms);
+                        } else {
+                            // refused - the peer may not be listening yet
+                            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                        }
+                        continue;
+                    }
+
+                    return false;
+                }
+
+                sdpeer = sd;
+                if (usePacingRate && rateLimiter) {
+                    ::setPacingRate(sdpeer, rateLimiter->getMaxRate());
+                }
+
+                printf("Connected successfully, sd = %d\n", sd);
+
+                isConnecting = false;
+                isConnected = true;
+                ++nActivity;
+
+                if (isReconnecting) {
+                    isReconnecting = false;
+                    cancelTimer(reconnectTimerId);
+                    ++stats.nReconnects;
+                }
+
+                onConnected();
+
+                return true;
+            }
+
+            return false;
+        }
+
+        // make room for nBytes from the first unparsed byte
+        void reserveReceiveBuffer(size_t nBytes) {
+            if (recvBegin > 0 && bufferRecv.size() - recvBegin < nBytes) {
+                memmove(bufferRecv.data(), bufferRecv.data() + recvBegin, recvEnd - recvBegin);
+                recvEnd -= recvBegin;
+                recvBegin = 0;
+            }
+
+            if (bufferRecv.size() < nBytes) {
+                ::growBuffer(bufferRecv, nBytes, recvEnd);
+            }
+        }
+
+        // read whatever is available and dispatch all complete frames
+        // a frame that does not fit the buffer grows it, so large frames are received over several updates
+        void doRead() {
+            if (recvBegin == recvEnd) {
+                recvBegin = recvEnd = 0;
+            }
+            if (recvEnd == bufferRecv.size()) {
+                reserveReceiveBuffer(recvEnd - recvBegin + ::kRecvChunk_bytes);
+            }
+
+            const size_t nFree = (std::min)(bufferRecv.size() - recvEnd, (size_t) INT32_MAX);
+
+            int rc = (int) recv(sdpeer, bufferRecv.data() + recvEnd, nFree, 0);
+            if (rc < 0) {
+                if (e_wouldBlock() == false) {
+                    onConnectionLost(errno);
+                }
+                return;
+            }
+
+            if (rc == 0) {
+                onConnectionLost(errno);
+                return;
+            }
+
+            recvEnd += rc;
+            tLastReceive = TClock::now();
+
+            while (isConnected && parseFrame()) {
+            }
+        }
+
+        // returns false if the next frame has not been fully received yet
+        bool parseFrame() {
+            const char * src = bufferRecv.data() + recvBegin;
+            const size_t nAvailable = recvEnd - recvBegin;
+
+            uint64_t bodySize = 0;
+            uint32_t flags = 0;
+            TMessageType type = 0;
+            size_t headerSize = 0;
+
+            if (rxVarintHeader) {
+                int32_t n = ::decodeVarintHeader(src, nAvailable, bodySize, flags, type);
+                if (n <= 0) {
+                    if (n < 0) {
+                        onFrameSizeError();
+                    }
+                    return false;
+                }
+
+                headerSize = n;
+            } else {
+                if (nAvailable < ::MessageHeader::getSizeInBytes()) {
+                    return false;
+                }
+
+                uint32_t sizeAndFlags = 0;
+                memcpy(&sizeAndFlags, src, sizeof(sizeAndFlags));
+                memcpy(&type, src + sizeof(sizeAndFlags), sizeof(type));
+
+                // a peer that did not negotiate checksum or compression uses the whole size field
+                const uint32_t flagsMask = (negotiatedFeatures & ::kFrameFlagFeatures) ? ~::kFrameSizeMask : 0u;
+
+                const uint32_t size = sizeAndFlags & ~flagsMask;
+                if (size < ::MessageHeader::getSizeInBytes()) {
+                    onFrameSizeError();
+                    return false;
+                }
+
+                flags = sizeAndFlags & flagsMask;
+                bodySize = size - ::MessageHeader::getSizeInBytes();
+                headerSize = ::MessageHeader::getSizeInBytes();
+            }
+
+            const bool hasChecksum = (flags & ::kFrameFlagChecksum) != 0;
+            const bool isCompressed = (flags & ::kFrameFlagCompressed) != 0;
+
+            if (hasChecksum && bodySize < ::kChecksumSize) {
+                onChecksumError();
+                return false;
+            }
+
+            TBufferSize dataSize = bodySize - (hasChecksum ? ::kChecksumSize : 0);
+            if (dataSize > maxMessageSize) {
+                onFrameSizeError();
+                return false;
+            }
+
+            const size_t frameSize = headerSize + bodySize;
+            if (nAvailable < frameSize) {
+                reserveReceiveBuffer(frameSize);
+                return false;
+            }
+
+            // the payload stays valid until the next read
+            const char * dataBuffer = src + headerSize;
+            recvBegin += frameSize;
+
+            if (hasChecksum) {
+                uint32_t crc = 0;
+                memcpy(&crc, dataBuffer + dataSize, sizeof(crc));
+
+                char header[::MessageHeader::getSizeInBytes()];
+                ::writeFixedHeader(header, ::MessageHeader::getSizeInBytes() + bodySize, flags, type);
+
+                uint32_t crcExpected = ::GGSock::CRC32C::compute(header, sizeof(header));
+                crcExpected = ::GGSock::CRC32C::extend(crcExpected, dataBuffer, dataSize);
+
+                if (crc != crcExpected) {
+                    onChecksumError();
+                    return false;
+                }
+            }
+
+            if (isCompressed) {
+                uint8_t codec = 0;
+                uint32_t originalSize = 0;
+                if (dataSize < ::kCompressedHeaderSize) {
+                    onDecompressionError();
+                    return false;
+                }
+                memcpy(&codec, dataBuffer, sizeof(codec));
+                memcpy(&originalSize, dataBuffer + sizeof(codec), sizeof(originalSize));
+
+                const char * compressed = dataBuffer + ::kCompressedHeaderSize;
+                const size_t compressedSize = dataSize - ::kCompressedHeaderSize;
+
+                // the original size is checked against what the payload can expand to before allocating for it
+                if (Compression::isAvailable((Compression::Codec) codec) == false || originalSize > maxMessageSize ||
+                    originalSize > Compression::getMaxDecompressedSize((Compression::Codec) codec, compressed, compressedSize)) {
+                    onDecompressionError();
+                    return false;
+                }
+
+                ::reserveBuffer(bufferDecompressed, originalSize);
+
+                if (Compression::decompress((Compression::Codec) codec, compressed, compressedSize,
+                                            bufferDecompressed.data(), originalSize) == false) {
+                    onDecompressionError();
+                    return false;
+                }
+
+                onMessage(type, bufferDecompressed.data(), originalSize);
+                return true;
+            }
+
+            onMessage(type, dataBuffer, dataSize);
+
+            return true;
+        }
+
+        void onChecksumError() {
+            // the framing can no longer be trusted, so the connection is dropped
+            // with a session, the client reconnects and the frame is sent again
+            ++stats.nChecksumErrors;
+            onConnectionLost(ErrorChecksum);
+        }
+
+        void onDecompressionError() {
+            onConnectionLost(ErrorDecompression);
+        }
+
+        void onFrameSizeError() {
+            onConnectionLost(ErrorFrameSize);
+        }
+
+        bool acquireRate(int64_t nBytes) {
+            if (rateLimiter && rateLimiter->isAvailable(nBytes) == false) {
+                return false;
+            }
+
+            if (sharedRateLimiter && sharedRateLimiter->acquire(this, nBytes) == false) {
+                return false;
+            }
+
+            if (rateLimiter) {
+                rateLimiter->consume(nBytes);
+            }
+
+            return true;
+        }
+
+        int64_t getThrottleWait_us() const {
+            if (nBytesThrottled == 0) {
+                return 0;
+            }
+
+            int64_t wait_us = 0;
+            if (rateLimiter) {
+                wait_us = rateLimiter->getTimeToAvailable_us(nBytesThrottled);
+            }
+            if (sharedRateLimiter) {
+                wait_us = (std::max)(wait_us, sharedRateLimiter->getTimeToAvailable_us(nBytesThrottled));
+            }
+
+            // the shared limiter can also hold back a sender that is queued behind others
+            return (std::max)(wait_us, (int64_t) 1);
+        }
+
+        bool hasPendingSend() const {
+            if (controlSend.empty() == false) {
+                return true;
+            }
+
+            // until the session handshake completes, only control messages can be sent
+            if (hasSession && sessionReady == false) {
+                return false;
+            }
+
+            return sessionResendId < sessionReplay.size() || rbHead != rbEnd;
+        }
+
+        void doSend() {
+            // control messages first, then the frames the peer missed, then new frames
+            const bool isControl = controlSend.empty() == false;
+            const bool isResend = isControl == false && sessionResendId < sessionReplay.size();
+
+            const auto & curMessage =
+                isControl ? controlSend.front() :
+                isResend  ? sessionReplay[sessionResendId].second :
+                            ringBufferSend[rbHead];
+
+            // queued frames have the fixed header, which is replaced by the varint header once negotiated
+            uint32_t sizeAndFlags = 0;
+            TMessageType type = 0;
+            memcpy(&sizeAndFlags, curMessage.data(), sizeof(sizeAndFlags));
+            memcpy(&type, curMessage.data() + sizeof(sizeAndFlags), sizeof(type));
+
+            char header[::kVarintHeaderMaxSize];
+            size_t headerSize = 0;
+            const char * body = curMessage.data();
+            size_t bodySize = curMessage.size();
+
+            const uint32_t flags = sizeAndFlags & ~::kFrameSizeMask;
+            const bool isLarge = (sizeAndFlags & ::kFrameSizeMask) == 0;
+
+            if (txVarintHeader) {
+                body += ::MessageHeader::getSizeInBytes();
+                bodySize -= ::MessageHeader::getSizeInBytes();
+                headerSize = ::encodeVarintHeader(header, bodySize, flags, type);
+            } else if (isLarge && flags == 0 && bodySize <= ::kFrameSizeMax && (negotiatedFeatures & ::kFrameFlagFeatures) == 0) {
+                const uint32_t frameSize = (uint32_t) bodySize;
+                body += ::MessageHeader::getSizeInBytes();
+                bodySize -= ::MessageHeader::getSizeInBytes();
+                memcpy(header, &frameSize, sizeof(frameSize));
+                memcpy(header + sizeof(frameSize), &type, sizeof(type));
+                headerSize = ::MessageHeader::getSizeInBytes();
+            }
+
+            size_t nSent = 0;
+            const size_t size = headerSize + bodySize;
+
+            if (isLarge && headerSize == 0) {
+                // queued before the hello, but the peer cannot read a frame of this size
+                // it is dropped before it gets a sequence number, so the session stays consistent
+                ++nFramesTooLarge;
+                if (isResend) {
+                    ++sessionResendId;
+                    return;
+                }
+
+                ringBufferSend[rbHead].clear();
+                if (++rbHead >= ::kSendQueueSize) {
+                    rbHead = 0;
+                }
+                return;
+            }
+
+            if (acquireRate(size) == false) {
+                ++stats.nSendsThrottled;
+                nBytesThrottled = size;
+                return;
+            }
+            nBytesThrottled = 0;
+
+            while (nSent < size) {
+                const size_t nBody = (std::min)(size - (std::max)(nSent, headerSize), (size_t) INT32_MAX);
+                const int64_t rc = nSent < headerSize ?
+                    ::sendGather(sdpeer, header + nSent, headerSize - nSent, body, nBody) :
+                    (int64_t) ::send(sdpeer, body + (nSent - headerSize), nBody, 0);
+                if (rc < 0) {
+                    if (e_wouldBlock() == false) {
+                        onConnectionLost(errno);
+                        break;
+                    }
+                    continue;
+                }
+                nSent += rc;
+            }
+
+            ++nActivity;
+            tLastSend = TClock::now();
 
-                            TErrorCode errorCode = errno;
-                            if (errorCallback) errorCallback(errorCode);
+            if (isControl) {
+                if (type == ::MsgFrameHeader) {
+                    txVarintHeader = true;
+                }
+                controlSend.front().clear();
+                controlSend.pop_front();
+                return;
+            }
 
-                            return;
-                        }
+            ++stats.nMessagesSent;
+            stats.nBytesSent += nSent;
 
-                        leftToReceive -= rc;
-                        offsetReceive += rc;
-                    }
+            if (isResend) {
+                ++sessionResendId;
+                ++stats.nFramesReplayed;
+                return;
+            }
 
-                    if (const auto & cb = messageCallback[type]) {
-                        cb(bufferDataRecv.data(), size - ::MessageHeader::getSizeInBytes());
-                    }
-                } else {
-                    // error
+            if (hasSession) {
+                // keep the frame until the peer acknowledges it
+                sessionReplayBytes += ringBufferSend[rbHead].size();
+                sessionReplay.emplace_back(++txSeq, std::move(ringBufferSend[rbHead]));
+                sessionResendId = sessionReplay.size();
+
+                while (sessionReplayBytes > (size_t) sessionParameters.maxReplayBytes && sessionReplay.size() > 1) {
+                    sessionReplayBytes -= sessionReplay.front().second.size();
+                    sessionReplay.front().second.clear();
+                    sessionReplay.pop_front();
+                    --sessionResendId;
                 }
             }
-        }
 
-        void doSend() {
-            const auto & curMessage = ringBufferSend[rbHead];
-            TBufferSize size = (TBufferSize) curMessage.size();
+            // release the buffer now - a shared frame is freed once the last connection has sent it
+            ringBufferSend[rbHead].clear();
 
-            int offset = 0;
-            while (size > 0) {
-                int rc = (int) ::send(sdpeer, curMessage.data() + offset, size, 0);
-                if (rc < 0) {
-                    if (e_wouldBlock() == false) {
-                        isConnected = false;
-                        ::closeAndReset(sdpeer);
-                        ::closeAndReset(sd);
+            if (++rbHead >= ::kSendQueueSize) {
+                rbHead = 0;
+            }
+        }
 
-                        if (errorCallback) {
-                            TErrorCode errorCode = errno;
-                            errorCallback(errorCode);
-                        }
+        bool isSendQueueFull() const {
+            int32_t next = rbEnd + 1;
+            return (next >= ::kSendQueueSize ? 0 : next) == rbHead;
+        }
 
-                        break;
-                    }
-                    continue;
-                }
-                size -= rc;
-                offset += rc;
+        bool addMessageToSend(SerializationBuffer && msg) {
+            if (isSendQueueFull()) {
+                return false;
+            }
+            if (ringBufferSend.empty()) {
+                ringBufferSend.resize(::kSendQueueSize);
             }
 
-            if (++rbHead >= (int) ringBufferSend.size()) {
-                rbHead = 0;
+            ringBufferSend[rbEnd].owned = std::move(msg);
+
+            if (++rbEnd >= ::kSendQueueSize) {
+                rbEnd = 0;
             }
+
+            return true;
         }
 
-        bool addMessageToSend(std::string && msg) {
-            ringBufferSend[rbEnd] = std::move(msg);
+        bool addMessageToSend(const TSharedFrame & frame) {
+            if (isSendQueueFull()) {
+                return false;
+            }
+            if (ringBufferSend.empty()) {
+                ringBufferSend.resize(::kSendQueueSize);
+            }
+
+            ringBufferSend[rbEnd].shared = frame;
 
-            if (++rbEnd >= (int) ringBufferSend.size()) {
+            if (++rbEnd >= ::kSendQueueSize) {
                 rbEnd = 0;
             }
 
-            return rbEnd != rbHead;
+            return true;
+        }
+
+        void clearSendQueue() {
+            while (rbHead != rbEnd) {
+                ringBufferSend[rbHead].clear();
+                if (++rbHead >= ::kSendQueueSize) {
+                    rbHead = 0;
+                }
+            }
         }
 
         bool isServer = true;
@@ -445,37 +1679,91 @@ namespace GGSock {
 
         TSocketDescriptor sd = -1;
         TSocketDescriptor sdpeer = -1;
-        TSocketDescriptor max_sd = -1;
 
-        struct timeval timeout;
         struct sockaddr_in addr;
         struct sockaddr_in peeraddr;
 
-        fd_set master_set;
-        fd_set working_set;
-
-        int32_t offsetReceive = 0;
-        int32_t leftToReceive = 0;
-        TMessageType lastMessageType = -1;
 
         std::int32_t rbHead = 0;
         std::int32_t rbEnd = 0;
-        std::array<std::string, 128> ringBufferSend;
+        std::vector<::OutgoingFrame> ringBufferSend;
 
-        std::vector<char> bufferDataRecv;
-
-        std::array<char, ::MessageHeader::getSizeInBytes()> bufferHeaderRecv;
-        std::array<char, ::MessageHeader::getSizeInBytes()> bufferHeaderSend;
+        // received bytes that have not been parsed yet are in [recvBegin, recvEnd)
+        size_t recvBegin = 0;
+        size_t recvEnd = 0;
+        SerializationBuffer bufferRecv;
+        SerializationBuffer bufferDecompressed;
 
         mutable std::mutex mutex;
         mutable std::mutex mutexSend;
         std::thread worker;
 
         CBError errorCallback = nullptr;
+        CBConnect connectCallback = nullptr;
+        CBSendQueue sendQueueCallback = nullptr;
         std::map<TMessageType, CBMessage> messageCallback;
+
+        const WorkerParameters workerParameters;
+
+        bool useChecksum = false;
+
+        Compression::Codec compressionCodec = Compression::None;
+        Compression::Codec txCodec = Compression::None;
+        CompressionParameters compressionParameters;
+
+        uint32_t negotiatedFeatures = 0;
+        bool isHelloReceived = false;
+        int32_t nFramesTooLarge = 0;
+
+        bool useVarintHeader = false;
+        bool txVarintHeader = false;
+        bool rxVarintHeader = false;
+        TBufferSize maxMessageSize = ::kFrameSizeMax - ::MessageHeader::getSizeInBytes();
+
+        bool hasSession = false;
+        bool sessionReady = false;
+        bool isReconnecting = false;
+
+        SessionParameters sessionParameters;
+
+        uint64_t sessionId = 0;
+        uint64_t txSeq = 0;
+        uint64_t rxSeq = 0;
+        uint64_t rxSeqAcked = 0;
+
+        int32_t reconnectBackoff_ms = 0;
+        TClock::time_point tLastAck;
+
+        size_t sessionReplayBytes = 0;
+        size_t sessionResendId = 0;
+        std::deque<std::pair<uint64_t, ::OutgoingFrame>> sessionReplay;
+        std::deque<::OutgoingFrame> controlSend;
+
+        bool usePacingRate = false;
+        std::unique_ptr<RateLimiter> rateLimiter;
+        std::shared_ptr<RateLimiter> sharedRateLimiter;
+        int64_t nBytesThrottled = 0;
+
+        Stats stats;
+        std::atomic<uint64_t> nActivity { 0 };
+        std::atomic<uint64_t> connectionId { 0 };
+        int64_t avgGap_us = 0;
+        TClock::time_point tLastMessage;
+        TClock::time_point tLastReceive;
+        TClock::time_point tLastSend;
+
+        int32_t heartbeatInterval_ms = 0;
+        int32_t idleTimeout_ms = 0;
+
+        // keep-alive and reconnect deadlines, created on first use
+        std::unique_ptr<TimerWheel> timers;
+        TimerWheel::TTimerId idleTimerId = 0;
+        TimerWheel::TTimerId heartbeatTimerId = 0;
+        TimerWheel::TTimerId reconnectTimerId = 0;
     };
 
-    Communicator::Communicator(bool startOwnWorker) : data_(new Data(startOwnWorker)) {}
+    Communicator::Communicator(bool startOwnWorker) : data_(new Data(startOwnWorker, {})) {}
+    Communicator::Communicator(bool startOwnWorker, const WorkerParameters & workerParameters) : data_(new Data(startOwnWorker, workerParameters)) {}
     Communicator::~Communicator() {}
 
     bool Communicator::update() {
@@ -551,7 +1839,8 @@ namespace GGSock {
             data.isListening = false;
             return success;
         } else if (timeout_ms < 0) {
-            data.timeoutListen_ms = 1;
+            // block in poll until a client connects, waking up once per second
+            data.timeoutListen_ms = 1000;
             while (data.isListening) {
                 bool success = data.doListen();
                 if (success) {
@@ -620,22 +1909,13 @@ namespace GGSock {
         data.isServer = false;
         data.isConnecting = true;
 
+        // without a timeout, the connection is established in the background by update()
         data.timeoutConnect_ms = (std::max)(0, timeout_ms);
         if (timeout_ms > 0) {
             bool res = data.doConnect();
 
             data.isConnecting = false;
             return res;
-        } else if (timeout_ms < 0) {
-            data.timeoutConnect_ms = 1;
-            while (data.isConnecting) {
-                bool success = data.doConnect();
-                if (success) {
-                    data.isConnecting = false;
-                    return true;
-                }
-            }
-            return false;
         }
 
         return true;
@@ -649,10 +1929,27 @@ namespace GGSock {
         data.isListening = false;
         data.isConnecting = false;
         data.isConnected = false;
+        data.isReconnecting = false;
 
         ::closeAndReset(data.sdpeer);
         ::closeAndReset(data.sd);
 
+        data.stopKeepAlive();
+        data.cancelTimer(data.reconnectTimerId);
+
+        bool hasSendQueueRoom = false;
+        if (data.hasSession) {
+            std::lock_guard<std::mutex> lockSend(data.mutexSend);
+            hasSendQueueRoom = data.isSendQueueFull();
+            data.resetSession();
+            data.controlSend.clear();
+            data.clearSendQueue();
+        }
+
+        if (hasSendQueueRoom && data.sendQueueCallback) {
+            data.sendQueueCallback();
+        }
+
         return true;
     }
 
@@ -689,6 +1986,10 @@ namespace GGSock {
         return data.isConnecting;
     }
 
+    uint64_t Communicator::getConnectionId() const {
+        return getData().connectionId;
+    }
+
     TAddress Communicator::getPeerAddress() const {
         auto & data = getData();
 
@@ -697,23 +1998,42 @@ namespace GGSock {
         return inet_ntoa(data.peeraddr.sin_addr);
     }
 
-    bool Communicator::send(TMessageType type) {
+    Communicator::Stats Communicator::getStats() const {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+        std::lock_guard<std::mutex> lockSend(data.mutexSend);
+
+        return data.stats;
+    }
+
+    size_t Communicator::getMemoryUsage() const {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+        std::lock_guard<std::mutex> lockSend(data.mutexSend);
+
+        return data.getMemoryUsage();
+    }
+
+    int32_t Communicator::getNumPendingMessages() const {
         auto & data = getData();
 
         std::lock_guard<std::mutex> lock(data.mutexSend);
 
-        if (data.isConnected == false) return false;
+        int32_t n = data.rbEnd - data.rbHead;
+        return n < 0 ? n + ::kSendQueueSize : n;
+    }
 
-        {
-            std::string msg;
-            TBufferSize size = ::MessageHeader::getSizeInBytes();
+    bool Communicator::send(TMessageType type) {
+        auto & data = getData();
 
-            msg.reserve(size);
+        std::lock_guard<std::mutex> lock(data.mutexSend);
 
-            msg.append(reinterpret_cast<const char*>(&size), reinterpret_cast<const char*>(&size)+sizeof(size));
-            msg.append(reinterpret_cast<const char*>(&type), reinterpret_cast<const char*>(&type)+sizeof(type));
+        if (data.isConnected == false && data.hasSession == false) return false;
 
-            if (data.addMessageToSend(std::move(msg)) == false) {
+        {
+            if (data.addMessageToSend(data.makeFrame(type, nullptr, 0)) == false) {
                 // error, send buffer is full
                 return false;
             }
@@ -727,19 +2047,13 @@ namespace GGSock {
 
         std::lock_guard<std::mutex> lock(data.mutexSend);
 
-        if (data.isConnected == false) return false;
-
-        {
-            std::string msg;
-            TBufferSize size = ::MessageHeader::getSizeInBytes() + dataSize;
-
-            msg.reserve(size);
+        if (data.isConnected == false && data.hasSession == false) return false;
 
-            msg.append(reinterpret_cast<const char*>(&size), reinterpret_cast<const char*>(&size)+sizeof(size));
-            msg.append(reinterpret_cast<const char*>(&type), reinterpret_cast<const char*>(&type)+sizeof(type));
-            msg.append(dataBuffer, dataBuffer + dataSize);
+        // larger frames fit only in the varint header
+        if (data.checkFrameSize(::getMessageSize(dataSize, true)) == false) return false;
 
-            if (data.addMessageToSend(std::move(msg)) == false) {
+        {
+            if (data.addMessageToSend(data.makeFrame(type, dataBuffer, dataSize)) == false) {
                 // error, send buffer is full
                 return false;
             }
@@ -748,6 +2062,75 @@ namespace GGSock {
         return true;
     }
 
+    SerializationBuffer Communicator::beginFrame(TBufferSize dataSize) {
+        // room for the checksum as well, so that the frame is finalized without reallocating
+        auto frame = BufferPool::acquire(::getMessageSize(dataSize, true));
+        frame.resize(::getMessageSize(dataSize, false));
+
+        return frame;
+    }
+
+    size_t Communicator::getFrameDataOffset() {
+        return ::MessageHeader::getSizeInBytes();
+    }
+
+    bool Communicator::commitFrame(TMessageType type, SerializationBuffer && frame) {
+        auto & data = getData();
+
+        SerializationBuffer msg = std::move(frame);
+
+        std::lock_guard<std::mutex> lock(data.mutexSend);
+
+        if ((data.isConnected == false && data.hasSession == false) ||
+            msg.size() < ::MessageHeader::getSizeInBytes() ||
+            data.checkFrameSize(msg.size() + ::kChecksumSize) == false) {
+            BufferPool::release(msg);
+            return false;
+        }
+
+        msg = data.finishFrame(type, std::move(msg));
+        if (data.addMessageToSend(std::move(msg)) == false) {
+            // error, send buffer is full
+            BufferPool::release(msg);
+            return false;
+        }
+
+        return true;
+    }
+
+    bool Communicator::send(const TSharedFrame & frame) {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutexSend);
+
+        if (data.isConnected == false && data.hasSession == false) return false;
+        if (frame == nullptr) return false;
+        if (data.checkFrameSize(frame->size()) == false) return false;
+
+        if (data.addMessageToSend(frame) == false) {
+            // error, send buffer is full
+            return false;
+        }
+
+        return true;
+    }
+
+    bool Communicator::isSendQueueFull() const {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutexSend);
+
+        return data.isSendQueueFull();
+    }
+
+    Communicator::TSharedFrame Communicator::makeSharedFrame(TMessageType type, const char * dataBuffer, TBufferSize dataSize) {
+        std::string msg;
+        msg.reserve(::getMessageSize(dataSize, false));
+        ::encodeMessage(msg, type, dataBuffer, dataSize, false);
+
+        return std::make_shared<const std::string>(std::move(msg));
+    }
+
     bool Communicator::setErrorCallback(CBError && callback) {
         auto & data = getData();
 
@@ -768,6 +2151,52 @@ namespace GGSock {
         return true;
     }
 
+    bool Communicator::setConnectCallback(CBConnect && callback) {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+
+        data.connectCallback = std::move(callback);
+
+        return true;
+    }
+
+    bool Communicator::removeConnectCallback() {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+
+        if (data.connectCallback) {
+            data.connectCallback = nullptr;
+            return true;
+        }
+
+        return false;
+    }
+
+    bool Communicator::setSendQueueCallback(CBSendQueue && callback) {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+
+        data.sendQueueCallback = std::move(callback);
+
+        return true;
+    }
+
+    bool Communicator::removeSendQueueCallback() {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+
+        if (data.sendQueueCallback) {
+            data.sendQueueCallback = nullptr;
+            return true;
+        }
+
+        return false;
+    }
+
     bool Communicator::removeErrorCallback() {
         auto & data = getData();
 
@@ -794,6 +2223,152 @@ namespace GGSock {
         return false;
     }
 
+    bool Communicator::enableSession(const SessionParameters & parameters) {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+        std::lock_guard<std::mutex> lockSend(data.mutexSend);
+
+        if (data.isConnected || data.isConnecting) return false;
+
+        data.hasSession = true;
+        data.sessionParameters = parameters;
+        data.resetSession();
+
+        return true;
+    }
+
+    bool Communicator::disableSession() {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+        std::lock_guard<std::mutex> lockSend(data.mutexSend);
+
+        if (data.hasSession == false) return false;
+        if (data.isConnected || data.isConnecting) return false;
+
+        data.hasSession = false;
+        data.isReconnecting = false;
+        data.cancelTimer(data.reconnectTimerId);
+        data.resetSession();
+
+        return true;
+    }
+
+    bool Communicator::setFrameChecksum(bool enable) {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+        std::lock_guard<std::mutex> lockSend(data.mutexSend);
+
+        if (data.isConnected || data.isConnecting) return false;
+
+        data.useChecksum = enable;
+
+        return true;
+    }
+
+    bool Communicator::setFrameHeader(FrameHeader header) {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+        std::lock_guard<std::mutex> lockSend(data.mutexSend);
+
+        if (data.isConnected || data.isConnecting) return false;
+
+        data.useVarintHeader = header == FrameHeader::Varint;
+
+        return true;
+    }
+
+    bool Communicator::setMaxMessageSize(TBufferSize maxSize_bytes) {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+
+        data.maxMessageSize = (std::min)(maxSize_bytes, (TBufferSize) ::kVarintMaxBodySize - ::kChecksumSize);
+
+        return true;
+    }
+
+    bool Communicator::setKeepAlive(int32_t heartbeatInterval_ms, int32_t idleTimeout_ms) {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+        std::lock_guard<std::mutex> lockSend(data.mutexSend);
+
+        data.heartbeatInterval_ms = (std::max)(0, heartbeatInterval_ms);
+        data.idleTimeout_ms = (std::max)(0, idleTimeout_ms);
+
+        if (data.isConnected) {
+            data.startKeepAlive();
+        }
+
+        return true;
+    }
+
+    bool Communicator::setCompression(const CompressionParameters & parameters) {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+        std::lock_guard<std::mutex> lockSend(data.mutexSend);
+
+        if (data.isConnected || data.isConnecting) return false;
+
+        Compression::Codec codec = Compression::None;
+        switch (parameters.codec) {
+            case CompressionCodec::None: codec = Compression::None; break;
+            case CompressionCodec::LZ4:  codec = Compression::LZ4;  break;
+            case CompressionCodec::Zstd: codec = Compression::Zstd; break;
+        };
+
+        if (Compression::isAvailable(codec) == false) {
+            fprintf(stderr, "Compression codec %d is not available in this build\n", (int) codec);
+            return false;
+        }
+
+        data.compressionCodec = codec;
+        data.compressionParameters = parameters;
+
+        return true;
+    }
+
+    bool Communicator::setRateLimit(RateLimiter::TRate maxRate_Bps, int64_t maxBurst_bytes, bool useKernelPacing) {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+        std::lock_guard<std::mutex> lockSend(data.mutexSend);
+
+        if (maxRate_Bps <= 0) {
+            data.rateLimiter.reset();
+            data.usePacingRate = false;
+            return true;
+        }
+
+        data.rateLimiter.reset(new RateLimiter(maxRate_Bps, maxBurst_bytes));
+        data.usePacingRate = useKernelPacing;
+
+        if (data.usePacingRate && data.isConnected) {
+            ::setPacingRate(data.sdpeer, maxRate_Bps);
+        }
+
+        return true;
+    }
+
+    bool Communicator::setSharedRateLimiter(const std::shared_ptr<RateLimiter> & limiter) {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutexSend);
+
+        if (data.sharedRateLimiter) {
+            data.sharedRateLimiter->cancel(&data);
+        }
+
+        data.sharedRateLimiter = limiter;
+
+        return true;
+    }
+
     TAddress Communicator::getLocalAddress() {
         int sock = socket(PF_INET, SOCK_DGRAM, 0);
         sockaddr_in loopback;
@@ -0,0 +1,304 @@
+#include "compression.h"
+
+#include <cstring>
+#include <vector>
+
+#ifdef GGSOCK_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+    //
+    // LZ4 block format
+    //
+
+    constexpr int kHashLog = 12;
+    constexpr int kMinMatch = 4;
+    constexpr size_t kLastLiterals = 5;   // the last 5 bytes are always literals
+    constexpr size_t kMatchFindLimit = 12; // the last match must start at least 12 bytes before the end
+    constexpr size_t kMaxOffset = 65535;
+
+    inline uint32_t read32(const uint8_t * p) {
+        uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    inline uint32_t hash32(uint32_t v) {
+        return (v*2654435761u) >> (32 - kHashLog);
+    }
+
+    inline uint8_t * writeLength(uint8_t * op, size_t len) {
+        while (len >= 255) {
+            *op++ = 255;
+            len -= 255;
+        }
+        *op++ = (uint8_t) len;
+        return op;
+    }
+
+    uint8_t * writeSequence(uint8_t * op, const uint8_t * literals, size_t nLiterals, size_t offset, size_t matchLen) {
+        uint8_t * token = op++;
+
+        *token = (uint8_t) ((nLiterals >= 15 ? 15 : nLiterals) << 4);
+        if (nLiterals >= 15) {
+            op = writeLength(op, nLiterals - 15);
+        }
+
+        if (nLiterals > 0) {
+            std::memcpy(op, literals, nLiterals);
+            op += nLiterals;
+        }
+
+        if (matchLen == 0) {
+            return op;
+        }
+
+        *op++ = (uint8_t) (offset & 0xff);
+        *op++ = (uint8_t) (offset >> 8);
+
+        matchLen -= kMinMatch;
+        *token |= (uint8_t) (matchLen >= 15 ? 15 : matchLen);
+        if (matchLen >= 15) {
+            op = writeLength(op, matchLen - 15);
+        }
+
+        return op;
+    }
+
+    size_t lz4Bound(size_t srcSize) {
+        return srcSize + srcSize/255 + 16;
+    }
+
+    // a match token with all length bytes set expands to at most 255 bytes per input byte
+    size_t lz4MaxDecompressedSize(size_t srcSize) {
+        return 255*srcSize;
+    }
+
+    size_t lz4Compress(const uint8_t * src, size_t srcSize, uint8_t * dst, size_t dstCapacity) {
+        if (dstCapacity < lz4Bound(srcSize)) {
+            return 0;
+        }
+
+        uint8_t * op = dst;
+
+        size_t anchor = 0;
+
+        if (srcSize > kMatchFindLimit) {
+            // reused between calls without clearing - a stale entry is only a match candidate that gets verified
+            static thread_local std::vector<uint32_t> table;
+            if (table.empty()) {
+                table.resize(1 << kHashLog, 0);
+            }
+
+            const size_t matchFindLimit = srcSize - kMatchFindLimit;
+            const size_t matchLimit = srcSize - kLastLiterals;
+
+            size_t ip = 1;
+            size_t nMisses = 0;
+            while (ip < matchFindLimit) {
+                const uint32_t cur = read32(src + ip);
+                const uint32_t h = hash32(cur);
+                const size_t ref = table[h];
+                table[h] = (uint32_t) ip;
+
+                if (ref >= ip || ip - ref > kMaxOffset || read32(src + ref) != cur) {
+                    // skip faster through incompressible data
+                    ip += 1 + (nMisses++ >> 6);
+                    continue;
+                }
+
+                size_t matchLen = kMinMatch;
+                while (ip + matchLen < matchLimit && src[ref + matchLen] == src[ip + matchLen]) {
+                    ++matchLen;
+                }
+
+                op = writeSequence(op, src + anchor, ip - anchor, ip - ref, matchLen);
+
+                ip += matchLen;
+                anchor = ip;
+                nMisses = 0;
+
+                if (ip - 2 < matchFindLimit) {
+                    table[hash32(read32(src + ip - 2))] = (uint32_t) (ip - 2);
+                }
+            }
+        }
+
+        op = writeSequence(op, src + anchor, srcSize - anchor, 0, 0);
+
+        return op - dst;
+    }
+
+    bool lz4Decompress(const uint8_t * src, size_t srcSize, uint8_t * dst, size_t dstSize) {
+        const uint8_t * ip = src;
+        const uint8_t * const iend = src + srcSize;
+
+        uint8_t * op = dst;
+        uint8_t * const oend = dst + dstSize;
+
+        while (ip < iend) {
+            const uint8_t token = *ip++;
+
+            size_t nLiterals = token >> 4;
+            if (nLiterals == 15) {
+                uint8_t b = 0;
+                do {
+                    if (ip >= iend) return false;
+                    b = *ip++;
+                    nLiterals += b;
+                } while (b == 255);
+            }
+
+            if ((size_t) (iend - ip) < nLiterals || (size_t) (oend - op) < nLiterals) return false;
+
+            if (nLiterals > 0) {
+                std::memcpy(op, ip, nLiterals);
+                ip += nLiterals;
+                op += nLiterals;
+            }
+
+            // the last sequence has no match
+            if (ip == iend) {
+                break;
+            }
+
+            if (iend - ip < 2) return false;
+
+            const size_t offset = ip[0] | (ip[1] << 8);
+            ip += 2;
+
+            if (offset == 0 || offset > (size_t) (op - dst)) return false;
+
+            size_t matchLen = token & 15;
+            if (matchLen == 15) {
+                uint8_t b = 0;
+                do {
+                    if (ip >= iend) return false;
+                    b = *ip++;
+                    matchLen += b;
+                } while (b == 255);
+            }
+            matchLen += kMinMatch;
+
+            if ((size_t) (oend - op) < matchLen) return false;
+
+            const uint8_t * match = op - offset;
+            if (offset >= matchLen) {
+                std::memcpy(op, match, matchLen);
+                op += matchLen;
+            } else {
+                // overlapping copy
+                for (size_t i = 0; i < matchLen; ++i) {
+                    *op++ = *match++;
+                }
+            }
+        }
+
+        return op == oend;
+    }
+}
+
+namespace GGSock {
+namespace Compression {
+    bool isAvailable(Codec codec) {
+        switch (codec) {
+            case None:
+            case LZ4:
+                return true;
+            case Zstd:
+#ifdef GGSOCK_WITH_ZSTD
+                return true;
+#else
+                return false;
+#endif
+        };
+
+        return false;
+    }
+
+    size_t getMaxCompressedSize(Codec codec, size_t srcSize) {
+        switch (codec) {
+            case None:
+                return srcSize;
+            case LZ4:
+                return ::lz4Bound(srcSize);
+            case Zstd:
+#ifdef GGSOCK_WITH_ZSTD
+                return ZSTD_compressBound(srcSize);
+#else
+                return 0;
+#endif
+        };
+
+        return 0;
+    }
+
+    size_t getMaxDecompressedSize(Codec codec, const char * src, size_t srcSize) {
+        switch (codec) {
+            case None:
+                return srcSize;
+            case LZ4:
+                return ::lz4MaxDecompressedSize(srcSize);
+            case Zstd:
+                {
+#ifdef GGSOCK_WITH_ZSTD
+                    // the frame header carries the content size
+                    unsigned long long res = ZSTD_getFrameContentSize(src, srcSize);
+                    if (res == ZSTD_CONTENTSIZE_UNKNOWN || res == ZSTD_CONTENTSIZE_ERROR || res > SIZE_MAX) {
+                        return 0;
+                    }
+                    return (size_t) res;
+#else
+                    (void) src;
+                    return 0;
+#endif
+                }
+        };
+
+        return 0;
+    }
+
+    size_t compress(Codec codec, const char * src, size_t srcSize, char * dst, size_t dstCapacity, int level) {
+        (void) level;
+
+        switch (codec) {
+            case None:
+                return 0;
+            case LZ4:
+                return ::lz4Compress(reinterpret_cast<const uint8_t *>(src), srcSize, reinterpret_cast<uint8_t *>(dst), dstCapacity);
+            case Zstd:
+                {
+#ifdef GGSOCK_WITH_ZSTD
+                    size_t res = ZSTD_compress(dst, dstCapacity, src, srcSize, level);
+                    return ZSTD_isError(res) ? 0 : res;
+#else
+                    return 0;
+#endif
+                }
+        };
+
+        return 0;
+    }
+
+    bool decompress(Codec codec, const char * src, size_t srcSize, char * dst, size_t dstSize) {
+        switch (codec) {
+            case None:
+                return false;
+            case LZ4:
+                return ::lz4Decompress(reinterpret_cast<const uint8_t *>(src), srcSize, reinterpret_cast<uint8_t *>(dst), dstSize);
+            case Zstd:
+                {
+#ifdef GGSOCK_WITH_ZSTD
+                    size_t res = ZSTD_decompress(dst, dstSize, src, srcSize);
+                    return ZSTD_isError(res) == 0 && res == dstSize;
+#else
+                    return false;
+#endif
+                }
+        };
+
+        return false;
+    }
+}
+}
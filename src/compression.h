@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace GGSock {
+namespace Compression {
+    enum Codec : uint8_t {
+        None = 0,
+        LZ4  = 1,   // built-in, LZ4 block format
+        Zstd = 2,   // requires GGSOCK_ZSTD
+    };
+
+    bool isAvailable(Codec codec);
+
+    // upper bound of the compressed size for srcSize bytes of input
+    size_t getMaxCompressedSize(Codec codec, size_t srcSize);
+
+    // upper bound of the decompressed size of the srcSize bytes at src, 0 if it cannot be determined
+    // used to reject a frame before allocating for a forged original size
+    size_t getMaxDecompressedSize(Codec codec, const char * src, size_t srcSize);
+
+    // returns the compressed size or 0 on failure
+    size_t compress(Codec codec, const char * src, size_t srcSize, char * dst, size_t dstCapacity, int level);
+
+    // dstSize must be the exact decompressed size
+    bool decompress(Codec codec, const char * src, size_t srcSize, char * dst, size_t dstSize);
+}
+}
@@ -0,0 +1,203 @@
+#include "crc32c.h"
+
+#include <array>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define GGSOCK_CRC32C_SSE42
+#include <nmmintrin.h>
+#endif
+
+#if defined(__ARM_FEATURE_CRC32)
+#define GGSOCK_CRC32C_ARMV8
+#include <arm_acle.h>
+#endif
+
+namespace {
+    constexpr uint32_t kPolynomial = 0x82f63b78; // reflected 0x1edc6f41
+
+    // the hardware path runs 3 independent streams of this many bytes to hide the latency of the crc instruction
+    constexpr size_t kLaneSize = 4096;
+
+    struct Tables {
+        Tables() {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t crc = i;
+                for (int k = 0; k < 8; ++k) {
+                    crc = (crc >> 1) ^ (kPolynomial & (0 - (crc & 1)));
+                }
+                slicing[0][i] = crc;
+            }
+
+            for (uint32_t i = 0; i < 256; ++i) {
+                for (int k = 1; k < 8; ++k) {
+                    slicing[k][i] = (slicing[k - 1][i] >> 8) ^ slicing[0][slicing[k - 1][i] & 0xff];
+                }
+            }
+
+            // the crc register is linear, so appending kLaneSize zero bytes is a fixed 32x32 bit matrix
+            // build it from the basis vectors and expand it into byte tables
+            std::array<uint32_t, 32> basis;
+            for (int b = 0; b < 32; ++b) {
+                uint32_t crc = 1u << b;
+                for (size_t i = 0; i < kLaneSize; ++i) {
+                    crc = (crc >> 8) ^ slicing[0][crc & 0xff];
+                }
+                basis[b] = crc;
+            }
+
+            for (int k = 0; k < 4; ++k) {
+                for (uint32_t i = 0; i < 256; ++i) {
+                    uint32_t res = 0;
+                    for (int b = 0; b < 8; ++b) {
+                        if (i & (1u << b)) {
+                            res ^= basis[8*k + b];
+                        }
+                    }
+                    shiftLane[k][i] = res;
+                }
+            }
+        }
+
+        uint32_t shift(uint32_t crc) const {
+            return
+                shiftLane[0][crc & 0xff] ^
+                shiftLane[1][(crc >> 8) & 0xff] ^
+                shiftLane[2][(crc >> 16) & 0xff] ^
+                shiftLane[3][crc >> 24];
+        }
+
+        uint32_t slicing[8][256];
+        uint32_t shiftLane[4][256];
+    };
+
+    const Tables & getTables() {
+        static Tables tables;
+        return tables;
+    }
+
+    uint32_t extendPortable(uint32_t crc, const uint8_t * data, size_t size) {
+        const auto & t = getTables().slicing;
+
+        while (size > 0 && (reinterpret_cast<uintptr_t>(data) & 7) != 0) {
+            crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xff];
+            --size;
+        }
+
+        while (size >= 8) {
+            uint32_t lo;
+            uint32_t hi;
+            std::memcpy(&lo, data, 4);
+            std::memcpy(&hi, data + 4, 4);
+            lo ^= crc;
+            crc =
+                t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+                t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+            data += 8;
+            size -= 8;
+        }
+
+        while (size > 0) {
+            crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xff];
+            --size;
+        }
+
+        return crc;
+    }
+
+#if defined(GGSOCK_CRC32C_SSE42) || defined(GGSOCK_CRC32C_ARMV8)
+#if defined(GGSOCK_CRC32C_SSE42)
+#define GGSOCK_CRC32C_TARGET __attribute__((target("sse4.2")))
+    GGSOCK_CRC32C_TARGET inline uint32_t crc8(uint32_t crc, uint8_t v) { return _mm_crc32_u8(crc, v); }
+#if defined(__x86_64__)
+    GGSOCK_CRC32C_TARGET inline uint32_t crc64(uint32_t crc, uint64_t v) { return (uint32_t) _mm_crc32_u64(crc, v); }
+#else
+    GGSOCK_CRC32C_TARGET inline uint32_t crc64(uint32_t crc, uint64_t v) { return _mm_crc32_u32(_mm_crc32_u32(crc, (uint32_t) v), (uint32_t) (v >> 32)); }
+#endif
+#else
+#define GGSOCK_CRC32C_TARGET
+    inline uint32_t crc8(uint32_t crc, uint8_t v) { return __crc32cb(crc, v); }
+    inline uint32_t crc64(uint32_t crc, uint64_t v) { return __crc32cd(crc, v); }
+#endif
+
+    GGSOCK_CRC32C_TARGET uint32_t extendHardware(uint32_t crc, const uint8_t * data, size_t size) {
+        while (size > 0 && (reinterpret_cast<uintptr_t>(data) & 7) != 0) {
+            crc = crc8(crc, *data++);
+            --size;
+        }
+
+        if (size >= 3*kLaneSize) {
+            const auto & tables = getTables();
+
+            while (size >= 3*kLaneSize) {
+                uint32_t crc0 = crc;
+                uint32_t crc1 = 0;
+                uint32_t crc2 = 0;
+                for (size_t i = 0; i < kLaneSize; i += 8) {
+                    uint64_t v0, v1, v2;
+                    std::memcpy(&v0, data + i, 8);
+                    std::memcpy(&v1, data + kLaneSize + i, 8);
+                    std::memcpy(&v2, data + 2*kLaneSize + i, 8);
+                    crc0 = crc64(crc0, v0);
+                    crc1 = crc64(crc1, v1);
+                    crc2 = crc64(crc2, v2);
+                }
+                crc = tables.shift(tables.shift(crc0) ^ crc1) ^ crc2;
+
+                data += 3*kLaneSize;
+                size -= 3*kLaneSize;
+            }
+        }
+
+        while (size >= 8) {
+            uint64_t v;
+            std::memcpy(&v, data, 8);
+            crc = crc64(crc, v);
+            data += 8;
+            size -= 8;
+        }
+
+        while (size > 0) {
+            crc = crc8(crc, *data++);
+            --size;
+        }
+
+        return crc;
+    }
+#endif
+
+    bool hasHardwareSupport() {
+#if defined(GGSOCK_CRC32C_SSE42)
+        static const bool result = __builtin_cpu_supports("sse4.2");
+        return result;
+#elif defined(GGSOCK_CRC32C_ARMV8)
+        return true;
+#else
+        return false;
+#endif
+    }
+}
+
+namespace GGSock {
+namespace CRC32C {
+    uint32_t compute(const void * data, size_t size) {
+        return extend(0, data, size);
+    }
+
+    uint32_t extend(uint32_t crc, const void * data, size_t size) {
+        const uint8_t * p = reinterpret_cast<const uint8_t *>(data);
+
+#if defined(GGSOCK_CRC32C_SSE42) || defined(GGSOCK_CRC32C_ARMV8)
+        if (hasHardwareSupport()) {
+            return ~extendHardware(~crc, p, size);
+        }
+#endif
+
+        return ~extendPortable(~crc, p, size);
+    }
+
+    bool isHardwareAccelerated() {
+        return hasHardwareSupport();
+    }
+}
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace GGSock {
+namespace CRC32C {
+    // CRC-32C (Castagnoli), as used by iSCSI / SCTP / ext4
+    // uses the SSE4.2 or ARMv8 CRC instructions when available and slicing-by-8 tables otherwise
+    uint32_t compute(const void * data, size_t size);
+    uint32_t extend(uint32_t crc, const void * data, size_t size);
+
+    bool isHardwareAccelerated();
+}
+}
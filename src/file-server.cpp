@@ -1,5 +1,6 @@
 #include "ggsock/file-server.h"
 
+#include "ggsock/buffer-pool.h"
 #include "ggsock/communicator.h"
 
 #include "ggsock/serialization.h"
@@ -11,90 +12,6 @@
 
 namespace GGSock {
 
-//
-// Serialization
-//
-
-// FileServer::FileInfo
-
-template <>
-bool Serialize::operator()<FileServer::FileInfo>(const FileServer::FileInfo & obj, SerializationBuffer & buffer, size_t & offset) {
-    bool res = true;
-
-    res = res && operator()(obj.uri, buffer, offset);
-    res = res && operator()(obj.filesize, buffer, offset);
-    res = res && operator()(obj.filename, buffer, offset);
-    res = res && operator()(obj.nChunks, buffer, offset);
-
-    return res;
-}
-
-template <>
-bool Unserialize::operator()<FileServer::FileInfo>(FileServer::FileInfo & obj, const char * bufferData, size_t bufferSize, size_t & offset) {
-    bool res = true;
-
-    res = res && operator()(obj.uri, bufferData, bufferSize, offset);
-    res = res && operator()(obj.filesize, bufferData, bufferSize, offset);
-    res = res && operator()(obj.filename, bufferData, bufferSize, offset);
-    res = res && operator()(obj.nChunks, bufferData, bufferSize, offset);
-
-    return res;
-}
-
-// FileServer::FileChunkRequestData
-
-template <>
-bool Serialize::operator()<FileServer::FileChunkRequestData>(const FileServer::FileChunkRequestData & obj, SerializationBuffer & buffer, size_t & offset) {
-    bool res = true;
-
-    res = res && operator()(obj.uri, buffer, offset);
-    res = res && operator()(obj.chunkId, buffer, offset);
-    res = res && operator()(obj.nChunksHave, buffer, offset);
-    res = res && operator()(obj.nChunksExpected, buffer, offset);
-
-    return res;
-}
-
-template <>
-bool Unserialize::operator()<FileServer::FileChunkRequestData>(FileServer::FileChunkRequestData & obj, const char * bufferData, size_t bufferSize, size_t & offset) {
-    bool res = true;
-
-    res = res && operator()(obj.uri, bufferData, bufferSize, offset);
-    res = res && operator()(obj.chunkId, bufferData, bufferSize, offset);
-    res = res && operator()(obj.nChunksHave, bufferData, bufferSize, offset);
-    res = res && operator()(obj.nChunksExpected, bufferData, bufferSize, offset);
-
-    return res;
-}
-
-// FileServer::FileChunkResponseData
-
-template <>
-bool Serialize::operator()<FileServer::FileChunkResponseData>(const FileServer::FileChunkResponseData & obj, SerializationBuffer & buffer, size_t & offset) {
-    bool res = true;
-
-    res = res && operator()(obj.uri, buffer, offset);
-    res = res && operator()(obj.chunkId, buffer, offset);
-    res = res && operator()(obj.data, buffer, offset);
-    res = res && operator()(obj.pStart, buffer, offset);
-    res = res && operator()(obj.pLen, buffer, offset);
-
-    return res;
-}
-
-template <>
-bool Unserialize::operator()<FileServer::FileChunkResponseData>(FileServer::FileChunkResponseData & obj, const char * bufferData, size_t bufferSize, size_t & offset) {
-    bool res = true;
-
-    res = res && operator()(obj.uri, bufferData, bufferSize, offset);
-    res = res && operator()(obj.chunkId, bufferData, bufferSize, offset);
-    res = res && operator()(obj.data, bufferData, bufferSize, offset);
-    res = res && operator()(obj.pStart, bufferData, bufferSize, offset);
-    res = res && operator()(obj.pLen, bufferData, bufferSize, offset);
-
-    return res;
-}
-
 //
 // FileServer
 //
@@ -128,6 +45,12 @@ struct FileServer::Impl {
             fileInfos[i] = file.info;
         }
 
+        // encoded once and shared by all clients that request it
+        // the server does not enable checksums, so only compression needs a per-connection frame
+        SerializationBuffer buffer;
+        Serialize()(fileInfos, buffer);
+        fileInfosFrame = Communicator::makeSharedFrame(MsgFileInfosResponse, buffer.data(), (Communicator::TBufferSize) buffer.size());
+
         return true;
     }
 
@@ -179,10 +102,13 @@ struct FileServer::Impl {
 
     bool changedFileInfos = false;
     TFileInfos fileInfos;
+    Communicator::TSharedFrame fileInfosFrame;
 
     bool changedClientInfos = false;
     TClientInfos clientInfos;
 
+    std::shared_ptr<RateLimiter> rateLimiter;
+
     std::mutex mutex;
     std::vector<std::thread> workers;
 };
@@ -209,9 +135,19 @@ bool FileServer::init(const Parameters & parameters) {
     m_impl->files.resize(m_impl->parameters.nMaxFiles);
     m_impl->clients.resize(m_impl->parameters.nMaxClients);
 
+    if (m_impl->parameters.maxRateTotal_Bps > 0) {
+        m_impl->rateLimiter = std::make_shared<RateLimiter>(m_impl->parameters.maxRateTotal_Bps);
+    }
+
     for (int i = 0; i <(int)  m_impl->clients.size(); ++i) {
         auto & client = m_impl->clients[i];
 
+        client.communicator->setRateLimit(m_impl->parameters.maxRatePerClient_Bps);
+        client.communicator->setSharedRateLimiter(m_impl->rateLimiter);
+        if (m_impl->parameters.useCompression) {
+            client.communicator->setCompression({});
+        }
+
         client.communicator->setErrorCallback([i](Communicator::TErrorCode code) {
             printf("Client %d disconnected, code = %d\n", i, code);
         });
@@ -229,7 +165,10 @@ bool FileServer::init(const Parameters & parameters) {
         client.communicator->setMessageCallback(MsgFileChunkRequest, [this, i](const char * dataBuffer, Communicator::TBufferSize dataSize) {
             size_t offset = 0;
             FileChunkRequestData data;
-            Unserialize()(data, dataBuffer, dataSize, offset);
+            if (Unserialize()(data, dataBuffer, dataSize, offset) == false) {
+                printf("Invalid chunk request from client %d\n", i);
+                return 0;
+            }
             //printf("Received chunk request %d for file '%s'\n", data.chunkId, data.uri.c_str());
 
             {
@@ -291,6 +230,7 @@ bool FileServer::update() {
     bool doSendFileInfos = false;
     bool doSendFileChunk = false;
 
+    Communicator::TSharedFrame fileInfosFrame;
     FileChunkResponseData fileChunkToSend;
 
     TClientId updateId = -1;
@@ -301,6 +241,13 @@ bool FileServer::update() {
         if (m_impl->changedFileInfos) {
             m_impl->updateFileInfos();
             m_impl->changedFileInfos = false;
+
+            // push the new file infos to the connected clients, the rest request them after connecting
+            for (auto & client : m_impl->clients) {
+                if (client.wasConnected) {
+                    client.sendFileInfos = true;
+                }
+            }
         }
 
         if (m_impl->changedClientInfos) {
@@ -324,8 +271,15 @@ bool FileServer::update() {
 
         doSendFileInfos = client.sendFileInfos;
         client.sendFileInfos = false;
+        if (doSendFileInfos) {
+            if (m_impl->fileInfosFrame == nullptr) {
+                m_impl->updateFileInfos();
+            }
+            fileInfosFrame = m_impl->fileInfosFrame;
+        }
 
-        if (client.fileChunkRequests.size() > 0) {
+        // do not queue more chunks while the previous one is still being paced out
+        if (client.fileChunkRequests.size() > 0 && client.communicator->getNumPendingMessages() == 0) {
             const auto & req = client.fileChunkRequests.front();
 
             // todo : data checks
@@ -348,6 +302,7 @@ bool FileServer::update() {
 
                 fileChunkToSend.pStart = pStart;
                 fileChunkToSend.pLen = pLen;
+                fileChunkToSend.data = BufferPool::acquire(pLen);
                 fileChunkToSend.data.assign(file.data.begin() + pStart, file.data.begin() + pStart + pLen);
 
                 doSendFileChunk = true;
@@ -382,15 +337,18 @@ bool FileServer::update() {
             client.communicator->stopListening();
         }
         if (doSendFileInfos) {
-            SerializationBuffer buffer;
-            Serialize()(m_impl->fileInfos, buffer);
-            client.communicator->send(MsgFileInfosResponse, buffer.data(), (int) buffer.size());
+            if (m_impl->parameters.useCompression) {
+                // shared frames are sent uncompressed, so the payload is encoded again for this connection
+                const size_t offset = Communicator::getFrameDataOffset();
+                client.communicator->send(MsgFileInfosResponse, fileInfosFrame->data() + offset, fileInfosFrame->size() - offset);
+            } else {
+                client.communicator->send(fileInfosFrame);
+            }
             client.communicator->update();
         }
         if (doSendFileChunk) {
-            SerializationBuffer buffer;
-            Serialize()(fileChunkToSend, buffer);
-            client.communicator->send(MsgFileChunkResponse, buffer.data(), (int) buffer.size());
+            client.communicator->sendSerialized(MsgFileChunkResponse, fileChunkToSend);
+            BufferPool::release(fileChunkToSend.data);
             client.communicator->update();
         }
         client.communicator->update();
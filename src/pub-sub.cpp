@@ -0,0 +1,421 @@
+#include "ggsock/pub-sub.h"
+
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+    using TTopic = ::GGSock::PubSubBroker::TTopic;
+
+    constexpr size_t kTopicSize = sizeof(TTopic);
+
+    bool parseTopic(const char * dataBuffer, size_t dataSize, TTopic & topic) {
+        if (dataSize < kTopicSize) {
+            return false;
+        }
+
+        std::memcpy(&topic, dataBuffer, sizeof(topic));
+
+        return true;
+    }
+}
+
+namespace GGSock {
+    struct PubSubBroker::Data {
+        using TGroup = std::shared_ptr<CommunicatorGroup>;
+
+        struct Peer {
+            TCommunicator communicator;
+
+            // the subscriptions belong to this connection of the communicator
+            uint64_t connectionId = 0;
+            std::unordered_set<TTopic> topics;
+        };
+
+        struct Publish {
+            TTopic topic;
+            Communicator::TSharedFrame frame;
+        };
+
+        Data(const Parameters & parameters) : parameters(parameters) {}
+
+        // a message from a new connection of the peer replaces the subscriptions of the previous one
+        Peer * findPeer(Communicator * peer, uint64_t connectionId) {
+            auto it = peers.find(peer);
+            if (it == peers.end()) {
+                return nullptr;
+            }
+
+            if (it->second.connectionId != connectionId) {
+                unsubscribeAll(it->second);
+                it->second.connectionId = connectionId;
+            }
+
+            return &it->second;
+        }
+
+        void subscribe(Communicator * peer, uint64_t connectionId, TTopic topic) {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            auto p = findPeer(peer, connectionId);
+            if (p == nullptr) {
+                return;
+            }
+
+            auto & subscribers = index[topic];
+            if (subscribers == nullptr) {
+                subscribers = std::make_shared<CommunicatorGroup>(parameters.delivery);
+            }
+
+            if (subscribers->add(p->communicator)) {
+                p->topics.insert(topic);
+            }
+        }
+
+        void unsubscribe(Peer & peer, TTopic topic) {
+            auto it = index.find(topic);
+            if (it == index.end()) {
+                return;
+            }
+
+            it->second->remove(peer.communicator);
+            peer.topics.erase(topic);
+
+            if (it->second->size() == 0) {
+                index.erase(it);
+            }
+        }
+
+        void unsubscribe(Communicator * peer, uint64_t connectionId, TTopic topic) {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            auto p = findPeer(peer, connectionId);
+            if (p == nullptr) {
+                return;
+            }
+
+            unsubscribe(*p, topic);
+        }
+
+        void unsubscribeAll(Peer & peer) {
+            auto topics = peer.topics;
+            for (auto topic : topics) {
+                unsubscribe(peer, topic);
+            }
+        }
+
+        // called from the peer's callback - only queues the frame, the communicator lock is held
+        void enqueue(TTopic topic, const char * dataBuffer, size_t dataSize) {
+            auto frame = Communicator::makeSharedFrame(MsgPublish, dataBuffer, (Communicator::TBufferSize) dataSize);
+
+            std::lock_guard<std::mutex> lock(mutexPending);
+            pending.push_back({ topic, std::move(frame) });
+        }
+
+        // the group is sent to without holding the broker lock, since the callbacks take it under the communicator lock
+        int32_t deliver(TTopic topic, const Communicator::TSharedFrame & frame) {
+            TGroup subscribers;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                auto it = index.find(topic);
+                if (it == index.end()) {
+                    return 0;
+                }
+                subscribers = it->second;
+            }
+
+            return subscribers->send(frame);
+        }
+
+        void removeDisconnectedPeers() {
+            struct Snapshot {
+                TCommunicator communicator;
+                uint64_t connectionId;
+            };
+
+            std::vector<Snapshot> snapshots;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (const auto & peer : peers) {
+                    if (peer.second.topics.empty() == false) {
+                        snapshots.push_back({ peer.second.communicator, peer.second.connectionId });
+                    }
+                }
+            }
+
+            for (auto & snapshot : snapshots) {
+                // isConnected first - the connection id is then at least that of the current connection
+                const bool isConnected = snapshot.communicator->isConnected();
+                if (isConnected && snapshot.communicator->getConnectionId() == snapshot.connectionId) {
+                    continue;
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+
+                // the peer may have subscribed on its new connection in the meantime
+                auto it = peers.find(snapshot.communicator.get());
+                if (it != peers.end() && it->second.connectionId == snapshot.connectionId) {
+                    unsubscribeAll(it->second);
+                }
+            }
+        }
+
+        const Parameters parameters;
+
+        mutable std::mutex mutex;
+
+        std::unordered_map<Communicator *, Peer> peers;
+        std::unordered_map<TTopic, TGroup> index;
+
+        std::mutex mutexPending;
+        std::vector<Publish> pending;
+    };
+
+    PubSubBroker::PubSubBroker() : data_(new Data(Parameters())) {
+    }
+
+    PubSubBroker::PubSubBroker(const Parameters & parameters) : data_(new Data(parameters)) {
+    }
+
+    PubSubBroker::~PubSubBroker() {
+        auto & data = getData();
+
+        std::vector<TCommunicator> peers;
+        {
+            std::lock_guard<std::mutex> lock(data.mutex);
+            for (auto & peer : data.peers) {
+                peers.push_back(peer.second.communicator);
+            }
+        }
+
+        for (auto & peer : peers) {
+            removePeer(peer);
+        }
+    }
+
+    bool PubSubBroker::addPeer(const TCommunicator & communicator) {
+        auto & data = getData();
+
+        if (communicator == nullptr) return false;
+
+        {
+            std::lock_guard<std::mutex> lock(data.mutex);
+
+            if (data.peers.count(communicator.get()) > 0) return false;
+
+            auto & peer = data.peers[communicator.get()];
+            peer.communicator = communicator;
+            peer.connectionId = communicator->getConnectionId();
+        }
+
+        // the callbacks are installed without holding the broker lock - they run under the communicator lock
+        Communicator * peer = communicator.get();
+
+        communicator->setMessageCallback(MsgSubscribe, [&data, peer](const char * dataBuffer, Communicator::TBufferSize dataSize) {
+            TTopic topic = 0;
+            if (::parseTopic(dataBuffer, dataSize, topic)) {
+                data.subscribe(peer, peer->getConnectionId(), topic);
+            }
+            return 0;
+        });
+
+        communicator->setMessageCallback(MsgUnsubscribe, [&data, peer](const char * dataBuffer, Communicator::TBufferSize dataSize) {
+            TTopic topic = 0;
+            if (::parseTopic(dataBuffer, dataSize, topic)) {
+                data.unsubscribe(peer, peer->getConnectionId(), topic);
+            }
+            return 0;
+        });
+
+        communicator->setMessageCallback(MsgPublish, [&data](const char * dataBuffer, Communicator::TBufferSize dataSize) {
+            TTopic topic = 0;
+            if (::parseTopic(dataBuffer, dataSize, topic)) {
+                data.enqueue(topic, dataBuffer, dataSize);
+            }
+            return 0;
+        });
+
+        return true;
+    }
+
+    bool PubSubBroker::removePeer(const TCommunicator & communicator) {
+        auto & data = getData();
+
+        if (communicator == nullptr) return false;
+
+        communicator->removeMessageCallback(MsgSubscribe);
+        communicator->removeMessageCallback(MsgUnsubscribe);
+        communicator->removeMessageCallback(MsgPublish);
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+
+        auto it = data.peers.find(communicator.get());
+        if (it == data.peers.end()) return false;
+
+        data.unsubscribeAll(it->second);
+        data.peers.erase(it);
+
+        return true;
+    }
+
+    bool PubSubBroker::update() {
+        auto & data = getData();
+
+        data.removeDisconnectedPeers();
+
+        std::vector<Data::Publish> pending;
+        {
+            std::lock_guard<std::mutex> lock(data.mutexPending);
+            pending.swap(data.pending);
+        }
+
+        for (const auto & publish : pending) {
+            data.deliver(publish.topic, publish.frame);
+        }
+
+        return true;
+    }
+
+    int32_t PubSubBroker::publish(TTopic topic, const char * dataBuffer, Communicator::TBufferSize dataSize) {
+        std::vector<char> msg(kTopicSize + dataSize);
+        std::memcpy(msg.data(), &topic, sizeof(topic));
+        if (dataSize > 0) {
+            std::memcpy(msg.data() + kTopicSize, dataBuffer, dataSize);
+        }
+
+        return getData().deliver(topic, Communicator::makeSharedFrame(MsgPublish, msg.data(), (Communicator::TBufferSize) msg.size()));
+    }
+
+    int32_t PubSubBroker::getNumSubscribers(TTopic topic) const {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+
+        auto it = data.index.find(topic);
+        return it == data.index.end() ? 0 : it->second->size();
+    }
+
+    struct PubSubClient::Data {
+        Data(Communicator & communicator) : communicator(communicator) {}
+
+        bool sendTopic(Communicator::TMessageType type, TTopic topic) {
+            return communicator.send(type, reinterpret_cast<const char *>(&topic), sizeof(topic));
+        }
+
+        void onPublish(const char * dataBuffer, size_t dataSize) {
+            TTopic topic = 0;
+            if (::parseTopic(dataBuffer, dataSize, topic) == false) {
+                return;
+            }
+
+            CBMessage callback;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto it = callbacks.find(topic);
+                if (it == callbacks.end()) {
+                    // unsubscribed while the message was in flight
+                    return;
+                }
+                callback = it->second;
+            }
+
+            if (callback) {
+                callback(topic, dataBuffer + kTopicSize, (Communicator::TBufferSize) (dataSize - kTopicSize));
+            }
+        }
+
+        Communicator & communicator;
+
+        bool wasConnected = false;
+
+        std::map<TTopic, CBMessage> callbacks;
+
+        mutable std::mutex mutex;
+    };
+
+    PubSubClient::PubSubClient(Communicator & communicator) : data_(new Data(communicator)) {
+        auto & data = getData();
+
+        communicator.setMessageCallback(PubSubBroker::MsgPublish, [&data](const char * dataBuffer, Communicator::TBufferSize dataSize) {
+            data.onPublish(dataBuffer, dataSize);
+            return 0;
+        });
+    }
+
+    PubSubClient::~PubSubClient() {
+        auto & data = getData();
+
+        data.communicator.removeMessageCallback(PubSubBroker::MsgPublish);
+    }
+
+    bool PubSubClient::update() {
+        auto & data = getData();
+
+        std::vector<TTopic> topics;
+        {
+            std::lock_guard<std::mutex> lock(data.mutex);
+
+            bool isConnected = data.communicator.isConnected();
+            if (isConnected == data.wasConnected) {
+                return true;
+            }
+            data.wasConnected = isConnected;
+
+            if (isConnected == false) {
+                return true;
+            }
+
+            for (const auto & callback : data.callbacks) {
+                topics.push_back(callback.first);
+            }
+        }
+
+        bool res = true;
+        for (auto topic : topics) {
+            res = data.sendTopic(PubSubBroker::MsgSubscribe, topic) && res;
+        }
+
+        return res;
+    }
+
+    bool PubSubClient::subscribe(TTopic topic, CBMessage && callback) {
+        auto & data = getData();
+
+        {
+            std::lock_guard<std::mutex> lock(data.mutex);
+            data.callbacks[topic] = std::move(callback);
+        }
+
+        // if not connected, the subscription is sent by update() after connecting
+        return data.sendTopic(PubSubBroker::MsgSubscribe, topic);
+    }
+
+    bool PubSubClient::unsubscribe(TTopic topic) {
+        auto & data = getData();
+
+        {
+            std::lock_guard<std::mutex> lock(data.mutex);
+            if (data.callbacks.erase(topic) == 0) {
+                return false;
+            }
+        }
+
+        return data.sendTopic(PubSubBroker::MsgUnsubscribe, topic);
+    }
+
+    bool PubSubClient::publish(TTopic topic, const char * dataBuffer, Communicator::TBufferSize dataSize) {
+        auto & data = getData();
+
+        std::vector<char> msg(kTopicSize + dataSize);
+        std::memcpy(msg.data(), &topic, sizeof(topic));
+        if (dataSize > 0) {
+            std::memcpy(msg.data() + kTopicSize, dataBuffer, dataSize);
+        }
+
+        return data.communicator.send(PubSubBroker::MsgPublish, msg.data(), (Communicator::TBufferSize) msg.size());
+    }
+}
@@ -0,0 +1,164 @@
+#include "ggsock/rate-limiter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+    // a blocked sender that has not retried for this long is considered gone
+    constexpr int64_t kWaiterTimeout_us = 100000;
+}
+
+namespace GGSock {
+    struct RateLimiter::Data {
+        using TClock = std::chrono::steady_clock;
+
+        Data(TRate maxRate_Bps, int64_t maxBurst_bytes) :
+            maxRate_Bps(maxRate_Bps),
+            maxBurst_bytes(maxBurst_bytes > 0 ? maxBurst_bytes : (std::max)((int64_t) 64*1024, maxRate_Bps/10)),
+            tokens((double) this->maxBurst_bytes),
+            tLastRefill(TClock::now()) {}
+
+        void refill(TClock::time_point tNow) {
+            double dt = std::chrono::duration<double>(tNow - tLastRefill).count();
+            tLastRefill = tNow;
+
+            tokens = (std::min)((double) maxBurst_bytes, tokens + dt*maxRate_Bps);
+        }
+
+        bool isAvailable(int64_t nBytes) const {
+            return tokens >= (double) (std::min)(nBytes, maxBurst_bytes);
+        }
+
+        void enqueue(TOwner owner, TClock::time_point tNow) {
+            auto it = waiters.find(owner);
+            if (it == waiters.end()) {
+                waitersQueue.push_back(owner);
+                waiters[owner] = tNow;
+            } else {
+                it->second = tNow;
+            }
+        }
+
+        void dropStaleWaiters(TClock::time_point tNow) {
+            while (waitersQueue.empty() == false) {
+                auto it = waiters.find(waitersQueue.front());
+                if (it != waiters.end() &&
+                    std::chrono::duration_cast<std::chrono::microseconds>(tNow - it->second).count() < kWaiterTimeout_us) {
+                    break;
+                }
+                if (it != waiters.end()) {
+                    waiters.erase(it);
+                }
+                waitersQueue.pop_front();
+            }
+        }
+
+        const TRate maxRate_Bps;
+        const int64_t maxBurst_bytes;
+
+        double tokens;
+        TClock::time_point tLastRefill;
+
+        std::deque<TOwner> waitersQueue;
+        std::unordered_map<TOwner, TClock::time_point> waiters;
+
+        mutable std::mutex mutex;
+    };
+
+    RateLimiter::RateLimiter(TRate maxRate_Bps, int64_t maxBurst_bytes) : data_(new Data(maxRate_Bps, maxBurst_bytes)) {}
+    RateLimiter::~RateLimiter() {}
+
+    bool RateLimiter::acquire(TOwner owner, int64_t nBytes) {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+
+        auto tNow = Data::TClock::now();
+        data.refill(tNow);
+        data.dropStaleWaiters(tNow);
+
+        // somebody else has been waiting longer
+        if (data.waitersQueue.empty() == false && data.waitersQueue.front() != owner) {
+            data.enqueue(owner, tNow);
+            return false;
+        }
+
+        if (data.isAvailable(nBytes) == false) {
+            data.enqueue(owner, tNow);
+            return false;
+        }
+
+        data.tokens -= nBytes;
+
+        if (data.waitersQueue.empty() == false) {
+            data.waiters.erase(owner);
+            data.waitersQueue.pop_front();
+        }
+
+        return true;
+    }
+
+    bool RateLimiter::isAvailable(int64_t nBytes) const {
+        auto & data = const_cast<Data &>(getData());
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+
+        data.refill(Data::TClock::now());
+
+        return data.isAvailable(nBytes);
+    }
+
+    int64_t RateLimiter::getTimeToAvailable_us(int64_t nBytes) const {
+        auto & data = const_cast<Data &>(getData());
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+
+        data.refill(Data::TClock::now());
+
+        if (data.isAvailable(nBytes)) {
+            return 0;
+        }
+
+        double missing = (double) (std::min)(nBytes, data.maxBurst_bytes) - data.tokens;
+
+        return (int64_t) std::ceil(1e6*missing/data.maxRate_Bps);
+    }
+
+    void RateLimiter::consume(int64_t nBytes) {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+
+        data.refill(Data::TClock::now());
+        data.tokens -= nBytes;
+    }
+
+    void RateLimiter::cancel(TOwner owner) {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+
+        if (data.waiters.erase(owner) == 0) {
+            return;
+        }
+
+        for (auto it = data.waitersQueue.begin(); it != data.waitersQueue.end(); ++it) {
+            if (*it == owner) {
+                data.waitersQueue.erase(it);
+                break;
+            }
+        }
+    }
+
+    RateLimiter::TRate RateLimiter::getMaxRate() const {
+        return getData().maxRate_Bps;
+    }
+
+    int64_t RateLimiter::getMaxBurst() const {
+        return getData().maxBurst_bytes;
+    }
+}
@@ -0,0 +1,329 @@
+#include "ggsock/record-file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+    constexpr uint32_t kMagic = 0x52534747; // "GGSR"
+    constexpr uint32_t kVersion = 1;
+
+    constexpr size_t kHeaderSize = 2*sizeof(uint32_t);
+    constexpr size_t kFooterSize = 2*sizeof(uint64_t) + sizeof(uint32_t);
+
+    // the offset table is not aligned
+    inline uint64_t readU64(const char * p) {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    // flush to disk before the rename, so a crash leaves either the old or the complete new file
+    bool syncFile(FILE * f) {
+        if (fflush(f) != 0) {
+            return false;
+        }
+#ifdef _WIN32
+        return _commit(_fileno(f)) == 0;
+#else
+        return fsync(fileno(f)) == 0;
+#endif
+    }
+
+    bool replaceFile(const std::string & src, const std::string & dst) {
+#ifdef _WIN32
+        return MoveFileExA(src.c_str(), dst.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        return rename(src.c_str(), dst.c_str()) == 0;
+#endif
+    }
+}
+
+namespace GGSock {
+
+    //
+    // RecordFileWriter
+    //
+
+    struct RecordFileWriter::Data {
+        FILE * fout = nullptr;
+
+        std::string path;
+        std::string pathTmp;
+        bool isFailed = false;
+
+        uint64_t offset = 0;
+        std::vector<uint64_t> offsets;
+
+        bool write(const void * src, size_t nBytes) {
+            if (nBytes > 0 && fwrite(src, 1, nBytes, fout) != nBytes) {
+                isFailed = true;
+                return false;
+            }
+            offset += nBytes;
+
+            return true;
+        }
+    };
+
+    RecordFileWriter::RecordFileWriter() : data_(new Data()) {
+    }
+
+    RecordFileWriter::~RecordFileWriter() {
+        close();
+    }
+
+    bool RecordFileWriter::open(const std::string & path) {
+        auto & data = getData();
+
+        close();
+
+        data.path = path;
+        data.pathTmp = path + ".tmp";
+
+        data.fout = fopen(data.pathTmp.c_str(), "wb");
+        if (data.fout == nullptr) {
+            fprintf(stderr, "Failed to open '%s' for writing\n", data.pathTmp.c_str());
+            return false;
+        }
+
+        data.isFailed = false;
+        data.offset = 0;
+        data.offsets.clear();
+
+        return data.write(&kMagic, sizeof(kMagic)) && data.write(&kVersion, sizeof(kVersion));
+    }
+
+    bool RecordFileWriter::close() {
+        auto & data = getData();
+
+        if (data.fout == nullptr) {
+            return false;
+        }
+
+        const uint64_t nRecords = data.offsets.size();
+        const uint64_t tableOffset = data.offset;
+
+        // the end of the last record is the start of the table
+        data.offsets.push_back(tableOffset);
+
+        bool res = data.isFailed == false;
+        res = res && data.write(data.offsets.data(), data.offsets.size()*sizeof(uint64_t));
+        res = res && data.write(&nRecords, sizeof(nRecords));
+        res = res && data.write(&tableOffset, sizeof(tableOffset));
+        res = res && data.write(&kMagic, sizeof(kMagic));
+        res = res && ::syncFile(data.fout);
+
+        res = (fclose(data.fout) == 0) && res;
+        data.fout = nullptr;
+        data.offsets.clear();
+
+        // the file at path is replaced only by a complete file
+        if (res && ::replaceFile(data.pathTmp, data.path) == false) {
+            fprintf(stderr, "Failed to rename '%s' to '%s'\n", data.pathTmp.c_str(), data.path.c_str());
+            res = false;
+        }
+        if (res == false) {
+            remove(data.pathTmp.c_str());
+        }
+
+        return res;
+    }
+
+    bool RecordFileWriter::append(const char * dataBuffer, size_t dataSize) {
+        auto & data = getData();
+
+        if (data.fout == nullptr) {
+            return false;
+        }
+
+        data.offsets.push_back(data.offset);
+
+        return data.write(dataBuffer, dataSize);
+    }
+
+    size_t RecordFileWriter::getNumRecords() const {
+        return getData().offsets.size();
+    }
+
+    //
+    // RecordFileReader
+    //
+
+    struct RecordFileReader::Data {
+        const char * mapping = nullptr;
+        size_t mappingSize = 0;
+
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE fileMapping = NULL;
+#endif
+
+        uint64_t nRecords = 0;
+        uint64_t tableOffset = 0;
+
+        void unmap() {
+#ifdef _WIN32
+            if (mapping) UnmapViewOfFile(mapping);
+            if (fileMapping) CloseHandle(fileMapping);
+            if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+            fileMapping = NULL;
+            file = INVALID_HANDLE_VALUE;
+#else
+            if (mapping) munmap(const_cast<char *>(mapping), mappingSize);
+#endif
+            mapping = nullptr;
+            mappingSize = 0;
+            nRecords = 0;
+            tableOffset = 0;
+        }
+
+        bool map(const std::string & path) {
+#ifdef _WIN32
+            file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (file == INVALID_HANDLE_VALUE) {
+                return false;
+            }
+
+            LARGE_INTEGER size;
+            if (GetFileSizeEx(file, &size) == 0 || size.QuadPart == 0) {
+                return false;
+            }
+
+            fileMapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (fileMapping == NULL) {
+                return false;
+            }
+
+            mapping = (const char *) MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+            mappingSize = (size_t) size.QuadPart;
+#else
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return false;
+            }
+
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size == 0) {
+                ::close(fd);
+                return false;
+            }
+
+            // the mapping stays valid after the descriptor is closed
+            void * p = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+
+            if (p == MAP_FAILED) {
+                return false;
+            }
+
+            mapping = (const char *) p;
+            mappingSize = (size_t) st.st_size;
+#endif
+            return mapping != nullptr;
+        }
+    };
+
+    RecordFileReader::RecordFileReader() : data_(new Data()) {
+    }
+
+    RecordFileReader::~RecordFileReader() {
+        close();
+    }
+
+    bool RecordFileReader::open(const std::string & path) {
+        auto & data = getData();
+
+        close();
+
+        if (data.map(path) == false) {
+            fprintf(stderr, "Failed to map '%s'\n", path.c_str());
+            data.unmap();
+            return false;
+        }
+
+        bool isValid = data.mappingSize >= kHeaderSize + sizeof(uint64_t) + kFooterSize;
+        if (isValid) {
+            uint32_t magic = 0;
+            uint32_t version = 0;
+            std::memcpy(&magic, data.mapping, sizeof(magic));
+            std::memcpy(&version, data.mapping + sizeof(magic), sizeof(version));
+
+            const char * footer = data.mapping + data.mappingSize - kFooterSize;
+            data.nRecords = ::readU64(footer);
+            data.tableOffset = ::readU64(footer + sizeof(uint64_t));
+
+            uint32_t magicFooter = 0;
+            std::memcpy(&magicFooter, footer + 2*sizeof(uint64_t), sizeof(magicFooter));
+
+            const uint64_t maxRecords = (data.mappingSize - kHeaderSize - kFooterSize)/sizeof(uint64_t) - 1;
+
+            isValid =
+                magic == kMagic && magicFooter == kMagic && version == kVersion &&
+                data.nRecords <= maxRecords &&
+                data.tableOffset >= kHeaderSize &&
+                data.tableOffset + (data.nRecords + 1)*sizeof(uint64_t) + kFooterSize == data.mappingSize;
+        }
+
+        if (isValid == false) {
+            fprintf(stderr, "'%s' is not a valid record file\n", path.c_str());
+            data.unmap();
+            return false;
+        }
+
+        return true;
+    }
+
+    bool RecordFileReader::close() {
+        auto & data = getData();
+
+        if (data.mapping == nullptr) {
+            return false;
+        }
+
+        data.unmap();
+
+        return true;
+    }
+
+    bool RecordFileReader::isOpen() const {
+        return getData().mapping != nullptr;
+    }
+
+    size_t RecordFileReader::getNumRecords() const {
+        return (size_t) getData().nRecords;
+    }
+
+    BlobView RecordFileReader::getRecord(size_t idx) const {
+        auto & data = getData();
+
+        BlobView res;
+        if (idx >= data.nRecords) {
+            return res;
+        }
+
+        const char * table = data.mapping + data.tableOffset;
+        const uint64_t begin = ::readU64(table + idx*sizeof(uint64_t));
+        const uint64_t end = ::readU64(table + (idx + 1)*sizeof(uint64_t));
+
+        if (begin < kHeaderSize || begin > end || end > data.tableOffset) {
+            return res;
+        }
+
+        res.data = data.mapping + begin;
+        res.size = (size_t) (end - begin);
+
+        return res;
+    }
+}
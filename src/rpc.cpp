@@ -0,0 +1,312 @@
+#include "ggsock/rpc.h"
+
+#include "ggsock/timer-wheel.h"
+
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+    using TRequestId = ::GGSock::Rpc::TRequestId;
+    using TMethod = ::GGSock::Rpc::TMethod;
+    using TStatus = std::underlying_type<::GGSock::Rpc::Status>::type;
+
+    constexpr size_t kRequestHeaderSize = sizeof(TRequestId) + sizeof(TMethod);
+    constexpr size_t kResponseHeaderSize = sizeof(TRequestId) + sizeof(TStatus);
+}
+
+namespace GGSock {
+    struct Rpc::Data {
+
+        struct PendingCall {
+            CBResponse callback;
+            TimerWheel::TTimerId timerId = 0;
+            uint64_t connectionId = 0;
+        };
+
+        Data(Communicator & communicator, Communicator::TMessageType msgRequest, Communicator::TMessageType msgResponse) :
+            communicator(communicator), msgRequest(msgRequest), msgResponse(msgResponse) {}
+
+        bool sendResponse(TRequestId requestId, Status status, const char * dataBuffer, size_t dataSize) {
+            const TStatus statusValue = status;
+
+            auto frame = Communicator::beginFrame(kResponseHeaderSize + dataSize);
+            char * msg = frame.data() + Communicator::getFrameDataOffset();
+            std::memcpy(msg, &requestId, sizeof(requestId));
+            std::memcpy(msg + sizeof(requestId), &statusValue, sizeof(statusValue));
+            if (dataSize > 0) {
+                std::memcpy(msg + kResponseHeaderSize, dataBuffer, dataSize);
+            }
+
+            return communicator.commitFrame(msgResponse, std::move(frame));
+        }
+
+        void onRequest(const char * dataBuffer, size_t dataSize) {
+            if (dataSize < kRequestHeaderSize) {
+                return;
+            }
+
+            TRequestId requestId = 0;
+            TMethod method = 0;
+            std::memcpy(&requestId, dataBuffer, sizeof(requestId));
+            std::memcpy(&method, dataBuffer + sizeof(requestId), sizeof(method));
+
+            CBHandler handler;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto it = handlers.find(method);
+                if (it != handlers.end()) {
+                    handler = it->second;
+                }
+            }
+
+            if (handler == nullptr) {
+                sendResponse(requestId, ErrorUnknownMethod, nullptr, 0);
+                return;
+            }
+
+            SerializationBuffer response;
+            Status status = handler(requestId, dataBuffer + kRequestHeaderSize, dataSize - kRequestHeaderSize, response);
+            if (status == Pending) {
+                return;
+            }
+
+            sendResponse(requestId, status, response.data(), response.size());
+        }
+
+        void onResponse(const char * dataBuffer, size_t dataSize) {
+            if (dataSize < kResponseHeaderSize) {
+                return;
+            }
+
+            TRequestId requestId = 0;
+            TStatus status = 0;
+            std::memcpy(&requestId, dataBuffer, sizeof(requestId));
+            std::memcpy(&status, dataBuffer + sizeof(requestId), sizeof(status));
+
+            CBResponse callback;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto it = pendingCalls.find(requestId);
+                if (it == pendingCalls.end()) {
+                    // cancelled or timed out
+                    return;
+                }
+                callback = std::move(it->second.callback);
+                erasePendingCall(it);
+            }
+
+            if (callback) {
+                callback((Status) status, dataBuffer + kResponseHeaderSize, dataSize - kResponseHeaderSize);
+            }
+        }
+
+        void erasePendingCall(std::unordered_map<TRequestId, PendingCall>::iterator it) {
+            if (it->second.timerId != 0) {
+                deadlines.cancel(it->second.timerId);
+            }
+            pendingCalls.erase(it);
+        }
+
+        void onDeadline(TRequestId requestId) {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            auto it = pendingCalls.find(requestId);
+            if (it == pendingCalls.end()) {
+                return;
+            }
+
+            it->second.timerId = 0;
+            expired.emplace_back(std::move(it->second.callback));
+            pendingCalls.erase(it);
+        }
+
+        Communicator & communicator;
+
+        const Communicator::TMessageType msgRequest;
+        const Communicator::TMessageType msgResponse;
+
+        TRequestId lastRequestId = 0;
+
+        std::unordered_map<TRequestId, PendingCall> pendingCalls;
+        TimerWheel deadlines;
+        std::vector<CBResponse> expired;
+
+        std::map<TMethod, CBHandler> handlers;
+
+        mutable std::mutex mutex;
+    };
+
+    Rpc::Rpc(Communicator & communicator, Communicator::TMessageType msgRequest, Communicator::TMessageType msgResponse) :
+        data_(new Data(communicator, msgRequest, msgResponse)) {
+        auto & data = getData();
+
+        communicator.setMessageCallback(msgRequest, [&data](const char * dataBuffer, Communicator::TBufferSize dataSize) {
+            data.onRequest(dataBuffer, dataSize);
+            return 0;
+        });
+
+        communicator.setMessageCallback(msgResponse, [&data](const char * dataBuffer, Communicator::TBufferSize dataSize) {
+            data.onResponse(dataBuffer, dataSize);
+            return 0;
+        });
+    }
+
+    Rpc::~Rpc() {
+        auto & data = getData();
+
+        data.communicator.removeMessageCallback(data.msgRequest);
+        data.communicator.removeMessageCallback(data.msgResponse);
+    }
+
+    bool Rpc::update() {
+        auto & data = getData();
+
+        data.deadlines.update();
+
+        // the connection id is read after isConnected, so a call made on a new connection is never failed
+        const bool isConnected = data.communicator.isConnected();
+        const uint64_t connectionId = data.communicator.getConnectionId();
+
+        std::vector<CBResponse> expired;
+        std::vector<CBResponse> disconnected;
+        {
+            std::lock_guard<std::mutex> lock(data.mutex);
+            expired.swap(data.expired);
+
+            for (auto it = data.pendingCalls.begin(); it != data.pendingCalls.end(); ) {
+                if (isConnected && it->second.connectionId == connectionId) {
+                    ++it;
+                    continue;
+                }
+
+                disconnected.emplace_back(std::move(it->second.callback));
+                if (it->second.timerId != 0) {
+                    data.deadlines.cancel(it->second.timerId);
+                }
+                it = data.pendingCalls.erase(it);
+            }
+        }
+
+        for (auto & callback : expired) {
+            if (callback) {
+                callback(ErrorTimeout, nullptr, 0);
+            }
+        }
+
+        for (auto & callback : disconnected) {
+            if (callback) {
+                callback(ErrorDisconnected, nullptr, 0);
+            }
+        }
+
+        return true;
+    }
+
+    Rpc::TRequestId Rpc::call(TMethod method, const char * dataBuffer, size_t dataSize, int32_t timeout_ms, CBResponse && callback) {
+        auto & data = getData();
+
+        TRequestId requestId = 0;
+        {
+            std::lock_guard<std::mutex> lock(data.mutex);
+
+            // 0 is never used as a request id
+            do {
+                requestId = ++data.lastRequestId;
+            } while (requestId == 0 || data.pendingCalls.count(requestId) > 0);
+
+            auto & pending = data.pendingCalls[requestId];
+            pending.callback = std::move(callback);
+            pending.connectionId = data.communicator.getConnectionId();
+            if (timeout_ms > 0) {
+                pending.timerId = data.deadlines.schedule(timeout_ms, [&data, requestId]() { data.onDeadline(requestId); });
+            }
+        }
+
+        auto frame = Communicator::beginFrame(kRequestHeaderSize + dataSize);
+        char * msg = frame.data() + Communicator::getFrameDataOffset();
+        std::memcpy(msg, &requestId, sizeof(requestId));
+        std::memcpy(msg + sizeof(requestId), &method, sizeof(method));
+        if (dataSize > 0) {
+            std::memcpy(msg + kRequestHeaderSize, dataBuffer, dataSize);
+        }
+
+        if (data.communicator.commitFrame(data.msgRequest, std::move(frame)) == false) {
+            CBResponse failed;
+            {
+                std::lock_guard<std::mutex> lock(data.mutex);
+                auto it = data.pendingCalls.find(requestId);
+                if (it != data.pendingCalls.end()) {
+                    failed = std::move(it->second.callback);
+                    data.erasePendingCall(it);
+                }
+            }
+            if (failed) {
+                failed(ErrorSendFailed, nullptr, 0);
+            }
+        }
+
+        return requestId;
+    }
+
+    std::future<Rpc::Response> Rpc::call(TMethod method, const char * dataBuffer, size_t dataSize, int32_t timeout_ms) {
+        auto promise = std::make_shared<std::promise<Response>>();
+        auto result = promise->get_future();
+
+        call(method, dataBuffer, dataSize, timeout_ms, [promise](Status status, const char * dataBuffer, size_t dataSize) {
+            Response response;
+            response.status = status;
+            response.data.assign(dataBuffer, dataBuffer + dataSize);
+            promise->set_value(std::move(response));
+        });
+
+        return result;
+    }
+
+    bool Rpc::cancel(TRequestId requestId) {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+
+        auto it = data.pendingCalls.find(requestId);
+        if (it == data.pendingCalls.end()) {
+            return false;
+        }
+
+        data.erasePendingCall(it);
+
+        return true;
+    }
+
+    int32_t Rpc::getNumPendingCalls() const {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+
+        return (int32_t) data.pendingCalls.size();
+    }
+
+    bool Rpc::setHandler(TMethod method, CBHandler && handler) {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+
+        data.handlers[method] = std::move(handler);
+
+        return true;
+    }
+
+    bool Rpc::removeHandler(TMethod method) {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+
+        return data.handlers.erase(method) > 0;
+    }
+
+    bool Rpc::respond(TRequestId requestId, Status status, const char * dataBuffer, size_t dataSize) {
+        return getData().sendResponse(requestId, status, dataBuffer, dataSize);
+    }
+}
@@ -2,7 +2,9 @@
 
 #include <string>
 #include <memory>
+#include <algorithm>
 #include <cstring>
+#include <limits>
 
 namespace {
     template <typename Operator>
@@ -11,6 +13,35 @@ namespace {
             op.nBytesProcessed += amount;
         }
 
+    constexpr size_t kMaxPushBackSize = 16;
+
+    // writes at offset - bytes past the end are appended, so a reserved buffer is filled without zeroing it first
+    inline void write_bytes(const char * src, size_t n, GGSock::SerializationBuffer & buffer, size_t offset) {
+        if (offset == buffer.size()) {
+            // push_back is inlined, while the range insert has a fixed cost that dominates short writes
+            if (n <= kMaxPushBackSize) {
+                for (size_t i = 0; i < n; ++i) {
+                    buffer.push_back(src[i]);
+                }
+            } else {
+                buffer.insert(buffer.end(), src, src + n);
+            }
+            return;
+        }
+
+        if (offset > buffer.size()) {
+            buffer.resize(offset);
+        }
+
+        const size_t nOverwrite = (std::min)(n, buffer.size() - offset);
+        if (nOverwrite > 0) {
+            std::memcpy(buffer.data() + offset, src, nOverwrite);
+        }
+        if (n > nOverwrite) {
+            buffer.insert(buffer.end(), src + nOverwrite, src + n);
+        }
+    }
+
     // type - fundamental
 
     template <typename T>
@@ -19,16 +50,19 @@ namespace {
 
             auto osize = sizeof(obj);
 
-            if (offset + osize > buffer.size()) {
-                buffer.resize(offset + osize);
-            }
-
-            std::memcpy(buffer.data() + offset, &obj, osize);
+            ::write_bytes(reinterpret_cast<const char *>(&obj), osize, buffer, offset);
             ::advance(offset, osize, op);
 
             return true;
         }
 
+    template <typename T>
+        inline size_t serialized_size_fundamental(const T & obj, GGSock::SerializedSize & ) noexcept {
+            static_assert(std::is_fundamental<T>::value, "Fundamental type required");
+
+            return sizeof(obj);
+        }
+
     template <typename T>
         inline bool unserialize_fundamental(T & obj, const char * bufferData, size_t bufferSize, size_t & offset, GGSock::Unserialize & op) noexcept {
             static_assert(std::is_fundamental<T>::value, "Fundamental type required");
@@ -43,26 +77,125 @@ namespace {
             return true;
         }
 
+    // type - integer, fixed width or LEB128 varint with zigzag for signed types
+
+    template <typename T>
+        inline uint64_t to_varint(T v, std::true_type) noexcept {
+            return ((uint64_t) (int64_t) v << 1) ^ (uint64_t) ((int64_t) v >> 63);
+        }
+
+    template <typename T>
+        inline uint64_t to_varint(T v, std::false_type) noexcept {
+            return v;
+        }
+
+    template <typename T>
+        inline bool from_varint(uint64_t v, T & obj, std::true_type) noexcept {
+            const int64_t s = (int64_t) (v >> 1) ^ -(int64_t) (v & 1);
+            if (s < (int64_t) std::numeric_limits<T>::min() || s > (int64_t) std::numeric_limits<T>::max()) return false;
+
+            obj = (T) s;
+            return true;
+        }
+
+    template <typename T>
+        inline bool from_varint(uint64_t v, T & obj, std::false_type) noexcept {
+            if (v > (uint64_t) std::numeric_limits<T>::max()) return false;
+
+            obj = (T) v;
+            return true;
+        }
+
+    constexpr size_t kMaxVarintSize = 10;
+
+    inline size_t varint_size(uint64_t v) noexcept {
+        size_t n = 1;
+        while (v >= 0x80) {
+            v >>= 7;
+            ++n;
+        }
+        return n;
+    }
+
+    inline char * encode_varint(uint64_t v, char * p) noexcept {
+        while (v >= 0x80) {
+            *p++ = (char) (v | 0x80);
+            v >>= 7;
+        }
+        *p++ = (char) v;
+        return p;
+    }
+
+    inline bool decode_varint(const uint8_t * & p, const uint8_t * end, uint64_t & v) noexcept {
+        v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (p == end) return false;
+
+            const uint8_t b = *p++;
+            v |= (uint64_t) (b & 0x7F) << shift;
+            if ((b & 0x80) == 0) return true;
+        }
+        return false;
+    }
+
+    template <typename T>
+        inline bool serialize_integer(const T & obj, GGSock::SerializationBuffer & buffer, size_t & offset, GGSock::Serialize & op) noexcept {
+            if (op.encoding == GGSock::Encoding::Fixed) {
+                return serialize_fundamental(obj, buffer, offset, op);
+            }
+
+            char encoded[kMaxVarintSize];
+            const size_t osize = encode_varint(to_varint(obj, std::is_signed<T>()), encoded) - encoded;
+
+            ::write_bytes(encoded, osize, buffer, offset);
+            ::advance(offset, osize, op);
+
+            return true;
+        }
+
+    template <typename T>
+        inline size_t serialized_size_integer(const T & obj, GGSock::SerializedSize & op) noexcept {
+            if (op.encoding == GGSock::Encoding::Fixed) {
+                return sizeof(obj);
+            }
+
+            return varint_size(to_varint(obj, std::is_signed<T>()));
+        }
+
+    template <typename T>
+        inline bool unserialize_integer(T & obj, const char * bufferData, size_t bufferSize, size_t & offset, GGSock::Unserialize & op) noexcept {
+            if (op.encoding == GGSock::Encoding::Fixed) {
+                return unserialize_fundamental(obj, bufferData, bufferSize, offset, op);
+            }
+
+            const uint8_t * begin = reinterpret_cast<const uint8_t *>(bufferData) + offset;
+            const uint8_t * p = begin;
+
+            uint64_t v = 0;
+            if (offset > bufferSize || decode_varint(p, reinterpret_cast<const uint8_t *>(bufferData) + bufferSize, v) == false) return false;
+            if (from_varint(v, obj, std::is_signed<T>()) == false) return false;
+
+            ::advance(offset, p - begin, op);
+
+            return true;
+        }
+
     // type - vector
 
     template <typename T>
-        inline bool serialize_vector(const T * objs, int32_t n, GGSock::SerializationBuffer & buffer, size_t & offset, GGSock::Serialize & op) noexcept {
+        inline bool serialize_vector(const T * objs, size_t n, GGSock::SerializationBuffer & buffer, size_t & offset, GGSock::Serialize & op) noexcept {
             static_assert(std::is_fundamental<T>::value, "Fundamental type required");
 
             auto osize = sizeof(T)*n;
 
-            if (offset + osize > buffer.size()) {
-                buffer.resize(offset + osize);
-            }
-
-            std::memcpy(buffer.data() + offset, objs, osize);
+            ::write_bytes(reinterpret_cast<const char *>(objs), osize, buffer, offset);
             ::advance(offset, osize, op);
 
             return true;
         }
 
     template <typename T>
-        inline bool unserialize_vector(T * objs, int32_t n, const char * bufferData, size_t bufferSize, size_t & offset, GGSock::Unserialize & op) noexcept {
+        inline bool unserialize_vector(T * objs, size_t n, const char * bufferData, size_t bufferSize, size_t & offset, GGSock::Unserialize & op) noexcept {
             static_assert(std::is_fundamental<T>::value, "Fundamental type required");
 
             auto osize = sizeof(T)*n;
@@ -79,6 +212,35 @@ namespace {
 
             return true;
         }
+
+    // type - string
+
+    template <typename TString>
+        inline bool serialize_string(const TString & t, GGSock::SerializationBuffer & buffer, size_t & offset, GGSock::Serialize & op) noexcept {
+            bool res = true;
+
+            int32_t n = (int32_t) t.size();
+            res &= op(n, buffer, offset);
+            res &= ::serialize_vector(t.data(), n, buffer, offset, op);
+
+            return res;
+        }
+
+    template <typename TString>
+        inline size_t serialized_size_string(const TString & t, GGSock::SerializedSize & op) noexcept {
+            return op((int32_t) t.size()) + t.size();
+        }
+
+    template <typename TString>
+        inline bool unserialize_string(TString & t, const char * bufferData, size_t bufferSize, size_t & offset, GGSock::Unserialize & op) {
+            int32_t n = 0;
+            if (op(n, bufferData, bufferSize, offset) == false) return false;
+            if (op.checkLength(n, 1, 1, bufferSize, offset) == false) return false;
+
+            t.resize(n);
+
+            return ::unserialize_vector(&t[0], n, bufferData, bufferSize, offset, op);
+        }
 }
 
 #define ADD_HELPER(T, type)                                                                                 \
@@ -88,53 +250,183 @@ namespace {
     }                                                                                                       \
                                                                                                             \
     template <>                                                                                             \
+    size_t SerializedSize::operator()<T>(const T & obj) {                                                   \
+        return ::serialized_size_##type(obj, *this);                                                        \
+    }                                                                                                       \
+                                                                                                            \
+    template <>                                                                                             \
     bool Unserialize::operator()<T>(T & obj, const char * bufferData, size_t bufferSize, size_t & offset) { \
         return ::unserialize_##type(obj, bufferData, bufferSize, offset, *this);                            \
     }
 
 namespace GGSock {
 
+// raw bytes
+
+bool Serialize::serializeBytes(const void * src, size_t nBytes, SerializationBuffer & buffer, size_t & offset) {
+    return ::serialize_vector(reinterpret_cast<const char *>(src), nBytes, buffer, offset, *this);
+}
+
+bool Unserialize::unserializeBytes(void * dst, size_t nBytes, const char * bufferData, size_t bufferSize, size_t & offset) {
+    return ::unserialize_vector(reinterpret_cast<char *>(dst), nBytes, bufferData, bufferSize, offset, *this);
+}
+
+// length prefixes
+
+bool Unserialize::checkLength(int32_t n, size_t minSize_bytes, size_t allocSize_bytes, size_t bufferSize, size_t offset) {
+    if (n < 0 || offset > bufferSize) return false;
+
+    // rejected in O(1), before anything is allocated
+    if ((uint64_t) n*minSize_bytes > bufferSize - offset) return false;
+
+    nBytesAllocated += (uint64_t) n*allocSize_bytes;
+    if (maxBytesAllocated > 0 && nBytesAllocated > maxBytesAllocated) return false;
+
+    return true;
+}
+
+// varint-encoded arrays of integers
+
+template <typename T> bool Serialize::serializeVarints(const T * objs, size_t n, SerializationBuffer & buffer, size_t & offset) {
+    // encoded in chunks on the stack, then written with one copy per chunk
+    char chunk[64*kMaxVarintSize];
+
+    size_t i = 0;
+    while (i < n) {
+        char * p = chunk;
+        for (const size_t iEnd = (std::min)(n, i + 64); i < iEnd; ++i) {
+            p = ::encode_varint(::to_varint(objs[i], std::is_signed<T>()), p);
+        }
+
+        ::write_bytes(chunk, p - chunk, buffer, offset);
+        ::advance(offset, p - chunk, *this);
+    }
+
+    return true;
+}
+
+template <typename T> size_t SerializedSize::sizeOfVarints(const T * objs, size_t n) {
+    size_t res = 0;
+    for (size_t i = 0; i < n; ++i) {
+        res += ::varint_size(::to_varint(objs[i], std::is_signed<T>()));
+    }
+
+    return res;
+}
+
+template <typename T> bool Unserialize::unserializeVarints(T * objs, size_t n, const char * bufferData, size_t bufferSize, size_t & offset) {
+    if (offset > bufferSize) return false;
+
+    const uint8_t * begin = reinterpret_cast<const uint8_t *>(bufferData) + offset;
+    const uint8_t * end = reinterpret_cast<const uint8_t *>(bufferData) + bufferSize;
+    const uint8_t * p = begin;
+
+    size_t i = 0;
+    while (i < n) {
+        // small values take a single byte - decode 8 of them at once when none has the continuation bit set
+        if (n - i >= 8 && end - p >= 8) {
+            uint64_t word;
+            std::memcpy(&word, p, sizeof(word));
+            if ((word & 0x8080808080808080ull) == 0) {
+                for (int k = 0; k < 8; ++k) {
+                    ::from_varint(p[k], objs[i + k], std::is_signed<T>());
+                }
+                p += 8;
+                i += 8;
+                continue;
+            }
+        }
+
+        uint64_t v = 0;
+        if (::decode_varint(p, end, v) == false) return false;
+        if (::from_varint(v, objs[i], std::is_signed<T>()) == false) return false;
+        ++i;
+    }
+    ::advance(offset, p - begin, *this);
+
+    return true;
+}
+
+#define ADD_VARINT_HELPER(T)                                                                                                    \
+    template bool Serialize::serializeVarints<T>(const T * objs, size_t n, SerializationBuffer & buffer, size_t & offset);       \
+    template size_t SerializedSize::sizeOfVarints<T>(const T * objs, size_t n);                                                 \
+    template bool Unserialize::unserializeVarints<T>(T * objs, size_t n, const char * bufferData, size_t bufferSize, size_t & offset);
+
+ADD_VARINT_HELPER(int16_t)
+ADD_VARINT_HELPER(int32_t)
+ADD_VARINT_HELPER(int64_t)
+ADD_VARINT_HELPER(uint16_t)
+ADD_VARINT_HELPER(uint32_t)
+ADD_VARINT_HELPER(uint64_t)
+
 // fundamental
 
 ADD_HELPER(bool,        fundamental)
 ADD_HELPER(char,        fundamental)
 
 ADD_HELPER(int8_t,      fundamental)
-ADD_HELPER(int16_t,     fundamental)
-ADD_HELPER(int32_t,     fundamental)
-ADD_HELPER(int64_t,     fundamental)
+ADD_HELPER(int16_t,     integer)
+ADD_HELPER(int32_t,     integer)
+ADD_HELPER(int64_t,     integer)
 
 ADD_HELPER(uint8_t,     fundamental)
-ADD_HELPER(uint16_t,    fundamental)
-ADD_HELPER(uint32_t,    fundamental)
-ADD_HELPER(uint64_t,    fundamental)
+ADD_HELPER(uint16_t,    integer)
+ADD_HELPER(uint32_t,    integer)
+ADD_HELPER(uint64_t,    integer)
 
 ADD_HELPER(float,       fundamental)
 ADD_HELPER(double,      fundamental)
 
-// std::string
+// strings
+
+ADD_HELPER(std::string, string)
+ADD_HELPER(ArenaString, string)
+
+// BlobView, StringView
 
-template <> bool Serialize::operator()<std::string>(const std::string & t, SerializationBuffer & buffer, size_t & offset) {
+template <> bool Serialize::operator()<BlobView>(const BlobView & t, SerializationBuffer & buffer, size_t & offset) {
     bool res = true;
 
-    int32_t n = (int32_t) t.size();
+    int32_t n = (int32_t) t.size;
     res &= operator()(n, buffer, offset);
-    res &= ::serialize_vector(t.data(), n, buffer, offset, *this);
+    res &= ::serialize_vector(t.data, t.size, buffer, offset, *this);
 
     return res;
 }
 
-template <> bool Unserialize::operator()<std::string>(std::string & t, const char * bufferData, size_t bufferSize, size_t & offset) {
-    bool res = true;
+template <> size_t SerializedSize::operator()<BlobView>(const BlobView & t) {
+    return operator()((int32_t) t.size) + t.size;
+}
 
+template <> bool Unserialize::operator()<BlobView>(BlobView & t, const char * bufferData, size_t bufferSize, size_t & offset) {
     int32_t n = 0;
-    res &= operator()(n, bufferData, bufferSize, offset);
+    if (operator()(n, bufferData, bufferSize, offset) == false) {
+        return false;
+    }
+
+    if (checkLength(n, 1, 0, bufferSize, offset) == false) {
+        return false;
+    }
 
-    t.resize(n);
-    res &= ::unserialize_vector(&t[0], n, bufferData, bufferSize, offset, *this);
+    t.data = bufferData + offset;
+    t.size = n;
 
-    return res;
+    offset += n;
+    nBytesProcessed += n;
+
+    return true;
+}
+
+template <> bool Serialize::operator()<StringView>(const StringView & t, SerializationBuffer & buffer, size_t & offset) {
+    return operator()<BlobView>(t, buffer, offset);
+}
+
+template <> size_t SerializedSize::operator()<StringView>(const StringView & t) {
+    return operator()<BlobView>(t);
 }
 
+template <> bool Unserialize::operator()<StringView>(StringView & t, const char * bufferData, size_t bufferSize, size_t & offset) {
+    return operator()<BlobView>(t, bufferData, bufferSize, offset);
+}
 
 }
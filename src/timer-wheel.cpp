@@ -0,0 +1,318 @@
+#include "ggsock/timer-wheel.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+namespace {
+    constexpr int kSlotBits = 8;
+    constexpr int kNumSlots = 1 << kSlotBits;
+    constexpr int kNumLevels = 4;
+
+    constexpr uint64_t kMaxDelay_ticks = ((uint64_t) 1 << (kSlotBits*kNumLevels)) - 1;
+
+    constexpr uint32_t kInvalid = UINT32_MAX;
+}
+
+namespace GGSock {
+    struct TimerWheel::Data {
+        using TClock = std::chrono::steady_clock;
+
+        // timers live in a pool of nodes, linked into the slots of the wheel
+        // the id carries the node index and a generation, so stale ids of reused nodes are rejected
+        struct Node {
+            uint32_t generation = 0;
+            uint32_t prev = kInvalid;
+            uint32_t next = kInvalid;
+            int32_t level = -1;
+            int32_t slot = -1;
+            uint64_t tExpire_ticks = 0;
+            CBTimer callback;
+        };
+
+        Data(int32_t tickResolution_ms) :
+            tickResolution_ms(tickResolution_ms > 0 ? tickResolution_ms : 1),
+            tStart(TClock::now()) {
+            for (auto & level : slots) {
+                level.fill(kInvalid);
+            }
+        }
+
+        uint64_t getTicks(TClock::time_point t) const {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(t - tStart).count()/tickResolution_ms;
+        }
+
+        // relative to the current time, not to the last update(), which may lag behind
+        uint64_t getExpireTicks(uint64_t delay_ticks) const {
+            uint64_t tNow_ticks = (std::max)(tCur_ticks, getTicks(TClock::now()));
+            uint64_t tMax_ticks = tCur_ticks + kMaxDelay_ticks;
+
+            return (std::min)(tNow_ticks + delay_ticks, tMax_ticks);
+        }
+
+        static TTimerId makeId(uint32_t index, uint32_t generation) {
+            return ((TTimerId) generation << 32) | index;
+        }
+
+        Node * getNode(TTimerId id) {
+            uint32_t index = (uint32_t) id;
+            uint32_t generation = (uint32_t) (id >> 32);
+            if (index >= nodes.size() || nodes[index].generation != generation || nodes[index].level < 0) {
+                return nullptr;
+            }
+
+            return &nodes[index];
+        }
+
+        void link(uint32_t index) {
+            auto & node = nodes[index];
+
+            uint64_t delta = node.tExpire_ticks > tCur_ticks ? node.tExpire_ticks - tCur_ticks : 0;
+
+            int level = 0;
+            while (level + 1 < kNumLevels && delta >= ((uint64_t) 1 << (kSlotBits*(level + 1)))) {
+                ++level;
+            }
+
+            // expired timers go to the slot processed on the next tick
+            uint64_t t = delta == 0 ? tCur_ticks + 1 : node.tExpire_ticks;
+
+            node.level = level;
+            node.slot = (int32_t) ((t >> (kSlotBits*level)) & (kNumSlots - 1));
+            node.prev = kInvalid;
+            node.next = slots[level][node.slot];
+            if (node.next != kInvalid) {
+                nodes[node.next].prev = index;
+            }
+            slots[level][node.slot] = index;
+        }
+
+        void unlink(uint32_t index) {
+            auto & node = nodes[index];
+
+            if (node.prev != kInvalid) {
+                nodes[node.prev].next = node.next;
+            } else {
+                slots[node.level][node.slot] = node.next;
+            }
+            if (node.next != kInvalid) {
+                nodes[node.next].prev = node.prev;
+            }
+
+            node.level = -1;
+            node.slot = -1;
+            node.prev = kInvalid;
+            node.next = kInvalid;
+        }
+
+        void free(uint32_t index) {
+            auto & node = nodes[index];
+            node.callback = nullptr;
+            ++node.generation;
+            freeNodes.push_back(index);
+            --nTimers;
+        }
+
+        // move the timers of the current slot of a higher level down to the lower levels
+        void cascade(int level) {
+            if (level >= kNumLevels) {
+                return;
+            }
+
+            const int32_t slot = (int32_t) ((tCur_ticks >> (kSlotBits*level)) & (kNumSlots - 1));
+            if (slot == 0) {
+                cascade(level + 1);
+            }
+
+            uint32_t index = slots[level][slot];
+            slots[level][slot] = kInvalid;
+            while (index != kInvalid) {
+                uint32_t next = nodes[index].next;
+                link(index);
+                index = next;
+            }
+        }
+
+        // the earliest deadline is in the first non-empty slot after the current one of some level
+        // lower levels do not always expire first, since higher levels are cascaded only at slot boundaries
+        uint64_t getNextExpireTicks() const {
+            uint64_t tNext_ticks = UINT64_MAX;
+            for (int level = 0; level < kNumLevels; ++level) {
+                const uint64_t slotCur = tCur_ticks >> (kSlotBits*level);
+                for (int i = 1; i <= kNumSlots; ++i) {
+                    uint32_t index = slots[level][(slotCur + i) & (kNumSlots - 1)];
+                    if (index == kInvalid) {
+                        continue;
+                    }
+
+                    while (index != kInvalid) {
+                        tNext_ticks = (std::min)(tNext_ticks, nodes[index].tExpire_ticks);
+                        index = nodes[index].next;
+                    }
+                    break;
+                }
+            }
+
+            return (std::max)(tNext_ticks, tCur_ticks + 1);
+        }
+
+        void advance(uint64_t tTarget_ticks, std::vector<CBTimer> & expired) {
+            while (tCur_ticks < tTarget_ticks) {
+                if (nTimers == 0) {
+                    tCur_ticks = tTarget_ticks;
+                    break;
+                }
+
+                ++tCur_ticks;
+
+                if ((tCur_ticks & (kNumSlots - 1)) == 0) {
+                    cascade(1);
+                }
+
+                const int32_t slot = (int32_t) (tCur_ticks & (kNumSlots - 1));
+
+                uint32_t index = slots[0][slot];
+                slots[0][slot] = kInvalid;
+                while (index != kInvalid) {
+                    uint32_t next = nodes[index].next;
+                    if (nodes[index].tExpire_ticks <= tCur_ticks) {
+                        nodes[index].level = -1;
+                        expired.emplace_back(std::move(nodes[index].callback));
+                        free(index);
+                    } else {
+                        link(index);
+                    }
+                    index = next;
+                }
+            }
+        }
+
+        const int32_t tickResolution_ms;
+        const TClock::time_point tStart;
+
+        uint64_t tCur_ticks = 0;
+        int32_t nTimers = 0;
+
+        std::vector<Node> nodes;
+        std::vector<uint32_t> freeNodes;
+        std::array<std::array<uint32_t, kNumSlots>, kNumLevels> slots;
+
+        mutable std::mutex mutex;
+    };
+
+    TimerWheel::TimerWheel(int32_t tickResolution_ms) : data_(new Data(tickResolution_ms)) {
+    }
+
+    TimerWheel::~TimerWheel() {
+    }
+
+    int32_t TimerWheel::update() {
+        auto & data = getData();
+
+        std::vector<CBTimer> expired;
+        {
+            std::lock_guard<std::mutex> lock(data.mutex);
+            data.advance(data.getTicks(Data::TClock::now()), expired);
+        }
+
+        for (auto & callback : expired) {
+            if (callback) {
+                callback();
+            }
+        }
+
+        return (int32_t) expired.size();
+    }
+
+    TimerWheel::TTimerId TimerWheel::schedule(int32_t delay_ms, CBTimer && callback) {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+
+        uint32_t index = 0;
+        if (data.freeNodes.empty() == false) {
+            index = data.freeNodes.back();
+            data.freeNodes.pop_back();
+        } else {
+            if (data.nodes.size() >= kInvalid) {
+                return 0;
+            }
+            index = (uint32_t) data.nodes.size();
+            data.nodes.emplace_back();
+        }
+
+        uint64_t delay_ticks = ((uint64_t) (delay_ms > 0 ? delay_ms : 0) + data.tickResolution_ms - 1)/data.tickResolution_ms;
+
+        // generation 0 is never used, so 0 is never a valid id
+        auto & node = data.nodes[index];
+        if (node.generation == 0) {
+            node.generation = 1;
+        }
+        node.callback = std::move(callback);
+        node.tExpire_ticks = data.getExpireTicks(delay_ticks);
+        data.link(index);
+
+        ++data.nTimers;
+
+        return Data::makeId(index, node.generation);
+    }
+
+    bool TimerWheel::reschedule(TTimerId id, int32_t delay_ms) {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+
+        auto node = data.getNode(id);
+        if (node == nullptr) {
+            return false;
+        }
+
+        uint64_t delay_ticks = ((uint64_t) (delay_ms > 0 ? delay_ms : 0) + data.tickResolution_ms - 1)/data.tickResolution_ms;
+
+        data.unlink((uint32_t) id);
+        node->tExpire_ticks = data.getExpireTicks(delay_ticks);
+        data.link((uint32_t) id);
+
+        return true;
+    }
+
+    bool TimerWheel::cancel(TTimerId id) {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+
+        if (data.getNode(id) == nullptr) {
+            return false;
+        }
+
+        data.unlink((uint32_t) id);
+        data.free((uint32_t) id);
+
+        return true;
+    }
+
+    int32_t TimerWheel::getNumTimers() const {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+
+        return data.nTimers;
+    }
+
+    int32_t TimerWheel::getTimeToNext_ms() const {
+        auto & data = getData();
+
+        std::lock_guard<std::mutex> lock(data.mutex);
+
+        if (data.nTimers == 0) {
+            return -1;
+        }
+
+        const int64_t tNext_ms = (int64_t) data.getNextExpireTicks()*data.tickResolution_ms;
+        const int64_t tNow_ms = std::chrono::duration_cast<std::chrono::milliseconds>(Data::TClock::now() - data.tStart).count();
+
+        return (int32_t) (std::min)((std::max)(tNext_ms - tNow_ms, (int64_t) 0), (int64_t) INT32_MAX);
+    }
+}
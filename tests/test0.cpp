@@ -75,6 +75,52 @@ int main() {
         if (client.disconnect() == false) return 18;
     }
 
+    {
+        GGSock::Communicator::WorkerParameters workerParameters;
+        workerParameters.mode = GGSock::Communicator::WorkerMode::BusyPoll;
+
+        GGSock::Communicator server(true, workerParameters);
+        server.setFrameChecksum(true);
+        server.setMessageCallback(42, [&](const char * , size_t ) {
+            server.send(43);
+            return true;
+        });
+
+        server.listen(12345, 0);
+
+        int nAcks = 0;
+        GGSock::Communicator client(true, workerParameters);
+        client.setFrameChecksum(true);
+        client.setMessageCallback(43, [&](const char * , size_t ) {
+            ++nAcks;
+            return true;
+        });
+
+        if (client.connect("127.0.0.1", 12345, 100) == false) return 19;
+
+        while (client.isConnected() == false) {}
+        while (server.isConnected() == false) {}
+
+        char buf[16];
+
+        for (int i = 0; i < 3; ++i) {
+            if (client.send(42, buf, 16) == false) return 20;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        auto stats = server.getStats();
+        printf("Busy-poll stats: received = %d, spins = %d, idle waits = %d, spin ratio = %g, budget = %d us\n",
+               (int) stats.nMessagesReceived, (int) stats.nSpins, (int) stats.nIdleWaits, stats.getSpinRatio(), stats.spinBudget_us);
+
+        if (nAcks != 3) return 21;
+        if (stats.nMessagesReceived != 3) return 22;
+        if (stats.nSpins == 0 || stats.nIdleWaits == 0) return 23;
+        if (stats.nChecksumErrors != 0 || client.getStats().nChecksumErrors != 0) return 24;
+
+        if (client.disconnect() == false) return 25;
+    }
+
     printf("Done!\n");
 
     return 0;
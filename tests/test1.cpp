@@ -0,0 +1,110 @@
+#include "ggsock/communicator.h"
+#include "ggsock/rpc.h"
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+int main() {
+    GGSock::Communicator server(true);
+    GGSock::Communicator client(true);
+
+    GGSock::Rpc rpcServer(server);
+    GGSock::Rpc rpcClient(client);
+
+    enum Method : GGSock::Rpc::TMethod {
+        MethodEcho = 1,
+        MethodSquare,
+        MethodDeferred,
+        MethodNoReply,
+    };
+
+    rpcServer.setHandler(MethodEcho, [](GGSock::Rpc::TRequestId, const char * dataBuffer, size_t dataSize, GGSock::SerializationBuffer & response) {
+        response.assign(dataBuffer, dataBuffer + dataSize);
+        return GGSock::Rpc::Ok;
+    });
+
+    rpcServer.setHandler(MethodSquare, [](GGSock::Rpc::TRequestId, const char * dataBuffer, size_t dataSize, GGSock::SerializationBuffer & response) {
+        int32_t x = 0;
+        size_t offset = 0;
+        if (GGSock::Unserialize()(x, dataBuffer, dataSize, offset) == false) return GGSock::Rpc::ErrorHandler;
+        GGSock::Serialize()(x*x, response);
+        return GGSock::Rpc::Ok;
+    });
+
+    // respond out of order, after the other calls have completed
+    std::mutex mutexDeferred;
+    std::vector<GGSock::Rpc::TRequestId> deferred;
+    rpcServer.setHandler(MethodDeferred, [&](GGSock::Rpc::TRequestId requestId, const char * , size_t , GGSock::SerializationBuffer & ) {
+        std::lock_guard<std::mutex> lock(mutexDeferred);
+        deferred.push_back(requestId);
+        return GGSock::Rpc::Pending;
+    });
+
+    rpcServer.setHandler(MethodNoReply, [](GGSock::Rpc::TRequestId, const char * , size_t , GGSock::SerializationBuffer & ) {
+        return GGSock::Rpc::Pending;
+    });
+
+    if (server.listen(12346, 0) == false) return 1;
+    if (client.connect("127.0.0.1", 12346, 100) == false) return 2;
+
+    while (client.isConnected() == false) {}
+    while (server.isConnected() == false) {}
+
+    auto fDeferred = rpcClient.call(MethodDeferred, nullptr, 0, 0);
+    auto fTimeout = rpcClient.call(MethodNoReply, nullptr, 0, 50);
+    auto fUnknown = rpcClient.call(42, nullptr, 0, 1000);
+
+    std::vector<std::future<GGSock::Rpc::Response>> fSquares;
+    for (int32_t i = 0; i < 64; ++i) {
+        fSquares.push_back(rpcClient.call(MethodSquare, i, 1000));
+    }
+
+    for (int32_t i = 0; i < 64; ++i) {
+        auto response = fSquares[i].get();
+        if (response.status != GGSock::Rpc::Ok) return 3;
+
+        int32_t x = 0;
+        if (GGSock::Unserialize()(x, response.data) == false) return 4;
+        if (x != i*i) return 5;
+    }
+
+    if (fUnknown.get().status != GGSock::Rpc::ErrorUnknownMethod) return 6;
+
+    if (fDeferred.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready) return 7;
+    {
+        const char msg[] = "done";
+        GGSock::Rpc::TRequestId requestId = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutexDeferred);
+            if (deferred.size() != 1) return 8;
+            requestId = deferred[0];
+        }
+        rpcServer.respond(requestId, GGSock::Rpc::Ok, msg, sizeof(msg));
+        auto response = fDeferred.get();
+        if (response.status != GGSock::Rpc::Ok || response.data.size() != sizeof(msg)) return 9;
+    }
+
+    while (fTimeout.wait_for(std::chrono::milliseconds(1)) != std::future_status::ready) {
+        rpcClient.update();
+    }
+    if (fTimeout.get().status != GGSock::Rpc::ErrorTimeout) return 10;
+
+    if (rpcClient.getNumPendingCalls() != 0) return 11;
+
+    // pending calls fail when the connection drops
+    auto fDisconnected = rpcClient.call(MethodNoReply, nullptr, 0, 0);
+    if (rpcClient.getNumPendingCalls() != 1) return 12;
+
+    client.disconnect();
+
+    while (fDisconnected.wait_for(std::chrono::milliseconds(1)) != std::future_status::ready) {
+        rpcClient.update();
+    }
+    if (fDisconnected.get().status != GGSock::Rpc::ErrorDisconnected) return 13;
+    if (rpcClient.getNumPendingCalls() != 0) return 14;
+
+    printf("Done!\n");
+
+    return 0;
+}
@@ -0,0 +1,173 @@
+#include "ggsock/buffer-pool.h"
+#include "ggsock/communicator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+    using TClock = std::chrono::steady_clock;
+
+    int64_t getElapsed_ms(TClock::time_point tStart) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(TClock::now() - tStart).count();
+    }
+}
+
+int main() {
+    {
+        // buffer pool - runs first, so the pool and the cache of this thread start empty
+        using namespace GGSock;
+
+        const size_t kMiB = 1024*1024;
+
+        // size classes are powers of two from 64 B to 1 MiB
+        const size_t sizes[]    = {  0,  1, 64,  65, 100, 1000, 4096, 4097, 512*1024 + 1, kMiB };
+        const size_t expected[] = { 64, 64, 64, 128, 128, 1024, 4096, 8192,         kMiB, kMiB };
+        for (size_t i = 0; i < sizeof(sizes)/sizeof(sizes[0]); ++i) {
+            auto buffer = BufferPool::acquire(sizes[i]);
+            if (buffer.size() != 0) return 1;
+            if (buffer.capacity() != expected[i]) return 2;
+            BufferPool::release(buffer);
+            if (buffer.capacity() != 0) return 3;
+        }
+        if (BufferPool::getNumBytesCached() != 0) return 4;
+
+        // a released buffer is served again by the cache of this thread
+        {
+            auto buffer = BufferPool::acquire(1000);
+            const char * ptr = buffer.data();
+            BufferPool::release(buffer);
+
+            buffer = BufferPool::acquire(1000);
+            if (buffer.data() != ptr) return 5;
+            if (BufferPool::getNumBytesCached() != 0) return 6;
+            BufferPool::release(buffer);
+        }
+
+        // the thread cache keeps 64 buffers of 64 B and the shared pool 1024, the rest are freed
+        {
+            std::vector<SerializationBuffer> buffers(2000);
+            for (auto & buffer : buffers) buffer = BufferPool::acquire(64);
+            for (auto & buffer : buffers) BufferPool::release(buffer);
+
+            if (BufferPool::getNumBytesCached() != 1024*64) return 7;
+        }
+
+        // the 1 MiB class is limited by bytes - one buffer in the thread cache, 4 MiB in the shared pool
+        {
+            std::vector<SerializationBuffer> buffers(10);
+            for (auto & buffer : buffers) buffer = BufferPool::acquire(kMiB);
+            for (auto & buffer : buffers) BufferPool::release(buffer);
+
+            if (BufferPool::getNumBytesCached() != 1024*64 + 4*kMiB) return 8;
+
+            // served from the thread cache first, then from the shared pool
+            for (auto & buffer : buffers) buffer = BufferPool::acquire(kMiB);
+            if (BufferPool::getNumBytesCached() != 1024*64) return 9;
+
+            // with the thread cache full, a 1.5 MiB buffer goes to the 1 MiB class and is counted at its capacity
+            BufferPool::release(buffers[0]);
+
+            SerializationBuffer larger;
+            larger.reserve(kMiB + kMiB/2);
+            const size_t capacity = larger.capacity();
+            BufferPool::release(larger);
+            if (BufferPool::getNumBytesCached() != 1024*64 + capacity) return 10;
+
+            // the thread cache is drained first
+            buffers[0] = BufferPool::acquire(kMiB);
+            auto buffer = BufferPool::acquire(kMiB);
+            if (buffer.capacity() != capacity) return 11;
+            if (BufferPool::getNumBytesCached() != 1024*64) return 12;
+
+            BufferPool::release(buffer);
+            for (auto & buffer : buffers) BufferPool::release(buffer);
+        }
+
+        // buffers above 1 MiB bypass the pool
+        {
+            const size_t nCached = BufferPool::getNumBytesCached();
+
+            auto buffer = BufferPool::acquire(kMiB + 1);
+            if (buffer.capacity() < kMiB + 1) return 13;
+            if (BufferPool::getNumBytesCached() != nCached) return 14;
+
+            SerializationBuffer huge;
+            huge.reserve(3*kMiB);
+            BufferPool::release(huge);
+            if (huge.capacity() != 0) return 15;
+            if (BufferPool::getNumBytesCached() != nCached) return 16;
+
+            BufferPool::release(buffer);
+            if (BufferPool::getNumBytesCached() != nCached) return 17;
+        }
+    }
+
+    {
+        // the receive buffer is allocated on the first read, grows for a large message and is released when idle
+        const size_t largeSize = 1024*1024;
+
+        std::vector<char> large(largeSize);
+        std::vector<char> small(1024);
+        int32_t nReceived = 0;
+
+        // without a worker, every update reads at most once from the socket
+        GGSock::Communicator server(false);
+        server.setMessageCallback(42, [&](const char * , size_t ) {
+            ++nReceived;
+            return 0;
+        });
+
+        // less than a single receive chunk
+        const size_t usageIdle = server.getMemoryUsage();
+        if (usageIdle >= 16*1024) return 1;
+
+        GGSock::Communicator client(true);
+
+        if (server.listen(12359, 0) == false) return 2;
+        if (client.connect("127.0.0.1", 12359, 100) == false) return 3;
+
+        while (server.isConnected() == false) {
+            server.update();
+        }
+        while (client.isConnected() == false) {}
+
+        if (client.send(42, large.data(), large.size()) == false) return 4;
+
+        size_t usageMax = 0;
+        auto tStart = TClock::now();
+        while (nReceived < 1 && getElapsed_ms(tStart) < 2000) {
+            server.update();
+            usageMax = (std::max)(usageMax, server.getMemoryUsage());
+        }
+        if (nReceived != 1) return 5;
+        if (usageMax < usageIdle + largeSize) return 6;
+
+        // buffers above 64 KiB are not kept after the message
+        if (server.getMemoryUsage() > usageIdle + 64*1024) return 7;
+
+        if (client.send(42, small.data(), small.size()) == false) return 8;
+        tStart = TClock::now();
+        while (nReceived < 2 && getElapsed_ms(tStart) < 2000) {
+            server.update();
+        }
+        if (nReceived != 2) return 9;
+        if (server.getMemoryUsage() < usageIdle + small.size()) return 10;
+
+        // nothing sent or received for a while
+        tStart = TClock::now();
+        while (getElapsed_ms(tStart) < 1500) {
+            server.update();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (server.isConnected() == false) return 11;
+        if (server.getMemoryUsage() > usageIdle) return 12;
+
+        client.disconnect();
+    }
+
+    printf("Done!\n");
+
+    return 0;
+}
@@ -0,0 +1,168 @@
+#include "ggsock/communicator.h"
+#include "ggsock/coroutines.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+    using TClock = std::chrono::steady_clock;
+
+    int64_t getElapsed_ms(TClock::time_point tStart) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(TClock::now() - tStart).count();
+    }
+
+    // the client has no worker - its updates are paused while the send queue is filled
+    struct Updater {
+        Updater(GGSock::Communicator & communicator) : communicator(communicator) {
+            worker = std::thread([this]() {
+                while (isRunning) {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (isUpdating) {
+                            this->communicator.update();
+                        }
+                    }
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            });
+        }
+
+        ~Updater() {
+            isRunning = false;
+            worker.join();
+        }
+
+        // returns after the update in progress, if any
+        void setUpdating(bool updating) {
+            std::lock_guard<std::mutex> lock(mutex);
+            isUpdating = updating;
+        }
+
+        GGSock::Communicator & communicator;
+
+        std::atomic<bool> isRunning { true };
+        bool isUpdating = true;
+
+        std::mutex mutex;
+        std::thread worker;
+    };
+
+    struct State {
+        int32_t result = -1;
+
+        std::atomic<bool> isSendPending { false };
+        std::atomic<bool> isSendResumed { false };
+        int32_t nQueued = 0;
+
+        bool isDone = false;
+    };
+
+    GGSock::Co::Task<void> run(GGSock::Co::Connection & connection, GGSock::Communicator & client, GGSock::Communicator & server, Updater & updater, State & state) {
+        state.result = 0;
+
+        // nobody listens yet
+        auto tStart = TClock::now();
+        if (co_await connection.connect("127.0.0.1", 12360, 200) == true) { state.result = 1; co_return; }
+        if (getElapsed_ms(tStart) < 190) { state.result = 2; co_return; }
+        if (client.isConnected()) { state.result = 3; co_return; }
+
+        if (server.listen(12360, 0) == false) { state.result = 4; co_return; }
+        if (co_await connection.connect("127.0.0.1", 12360, 1000) == false) { state.result = 5; co_return; }
+        if (client.isConnected() == false) { state.result = 6; co_return; }
+
+        // nothing sent yet
+        tStart = TClock::now();
+        auto message = co_await connection.receive(42, 100);
+        if (message.isValid) { state.result = 7; co_return; }
+        if (getElapsed_ms(tStart) < 90) { state.result = 8; co_return; }
+
+        while (server.isConnected() == false) {}
+        if (server.send(42, "hello", 5) == false) { state.result = 9; co_return; }
+
+        message = co_await connection.receive(42, 1000);
+        if (message.isValid == false || message.type != 42) { state.result = 10; co_return; }
+        if (message.data.size() != 5 || std::memcmp(message.data.data(), "hello", 5) != 0) { state.result = 11; co_return; }
+
+        // with the updates paused, the send queue stays full and the send suspends
+        updater.setUpdating(false);
+
+        std::vector<char> buf(1024);
+        while (client.isSendQueueFull() == false) {
+            if (client.send(43, buf.data(), buf.size()) == false) { state.result = 12; co_return; }
+            ++state.nQueued;
+        }
+
+        state.isSendPending = true;
+        const bool isSent = co_await connection.send(43, buf.data(), buf.size());
+        state.isSendResumed = true;
+
+        if (isSent == false) { state.result = 13; co_return; }
+        ++state.nQueued;
+    }
+
+    GGSock::Co::Task<void> runAndFinish(GGSock::Co::Connection & connection, GGSock::Communicator & client, GGSock::Communicator & server, Updater & updater, State & state) {
+        co_await run(connection, client, server, updater, state);
+        state.isDone = true;
+    }
+}
+
+int main() {
+    {
+        GGSock::Co::Scheduler scheduler;
+
+        std::atomic<int32_t> nReceived { 0 };
+
+        GGSock::Communicator server(true);
+        server.setMessageCallback(43, [&](const char * , size_t ) {
+            ++nReceived;
+            return 0;
+        });
+
+        GGSock::Communicator client(false);
+        Updater updater(client);
+
+        State state;
+
+        {
+            GGSock::Co::Connection connection(scheduler, client);
+            GGSock::Co::spawn(scheduler, runAndFinish(connection, client, server, updater, state));
+
+            const auto tStart = TClock::now();
+            while (state.isDone == false && getElapsed_ms(tStart) < 5000) {
+                scheduler.runOnce(10);
+
+                // the send has to wait until the queue is drained - only then the updates are resumed
+                if (state.isSendPending && state.isSendResumed == false) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                    if (state.isSendResumed) return 21;
+                    if (scheduler.runOnce(10) != 0) return 22;
+                    if (state.isSendResumed) return 23;
+
+                    state.isSendPending = false;
+                    updater.setUpdating(true);
+                }
+            }
+
+            if (state.isDone == false) return 24;
+            if (state.result != 0) return state.result;
+            if (state.isSendResumed == false) return 25;
+
+            const auto tWait = TClock::now();
+            while (nReceived < state.nQueued && getElapsed_ms(tWait) < 2000) {}
+            if (nReceived != state.nQueued) return 26;
+
+            updater.setUpdating(false);
+        }
+
+        client.disconnect();
+        server.disconnect();
+    }
+
+    printf("Done!\n");
+
+    return 0;
+}
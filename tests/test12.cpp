@@ -0,0 +1,146 @@
+#include "ggsock/buffer-pool.h"
+#include "ggsock/communicator.h"
+#include "ggsock/serialization.h"
+
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    using TClock = std::chrono::steady_clock;
+
+    int64_t getElapsed_ms(TClock::time_point tStart) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(TClock::now() - tStart).count();
+    }
+
+    struct Payload {
+        std::string name;
+        std::vector<int32_t> values;
+        std::vector<char> blob;
+    };
+
+    // announces a size, then fails halfway through
+    struct Failing {
+        int32_t value = 0;
+    };
+}
+
+GGSOCK_SERIALIZABLE(Payload, name, values, blob)
+
+namespace GGSock {
+    template <>
+    inline bool Serialize::operator()<Failing>(const Failing & obj, SerializationBuffer & buffer, size_t & offset) {
+        operator()(obj.value, buffer, offset);
+        return false;
+    }
+
+    template <>
+    inline size_t SerializedSize::operator()<Failing>(const Failing & ) {
+        return 100000;
+    }
+}
+
+int main() {
+    {
+        // frames built in place arrive as Serialize would produce them, with and without checksum and compression
+        Payload payload;
+        payload.name = "frame builder";
+        for (int32_t i = 0; i < 2000; ++i) {
+            payload.values.push_back(i%17);
+        }
+        payload.blob.assign(1000, 'x');
+
+        GGSock::SerializationBuffer expected;
+        if (GGSock::Serialize()(payload, expected) == false) return 1;
+
+        for (int iConfig = 0; iConfig < 4; ++iConfig) {
+            const bool useChecksum = (iConfig & 1) != 0;
+            const bool useCompression = (iConfig & 2) != 0;
+
+            std::mutex mutex;
+            std::map<GGSock::Communicator::TMessageType, std::vector<char>> received;
+
+            auto getNumReceived = [&]() {
+                std::lock_guard<std::mutex> lock(mutex);
+                return (int32_t) received.size();
+            };
+
+            GGSock::Communicator server(true);
+            for (GGSock::Communicator::TMessageType type : { 42, 43 }) {
+                server.setMessageCallback(type, [&, type](const char * dataBuffer, size_t dataSize) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    received[type].assign(dataBuffer, dataBuffer + dataSize);
+                    return 0;
+                });
+            }
+
+            // without a worker, so nothing leaves the send queue between the checks
+            GGSock::Communicator client(false);
+
+            for (auto communicator : { &server, &client }) {
+                if (communicator->setFrameChecksum(useChecksum) == false) return 2;
+                if (useCompression && communicator->setCompression({}) == false) return 3;
+            }
+
+            const GGSock::TPort port = 12361 + iConfig;
+            if (server.listen(port, 0) == false) return 4;
+            if (client.connect("127.0.0.1", port, 100) == false) return 5;
+            while (server.isConnected() == false) {}
+
+            // the features are used after the hello exchange
+            auto tStart = TClock::now();
+            while (getElapsed_ms(tStart) < 50) {
+                client.update();
+            }
+
+            if (client.sendSerialized(42, payload) == false) return 6;
+
+            auto frame = GGSock::Communicator::beginFrame(expected.size());
+            if (frame.size() != GGSock::Communicator::getFrameDataOffset() + expected.size()) return 7;
+            std::memcpy(frame.data() + GGSock::Communicator::getFrameDataOffset(), expected.data(), expected.size());
+            if (client.commitFrame(43, std::move(frame)) == false) return 8;
+
+            tStart = TClock::now();
+            while (getNumReceived() < 2 && getElapsed_ms(tStart) < 2000) {
+                client.update();
+            }
+            if (getNumReceived() != 2) return 9;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (const auto & message : received) {
+                    if (message.second.size() != expected.size()) return 10;
+                    if (std::memcmp(message.second.data(), expected.data(), expected.size()) != 0) return 11;
+                }
+            }
+
+            if (client.getStats().nMessagesCompressed != (useCompression ? 2u : 0u)) return 12;
+            if (server.getStats().nChecksumErrors != 0) return 13;
+
+            // a failed Serialize queues nothing and gives the frame back to the pool
+            if (client.getNumPendingMessages() != 0) return 14;
+
+            auto buffer = GGSock::BufferPool::acquire(GGSock::SerializedSize()(Failing()));
+            const char * ptr = buffer.data();
+            GGSock::BufferPool::release(buffer);
+
+            if (client.sendSerialized(44, Failing()) == true) return 15;
+            if (client.getNumPendingMessages() != 0) return 16;
+
+            buffer = GGSock::BufferPool::acquire(GGSock::SerializedSize()(Failing()));
+            if (buffer.data() != ptr) return 17;
+            GGSock::BufferPool::release(buffer);
+
+            client.disconnect();
+            server.disconnect();
+        }
+    }
+
+    printf("Done!\n");
+
+    return 0;
+}
@@ -0,0 +1,182 @@
+#include "ggsock/communicator.h"
+
+#include "compression.h"
+
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+int main() {
+    {
+        // frames queued while the connection is down are delivered once, in order, after the session is resumed
+        GGSock::Communicator::SessionParameters sessionParameters;
+        sessionParameters.reconnectBackoffMin_ms = 10;
+        sessionParameters.reconnectBackoffMax_ms = 50;
+
+        std::mutex mutex;
+        std::vector<int32_t> received;
+        bool isIdleTimeout = false;
+
+        GGSock::Communicator server(true);
+        server.enableSession(sessionParameters);
+        server.setKeepAlive(0, 200);
+        server.setErrorCallback([&](GGSock::Communicator::TErrorCode code) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (code == GGSock::Communicator::ErrorIdleTimeout) isIdleTimeout = true;
+        });
+        server.setMessageCallback(42, [&](const char * dataBuffer, size_t dataSize) {
+            if (dataSize != sizeof(int32_t)) return 0;
+            int32_t value = 0;
+            std::memcpy(&value, dataBuffer, sizeof(value));
+            std::lock_guard<std::mutex> lock(mutex);
+            received.push_back(value);
+            return 0;
+        });
+
+        auto getNumReceived = [&]() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return (int32_t) received.size();
+        };
+
+        if (server.listen(12347, 0) == false) return 1;
+
+        GGSock::Communicator client(true);
+        client.enableSession(sessionParameters);
+
+        if (client.connect("127.0.0.1", 12347, 100) == false) return 2;
+
+        while (client.isConnected() == false) {}
+        while (server.isConnected() == false) {}
+
+        for (int32_t i = 0; i < 10; ++i) {
+            if (client.send(42, (const char *) &i, sizeof(i)) == false) return 3;
+        }
+        while (getNumReceived() < 10) {}
+
+        // the client is silent, so the server drops the connection but keeps the session
+        while (server.isConnected()) {}
+        while (client.isConnected()) {}
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (isIdleTimeout == false) return 4;
+        }
+        server.setKeepAlive(0, 0);
+
+        for (int32_t i = 10; i < 20; ++i) {
+            if (client.send(42, (const char *) &i, sizeof(i)) == false) return 5;
+        }
+
+        if (server.listen(12347, 0) == false) return 6;
+
+        while (client.isConnected() == false) {}
+        while (server.isConnected() == false) {}
+        while (getNumReceived() < 20) {}
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (received.size() != 20) return 7;
+            for (int32_t i = 0; i < 20; ++i) {
+                if (received[i] != i) return 8;
+            }
+        }
+
+        if (client.getStats().nReconnects == 0) return 9;
+        if (server.getStats().nSessionResumes == 0 && client.getStats().nSessionResumes == 0) return 10;
+
+        client.disconnect();
+        server.disconnect();
+    }
+
+    {
+        // LZ4 round-trip, with the hash table reused between inputs
+        using namespace GGSock;
+
+        std::vector<char> input0(64*1024);
+        std::vector<char> input1(64*1024);
+        for (size_t i = 0; i < input0.size(); ++i) {
+            input0[i] = (char) ('a' + (i/64)%16);
+            input1[i] = (char) ('A' + (i*7/32)%24);
+        }
+
+        for (const auto & input : { input0, input1, input0 }) {
+            std::vector<char> compressed(Compression::getMaxCompressedSize(Compression::LZ4, input.size()));
+            size_t compressedSize = Compression::compress(Compression::LZ4, input.data(), input.size(), compressed.data(), compressed.size(), 0);
+            if (compressedSize == 0 || compressedSize >= input.size()) return 11;
+
+            // the bound used to reject forged original sizes must hold for real frames
+            if (Compression::getMaxDecompressedSize(Compression::LZ4, compressed.data(), compressedSize) < input.size()) return 12;
+
+            std::vector<char> output(input.size());
+            if (Compression::decompress(Compression::LZ4, compressed.data(), compressedSize, output.data(), output.size()) == false) return 13;
+            if (output != input) return 14;
+
+            // wrong original size and truncated input
+            std::vector<char> larger(input.size() + 1);
+            if (Compression::decompress(Compression::LZ4, compressed.data(), compressedSize, larger.data(), larger.size())) return 15;
+            if (Compression::decompress(Compression::LZ4, compressed.data(), compressedSize/2, output.data(), output.size())) return 16;
+        }
+    }
+
+    {
+        // compressed frames between two Communicators
+        std::vector<char> payload(64*1024);
+        for (size_t i = 0; i < payload.size(); ++i) {
+            payload[i] = (char) ('a' + (i/64)%16);
+        }
+
+        std::mutex mutex;
+        int32_t nReceived = 0;
+        int32_t nMismatched = 0;
+
+        GGSock::Communicator server(true);
+        server.setCompression({});
+        server.setMessageCallback(42, [&](const char * dataBuffer, size_t dataSize) {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++nReceived;
+            if (dataSize != payload.size() || std::memcmp(dataBuffer, payload.data(), dataSize) != 0) ++nMismatched;
+            return 0;
+        });
+
+        auto getNumReceived = [&]() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return nReceived;
+        };
+
+        if (server.listen(12347, 0) == false) return 21;
+
+        GGSock::Communicator client(true);
+        client.setCompression({});
+
+        if (client.connect("127.0.0.1", 12347, 100) == false) return 22;
+
+        while (client.isConnected() == false) {}
+        while (server.isConnected() == false) {}
+
+        // compression is used only after the hello exchange
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        for (int i = 0; i < 3; ++i) {
+            if (client.send(42, payload.data(), payload.size()) == false) return 23;
+        }
+        while (getNumReceived() < 3) {}
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (nMismatched != 0) return 24;
+        }
+
+        auto stats = client.getStats();
+        if (stats.nMessagesCompressed != 3) return 25;
+        if (stats.nBytesAfterCompression >= stats.nBytesBeforeCompression) return 26;
+
+        client.disconnect();
+        server.disconnect();
+    }
+
+    printf("Done!\n");
+
+    return 0;
+}
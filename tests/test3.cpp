@@ -0,0 +1,287 @@
+#include "ggsock/communicator.h"
+#include "ggsock/communicator-group.h"
+#include "ggsock/pub-sub.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+namespace {
+    using TCommunicator = std::shared_ptr<GGSock::Communicator>;
+
+    // the server side has no worker, so its send queue is drained only by explicit updates
+    bool connectPair(TCommunicator & server, TCommunicator & client, GGSock::TPort port) {
+        server = std::make_shared<GGSock::Communicator>(false);
+        client = std::make_shared<GGSock::Communicator>(true);
+
+        if (server->listen(port, 0) == false) return false;
+        if (client->connect("127.0.0.1", port, 100) == false) return false;
+
+        while (server->isConnected() == false) {
+            server->update();
+        }
+        while (client->isConnected() == false) {}
+
+        return true;
+    }
+
+    template <typename F>
+    bool waitFor(F && condition, int32_t timeout_ms) {
+        const auto tEnd = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        while (condition() == false) {
+            if (std::chrono::steady_clock::now() >= tEnd) return false;
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+
+        return true;
+    }
+}
+
+int main() {
+    using Group = GGSock::CommunicatorGroup;
+
+    char buf[64] = { 0 };
+
+    {
+        // drop - a slow member misses messages, a fast one gets all of them
+        TCommunicator slow, slowClient;
+        TCommunicator fast, fastClient;
+        if (connectPair(slow, slowClient, 12348) == false) return 1;
+        if (connectPair(fast, fastClient, 12349) == false) return 2;
+
+        std::atomic<int32_t> nReceived { 0 };
+        fastClient->setMessageCallback(42, [&](const char * , size_t ) {
+            ++nReceived;
+            return 0;
+        });
+
+        std::atomic<bool> isRunning { true };
+        std::thread worker([&]() {
+            while (isRunning) {
+                fast->update();
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        });
+
+        Group group;
+        if (group.add(slow) == false) return 3;
+        if (group.add(fast) == false) return 4;
+        if (group.add(fast) == true) return 5;
+        if (group.size() != 2) return 6;
+
+        for (int i = 0; i < 200; ++i) {
+            if (group.send(42, buf, sizeof(buf)) < 1) return 7;
+            while (fast->isSendQueueFull()) {}
+        }
+        while (nReceived < 200) {}
+
+        isRunning = false;
+        worker.join();
+
+        auto stats = group.getStats();
+        if (stats.nFramesEncoded != 200) return 8;
+        if (stats.nMessagesDropped == 0) return 9;
+        if (stats.nMessagesQueued + stats.nMessagesDropped != 400) return 10;
+        if (stats.nDisconnects != 0 || stats.nBlocks != 0) return 11;
+        if (slow->isConnected() == false) return 12;
+    }
+
+    {
+        // disconnect - the slow member is dropped once and skipped afterwards
+        TCommunicator slow, slowClient;
+        if (connectPair(slow, slowClient, 12348) == false) return 21;
+
+        Group::Parameters parameters;
+        parameters.policy = Group::SlowConsumerPolicy::Disconnect;
+
+        Group group(parameters);
+        group.add(slow);
+
+        for (int i = 0; i < 200; ++i) {
+            group.send(42, buf, sizeof(buf));
+        }
+
+        auto stats = group.getStats();
+        if (stats.nDisconnects != 1) return 22;
+        if (stats.nMessagesDropped != 1) return 23;
+        if (slow->isConnected()) return 24;
+        if (group.send(42, buf, sizeof(buf)) != 0) return 25;
+    }
+
+    {
+        // block - without anybody draining the queue, the send times out and the message is dropped
+        TCommunicator slow, slowClient;
+        if (connectPair(slow, slowClient, 12348) == false) return 31;
+
+        Group::Parameters parameters;
+        parameters.policy = Group::SlowConsumerPolicy::Block;
+        parameters.blockTimeout_ms = 20;
+
+        Group group(parameters);
+        group.add(slow);
+
+        while (group.send(42, buf, sizeof(buf)) == 1) {}
+
+        auto stats = group.getStats();
+        if (stats.nBlocks != 1) return 32;
+        if (stats.nMessagesDropped != 1) return 33;
+        if (slow->isConnected() == false) return 34;
+
+        // with another thread updating the member, blocked sends wait for room and nothing is dropped
+        std::atomic<int32_t> nReceived { 0 };
+        slowClient->setMessageCallback(42, [&](const char * , size_t ) {
+            ++nReceived;
+            return 0;
+        });
+
+        std::atomic<bool> isRunning { true };
+        std::thread worker([&]() {
+            while (isRunning) {
+                slow->update();
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+
+        for (int i = 0; i < 200; ++i) {
+            if (group.send(42, buf, sizeof(buf)) != 1) return 35;
+        }
+
+        stats = group.getStats();
+        if (stats.nBlocks < 2) return 36;
+        if (stats.nMessagesDropped != 1) return 37;
+
+        while (nReceived < (int32_t) stats.nMessagesQueued) {}
+
+        isRunning = false;
+        worker.join();
+    }
+
+    {
+        // a subscribed peer publishes faster than the broker can send to it, under each policy
+        // the policies wait for or disconnect the publisher itself, which must not happen from its callback
+        const Group::SlowConsumerPolicy policies[] = {
+            Group::SlowConsumerPolicy::Drop,
+            Group::SlowConsumerPolicy::Disconnect,
+            Group::SlowConsumerPolicy::Block,
+        };
+
+        for (auto policy : policies) {
+            GGSock::PubSubBroker::Parameters parameters;
+            parameters.delivery.policy = policy;
+
+            GGSock::PubSubBroker broker(parameters);
+
+            auto server = std::make_shared<GGSock::Communicator>(true);
+            if (server->listen(12348, 0) == false) return 41;
+            if (broker.addPeer(server) == false) return 42;
+
+            GGSock::Communicator::WorkerParameters workerParameters;
+            workerParameters.mode = GGSock::Communicator::WorkerMode::BusyPoll;
+
+            GGSock::Communicator client(true, workerParameters);
+            GGSock::PubSubClient pubSub(client);
+
+            std::atomic<int32_t> nReceived { 0 };
+            pubSub.subscribe(1, [&](GGSock::PubSubBroker::TTopic , const char * , GGSock::Communicator::TBufferSize ) {
+                ++nReceived;
+            });
+
+            if (client.connect("127.0.0.1", 12348, 100) == false) return 43;
+            while (client.isConnected() == false) {}
+
+            if (waitFor([&]() { pubSub.update(); return broker.getNumSubscribers(1) == 1; }, 1000) == false) return 44;
+
+            int32_t nPublished = 0;
+            const auto tEnd = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+            while (nPublished < 1000 && server->isConnected() && std::chrono::steady_clock::now() < tEnd) {
+                if (pubSub.publish(1, buf, sizeof(buf))) {
+                    ++nPublished;
+                }
+                if (nPublished % 100 == 0) {
+                    broker.update();
+                }
+            }
+
+            switch (policy) {
+                case Group::SlowConsumerPolicy::Drop:
+                    {
+                        if (nPublished != 1000) return 45;
+                        broker.update();
+                        if (waitFor([&]() { broker.update(); return nReceived > 0; }, 1000) == false) return 46;
+                    }
+                    break;
+                case Group::SlowConsumerPolicy::Disconnect:
+                    {
+                        // the publisher could not keep up and was dropped, together with its subscriptions
+                        if (server->isConnected()) return 47;
+                        if (waitFor([&]() { broker.update(); return broker.getNumSubscribers(1) == 0; }, 1000) == false) return 48;
+                    }
+                    break;
+                case Group::SlowConsumerPolicy::Block:
+                    {
+                        if (nPublished != 1000) return 49;
+                        if (waitFor([&]() { broker.update(); return nReceived == 1000; }, 5000) == false) return 50;
+                    }
+                    break;
+            }
+
+            client.disconnect();
+            broker.removePeer(server);
+        }
+    }
+
+    {
+        // the subscriptions of a connection do not carry over to the next connection of the same peer
+        GGSock::PubSubBroker broker;
+
+        auto server = std::make_shared<GGSock::Communicator>(true);
+        if (broker.addPeer(server) == false) return 61;
+
+        auto onMessage = [](GGSock::PubSubBroker::TTopic , const char * , GGSock::Communicator::TBufferSize ) {};
+
+        {
+            GGSock::Communicator client(true);
+            GGSock::PubSubClient pubSub(client);
+            pubSub.subscribe(2, onMessage);
+            pubSub.subscribe(3, onMessage);
+
+            if (server->listen(12348, 0) == false) return 62;
+            if (client.connect("127.0.0.1", 12348, 100) == false) return 63;
+            while (client.isConnected() == false) {}
+
+            if (waitFor([&]() { pubSub.update(); return broker.getNumSubscribers(2) == 1 && broker.getNumSubscribers(3) == 1; }, 1000) == false) return 64;
+
+            client.disconnect();
+            while (server->isConnected()) {}
+        }
+
+        {
+            // without an update in between, the next connection's first message replaces the old subscriptions
+            GGSock::Communicator client(true);
+            GGSock::PubSubClient pubSub(client);
+            pubSub.subscribe(3, onMessage);
+
+            if (server->listen(12348, 0) == false) return 65;
+            if (client.connect("127.0.0.1", 12348, 100) == false) return 66;
+            while (client.isConnected() == false) {}
+
+            if (waitFor([&]() { pubSub.update(); return broker.getNumSubscribers(2) == 0; }, 1000) == false) return 67;
+            if (broker.getNumSubscribers(3) != 1) return 68;
+
+            client.disconnect();
+            while (server->isConnected()) {}
+        }
+
+        // the update drops the subscriptions of a peer that is no longer connected
+        if (broker.getNumSubscribers(3) != 1) return 69;
+        broker.update();
+        if (broker.getNumSubscribers(3) != 0) return 70;
+
+        broker.removePeer(server);
+    }
+
+    printf("Done!\n");
+
+    return 0;
+}
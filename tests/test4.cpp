@@ -0,0 +1,178 @@
+#include "ggsock/communicator.h"
+#include "ggsock/timer-wheel.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace {
+    using TClock = std::chrono::steady_clock;
+
+    int64_t getElapsed_ms(TClock::time_point tStart) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(TClock::now() - tStart).count();
+    }
+}
+
+int main() {
+    {
+        // timers on both sides of the level boundary at 256 ticks, cascaded down as the wheel advances
+        GGSock::TimerWheel wheel;
+
+        const int32_t delays[] = { 5, 200, 255, 256, 257, 300, 511, 512, 700 };
+        const int32_t nDelays = sizeof(delays)/sizeof(delays[0]);
+
+        struct Fired {
+            int32_t index;
+            int64_t tElapsed_ms;
+        };
+
+        const auto tStart = TClock::now();
+
+        std::vector<Fired> fired;
+        std::vector<GGSock::TimerWheel::TTimerId> ids;
+        for (int32_t i = 0; i < nDelays; ++i) {
+            ids.push_back(wheel.schedule(delays[i], [&fired, tStart, i]() { fired.push_back({ i, getElapsed_ms(tStart) }); }));
+            if (ids.back() == 0) return 1;
+        }
+        if (wheel.getNumTimers() != nDelays) return 2;
+
+        // 300 is cancelled, 200 is moved past the boundary
+        if (wheel.cancel(ids[5]) == false) return 3;
+        if (wheel.cancel(ids[5]) == true) return 4;
+        if (wheel.reschedule(ids[1], 400) == false) return 5;
+
+        // a stale id does not cancel the timer that reuses its node
+        bool isReused = false;
+        auto idReused = wheel.schedule(600, [&]() { isReused = true; });
+        if (wheel.cancel(ids[5]) == true) return 6;
+
+        while (wheel.getNumTimers() > 0 && getElapsed_ms(tStart) < 2000) {
+            wheel.update();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        if (wheel.getNumTimers() != 0) return 7;
+        if (isReused == false) return 8;
+        if (wheel.cancel(idReused) == true) return 9;
+        if ((int32_t) fired.size() != nDelays - 1) return 10;
+
+        int64_t tLast_ms = 0;
+        for (const auto & f : fired) {
+            if (f.index == 5) return 11;
+
+            const int32_t delay = f.index == 1 ? 400 : delays[f.index];
+            if (f.tElapsed_ms < delay) return 12;
+            if (f.tElapsed_ms < tLast_ms) return 13;
+            tLast_ms = f.tElapsed_ms;
+        }
+    }
+
+    {
+        // a callback can schedule the next timer
+        GGSock::TimerWheel wheel;
+
+        int32_t nFired = 0;
+        std::function<void()> callback = [&]() {
+            if (++nFired < 5) {
+                wheel.schedule(10, [&]() { callback(); });
+            }
+        };
+        wheel.schedule(10, [&]() { callback(); });
+
+        const auto tStart = TClock::now();
+        while (nFired < 5 && getElapsed_ms(tStart) < 1000) {
+            wheel.update();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        if (nFired != 5) return 21;
+        if (getElapsed_ms(tStart) < 50) return 22;
+    }
+
+    {
+        // time to the earliest deadline, also when it sits on a higher level than later timers
+        GGSock::TimerWheel wheel;
+        if (wheel.getTimeToNext_ms() != -1) return 23;
+
+        auto id = wheel.schedule(300, []() {});
+        int32_t wait_ms = wheel.getTimeToNext_ms();
+        if (wait_ms < 250 || wait_ms > 300) return 24;
+
+        wheel.schedule(20, []() {});
+        wait_ms = wheel.getTimeToNext_ms();
+        if (wait_ms < 0 || wait_ms > 20) return 25;
+
+        // the 300 ms timer is still on the upper level, while a later one goes to the lower level
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        wheel.update();
+        wheel.schedule(250, []() {});
+        wait_ms = wheel.getTimeToNext_ms();
+        if (wait_ms < 50 || wait_ms > 100) return 26;
+
+        wheel.cancel(id);
+        wait_ms = wheel.getTimeToNext_ms();
+        if (wait_ms < 200 || wait_ms > 250) return 27;
+    }
+
+    {
+        // heartbeats keep the connection alive - once they stop, the idle timeout drops it
+        std::atomic<int32_t> nIdleTimeouts { 0 };
+
+        GGSock::Communicator server(true);
+        server.setKeepAlive(0, 150);
+        server.setErrorCallback([&](GGSock::Communicator::TErrorCode code) {
+            if (code == GGSock::Communicator::ErrorIdleTimeout) ++nIdleTimeouts;
+        });
+
+        GGSock::Communicator client(true);
+        client.setKeepAlive(30, 0);
+
+        if (server.listen(12350, 0) == false) return 31;
+        if (client.connect("127.0.0.1", 12350, 100) == false) return 32;
+
+        while (client.isConnected() == false) {}
+        while (server.isConnected() == false) {}
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        if (server.isConnected() == false || nIdleTimeouts != 0) return 33;
+
+        client.setKeepAlive(0, 0);
+
+        const auto tStart = TClock::now();
+        while (server.isConnected() && getElapsed_ms(tStart) < 2000) {}
+
+        if (server.isConnected()) return 34;
+        if (nIdleTimeouts != 1) return 35;
+
+        client.disconnect();
+    }
+
+    {
+        // connect without a timeout returns immediately and completes once the server listens
+        GGSock::Communicator client(true);
+        if (client.connect("127.0.0.1", 12350, -1) == false) return 41;
+        if (client.isConnecting() == false) return 42;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        if (client.isConnected()) return 43;
+
+        GGSock::Communicator server(true);
+        if (server.listen(12350, 0) == false) return 44;
+
+        while (client.isConnected() == false) {}
+        while (server.isConnected() == false) {}
+
+        client.disconnect();
+
+        // a pending connect is cancelled by disconnect()
+        if (client.connect("127.0.0.1", 12351, -1) == false) return 45;
+        if (client.disconnect() == false) return 46;
+        if (client.isConnecting() || client.isConnected()) return 47;
+    }
+
+    printf("Done!\n");
+
+    return 0;
+}
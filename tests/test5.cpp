@@ -0,0 +1,61 @@
+#include "ggsock/communicator.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+int main() {
+    {
+        // the client enables the varint header, but the server does not - frames are limited by the fixed header
+        // with checksum flags, and larger ones are rejected when sent instead of being dropped later
+        std::atomic<int32_t> nTooLarge { 0 };
+        std::atomic<int32_t> nReceived { 0 };
+
+        GGSock::Communicator server(true);
+        server.setFrameChecksum(true);
+        server.setMessageCallback(42, [&](const char * , size_t ) {
+            ++nReceived;
+            return 0;
+        });
+
+        GGSock::Communicator client(true);
+        client.setFrameChecksum(true);
+        client.setFrameHeader(GGSock::Communicator::FrameHeader::Varint);
+        client.setErrorCallback([&](GGSock::Communicator::TErrorCode code) {
+            if (code == GGSock::Communicator::ErrorFrameTooLarge) ++nTooLarge;
+        });
+
+        if (server.listen(12352, 0) == false) return 1;
+        if (client.connect("127.0.0.1", 12352, 100) == false) return 2;
+
+        while (client.isConnected() == false) {}
+        while (server.isConnected() == false) {}
+
+        // wait for the hello exchange
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        // never touched - the frame is rejected before the payload is copied
+        const GGSock::Communicator::TBufferSize dataSize = 1ull << 30;
+        std::unique_ptr<char[]> data(new char[dataSize]);
+
+        if (client.send(42, data.get(), dataSize) == true) return 3;
+
+        const auto tStart = std::chrono::steady_clock::now();
+        while (nTooLarge == 0 && std::chrono::steady_clock::now() - tStart < std::chrono::seconds(1)) {}
+        if (nTooLarge != 1) return 4;
+
+        // smaller frames are not affected
+        if (client.send(42, data.get(), 0) == false) return 5;
+        while (nReceived == 0 && std::chrono::steady_clock::now() - tStart < std::chrono::seconds(2)) {}
+        if (nReceived != 1) return 6;
+        if (client.isConnected() == false) return 7;
+
+        client.disconnect();
+        server.disconnect();
+    }
+
+    printf("Done!\n");
+
+    return 0;
+}
@@ -0,0 +1,488 @@
+#include "ggsock/arena.h"
+#include "ggsock/serialization.h"
+
+#include <array>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct Point {
+    float x;
+    float y;
+    int32_t id;
+};
+
+GGSOCK_SERIALIZE_AS_BYTES(Point)
+
+// adjacent fields, a gap of padding before e, non-trivial and nested fields
+struct Record {
+    int32_t a;
+    int32_t b;
+    uint8_t c;
+    int64_t e;
+    std::string name;
+    Point position;
+    std::vector<int16_t> samples;
+    double d;
+};
+
+GGSOCK_SERIALIZABLE(Record, a, b, c, e, name, position, samples, d)
+
+namespace {
+    using TMap = std::map<std::string, std::pair<std::vector<int32_t>, std::shared_ptr<std::string>>>;
+
+    TMap makeMap() {
+        TMap res;
+        for (int32_t i = 0; i < 50; ++i) {
+            std::vector<int32_t> values;
+            for (int32_t j = 0; j < i; ++j) {
+                values.push_back((j - 25)*(i + 1)*1000);
+            }
+            res["key" + std::to_string(i)] = { std::move(values), std::make_shared<std::string>(i, 'a' + i%26) };
+        }
+
+        return res;
+    }
+
+    bool isEqual(const TMap & a, const TMap & b) {
+        if (a.size() != b.size()) return false;
+        for (auto ita = a.begin(), itb = b.begin(); ita != a.end(); ++ita, ++itb) {
+            if (ita->first != itb->first) return false;
+            if (ita->second.first != itb->second.first) return false;
+            if (*ita->second.second != *itb->second.second) return false;
+        }
+
+        return true;
+    }
+}
+
+int main() {
+    {
+        // the buffer is sized from SerializedSize and holds exactly the serialized bytes, for both encodings
+        const auto input = makeMap();
+
+        for (auto encoding : { GGSock::Encoding::Fixed, GGSock::Encoding::Varint }) {
+            GGSock::Serialize serialize;
+            serialize.encoding = encoding;
+
+            GGSock::SerializedSize size;
+            size.encoding = encoding;
+
+            // a reused buffer with stale content
+            GGSock::SerializationBuffer buffer(100000, 'x');
+            if (serialize(input, buffer) == false) return 1;
+            if (buffer.size() != size(input)) return 2;
+            if (serialize.nBytesProcessed != buffer.size()) return 3;
+
+            GGSock::Unserialize unserialize;
+            unserialize.encoding = encoding;
+
+            TMap output;
+            if (unserialize(output, buffer) == false) return 4;
+            if (isEqual(input, output) == false) return 5;
+
+            // a fresh buffer is allocated once
+            GGSock::SerializationBuffer fresh;
+            if (serialize(input, fresh) == false) return 6;
+            if (fresh != buffer) return 7;
+            if (fresh.capacity() != fresh.size()) return 8;
+        }
+    }
+
+    {
+        // writing at an offset inside the buffer overwrites, past the end it appends
+        GGSock::SerializationBuffer buffer(8, 0);
+
+        size_t offset = 4;
+        if (GGSock::Serialize()(std::string("abcdef"), buffer, offset) == false) return 11;
+        if (offset != 14 || buffer.size() != 14) return 12;
+
+        offset = 4;
+        std::string output;
+        if (GGSock::Unserialize()(output, buffer, offset) == false) return 13;
+        if (output != "abcdef") return 14;
+    }
+
+    {
+        // vectors and arrays of raw types are written as the length prefix followed by the elements' bytes
+        std::vector<int32_t> values;
+        for (int32_t i = 0; i < 1000; ++i) {
+            values.push_back(i*i - 500);
+        }
+
+        GGSock::SerializationBuffer buffer;
+        if (GGSock::Serialize()(values, buffer) == false) return 21;
+        if (buffer.size() != sizeof(int32_t) + values.size()*sizeof(int32_t)) return 22;
+        if (std::memcmp(buffer.data() + sizeof(int32_t), values.data(), values.size()*sizeof(int32_t)) != 0) return 23;
+
+        std::vector<int32_t> output;
+        if (GGSock::Unserialize()(output, buffer) == false) return 24;
+        if (output != values) return 25;
+
+        // truncated input
+        buffer.pop_back();
+        if (GGSock::Unserialize()(output, buffer) == true) return 26;
+    }
+
+    {
+        // structs opted in with GGSOCK_SERIALIZE_AS_BYTES, arrays, and the packed std::vector<bool>
+        std::vector<Point> points;
+        for (int32_t i = 0; i < 100; ++i) {
+            points.push_back({ 0.5f*i, -0.25f*i, i });
+        }
+        std::array<double, 16> weights;
+        for (size_t i = 0; i < weights.size(); ++i) {
+            weights[i] = 1.0/(i + 1);
+        }
+        std::vector<bool> flags = { true, false, false, true, true };
+
+        GGSock::SerializationBuffer buffer;
+        size_t offset = 0;
+        if (GGSock::Serialize()(points, buffer, offset) == false) return 31;
+        if (GGSock::Serialize()(weights, buffer, offset) == false) return 32;
+        if (GGSock::Serialize()(flags, buffer, offset) == false) return 33;
+        if (offset != sizeof(int32_t) + points.size()*sizeof(Point) + sizeof(weights) + sizeof(int32_t) + flags.size()) return 34;
+
+        std::vector<Point> pointsOut;
+        std::array<double, 16> weightsOut;
+        std::vector<bool> flagsOut;
+
+        offset = 0;
+        if (GGSock::Unserialize()(pointsOut, buffer, offset) == false) return 35;
+        if (GGSock::Unserialize()(weightsOut, buffer, offset) == false) return 36;
+        if (GGSock::Unserialize()(flagsOut, buffer, offset) == false) return 37;
+        if (offset != buffer.size()) return 38;
+
+        if (pointsOut.size() != points.size()) return 39;
+        for (size_t i = 0; i < points.size(); ++i) {
+            if (pointsOut[i].x != points[i].x || pointsOut[i].y != points[i].y || pointsOut[i].id != points[i].id) return 40;
+        }
+        if (weightsOut != weights) return 41;
+        if (flagsOut != flags) return 42;
+    }
+
+    {
+        // views point into the unserialized buffer and share the wire format of std::string and std::vector<char>
+        const std::string name = "record-0001";
+        const std::vector<char> payload(300, 'p');
+
+        GGSock::SerializationBuffer buffer;
+        size_t offset = 0;
+        if (GGSock::Serialize()(name, buffer, offset) == false) return 51;
+        if (GGSock::Serialize()(payload, buffer, offset) == false) return 52;
+
+        GGSock::StringView nameView;
+        GGSock::BlobView payloadView;
+
+        offset = 0;
+        if (GGSock::Unserialize()(nameView, buffer, offset) == false) return 53;
+        if (GGSock::Unserialize()(payloadView, buffer, offset) == false) return 54;
+        if (offset != buffer.size()) return 55;
+
+        if (nameView.str() != name) return 56;
+        if (nameView.data != buffer.data() + sizeof(int32_t)) return 57;
+        if (payloadView.size != payload.size() || std::memcmp(payloadView.data, payload.data(), payload.size()) != 0) return 58;
+        if (payloadView.end() != buffer.data() + buffer.size()) return 59;
+
+        // and back to the owning types
+        GGSock::SerializationBuffer buffer2;
+        offset = 0;
+        if (GGSock::Serialize()(nameView, buffer2, offset) == false) return 60;
+        if (GGSock::Serialize()(payloadView, buffer2, offset) == false) return 61;
+        if (buffer2 != buffer) return 62;
+
+        // a length past the end of the input
+        buffer.pop_back();
+        offset = sizeof(int32_t) + name.size();
+        if (GGSock::Unserialize()(payloadView, buffer, offset) == true) return 63;
+    }
+
+    {
+        // the generated overloads write the same bytes as the fields one by one, in both encodings
+        Record record;
+        record.a = -7;
+        record.b = 1 << 20;
+        record.c = 200;
+        record.e = -(1ll << 40);
+        record.name = "gg";
+        record.position = { 1.0f, 2.0f, 3 };
+        record.samples = { 1, -2, 300, -4000 };
+        record.d = 3.25;
+
+        for (auto encoding : { GGSock::Encoding::Fixed, GGSock::Encoding::Varint }) {
+            GGSock::Serialize serialize;
+            serialize.encoding = encoding;
+
+            GGSock::SerializationBuffer buffer;
+            if (serialize(record, buffer) == false) return 71;
+
+            GGSock::Serialize serializeFields;
+            serializeFields.encoding = encoding;
+
+            GGSock::SerializationBuffer expected;
+            size_t offset = 0;
+            serializeFields(record.a, expected, offset);
+            serializeFields(record.b, expected, offset);
+            serializeFields(record.c, expected, offset);
+            serializeFields(record.e, expected, offset);
+            serializeFields(record.name, expected, offset);
+            serializeFields(record.position, expected, offset);
+            serializeFields(record.samples, expected, offset);
+            serializeFields(record.d, expected, offset);
+            if (buffer != expected) return 72;
+
+            GGSock::SerializedSize size;
+            size.encoding = encoding;
+            if (size(record) != buffer.size()) return 73;
+
+            GGSock::Unserialize unserialize;
+            unserialize.encoding = encoding;
+
+            Record output {};
+            if (unserialize(output, buffer) == false) return 74;
+            if (output.a != record.a || output.b != record.b || output.c != record.c || output.e != record.e) return 75;
+            if (output.name != record.name || output.samples != record.samples || output.d != record.d) return 76;
+            if (output.position.x != record.position.x || output.position.y != record.position.y || output.position.id != record.position.id) return 77;
+
+            // truncated input
+            buffer.pop_back();
+            if (unserialize(output, buffer) == true) return 78;
+        }
+    }
+
+    {
+        // LEB128 bytes of known values, zigzag for signed types
+        GGSock::Serialize serialize;
+        serialize.encoding = GGSock::Encoding::Varint;
+
+        GGSock::Unserialize unserialize;
+        unserialize.encoding = GGSock::Encoding::Varint;
+
+        struct Expected {
+            int64_t value;
+            bool isSigned;
+            std::vector<uint8_t> bytes;
+        };
+
+        const Expected expected[] = {
+            { 0,    false, { 0x00 } },
+            { 127,  false, { 0x7F } },
+            { 128,  false, { 0x80, 0x01 } },
+            { 300,  false, { 0xAC, 0x02 } },
+            { 0,    true,  { 0x00 } },
+            { -1,   true,  { 0x01 } },
+            { 1,    true,  { 0x02 } },
+            { -64,  true,  { 0x7F } },
+            { 64,   true,  { 0x80, 0x01 } },
+        };
+
+        for (const auto & e : expected) {
+            GGSock::SerializationBuffer buffer;
+            if (e.isSigned) {
+                serialize((int32_t) e.value, buffer);
+            } else {
+                serialize((uint32_t) e.value, buffer);
+            }
+            if (buffer.size() != e.bytes.size() || std::memcmp(buffer.data(), e.bytes.data(), buffer.size()) != 0) return 81;
+        }
+
+        // limits of the 64-bit types
+        const int64_t signedValues[] = { INT64_MIN, INT64_MIN + 1, -1, INT64_MAX };
+        for (auto value : signedValues) {
+            GGSock::SerializationBuffer buffer;
+            int64_t output = 0;
+            if (serialize(value, buffer) == false || unserialize(output, buffer) == false || output != value) return 82;
+        }
+
+        GGSock::SerializationBuffer buffer;
+        uint64_t output = 0;
+        if (serialize(UINT64_MAX, buffer) == false || buffer.size() != 10) return 83;
+        if (unserialize(output, buffer) == false || output != UINT64_MAX) return 84;
+
+        // a value that does not fit the target type, a truncated varint and one longer than 10 bytes
+        uint16_t narrow = 0;
+        buffer.clear();
+        serialize((uint32_t) 70000, buffer);
+        if (unserialize(narrow, buffer) == true) return 85;
+
+        int16_t narrowSigned = 0;
+        buffer.clear();
+        serialize((int32_t) -40000, buffer);
+        if (unserialize(narrowSigned, buffer) == true) return 86;
+
+        buffer.assign(1, (char) 0x80);
+        if (unserialize(output, buffer) == true) return 87;
+
+        buffer.assign(11, (char) 0x80);
+        buffer.push_back(0x00);
+        if (unserialize(output, buffer) == true) return 88;
+    }
+
+    {
+        // vectors of integers - small values take one byte each, mixed with larger ones across the 8-byte fast path
+        std::vector<int32_t> values;
+        for (int32_t i = 0; i < 100; ++i) {
+            values.push_back(i % 13 == 0 ? -100000*i : i % 60 - 30);
+        }
+
+        GGSock::Serialize serialize;
+        serialize.encoding = GGSock::Encoding::Varint;
+
+        GGSock::SerializationBuffer buffer;
+        if (serialize(values, buffer) == false) return 91;
+        if (buffer.size() >= values.size()*2) return 92;
+
+        GGSock::Unserialize unserialize;
+        unserialize.encoding = GGSock::Encoding::Varint;
+
+        std::vector<int32_t> output;
+        if (unserialize(output, buffer) == false) return 93;
+        if (output != values) return 94;
+
+        buffer.pop_back();
+        if (unserialize(output, buffer) == true) return 95;
+    }
+
+    {
+        // decoding into arena containers - the nested strings and vectors allocate from the same arena
+        std::map<std::string, std::vector<int32_t>> input;
+        for (int32_t i = 0; i < 100; ++i) {
+            input["a key longer than the small string buffer " + std::to_string(i)] = std::vector<int32_t>(i, i);
+        }
+
+        GGSock::SerializationBuffer buffer;
+        if (GGSock::Serialize()(input, buffer) == false) return 101;
+
+        GGSock::Arena arena(4096);
+        GGSock::ArenaMap<GGSock::ArenaString, GGSock::ArenaVector<int32_t>> output(arena);
+        if (GGSock::Unserialize()(output, buffer) == false) return 102;
+
+        if (output.size() != input.size()) return 103;
+        auto it = input.begin();
+        for (const auto & p : output) {
+            if (std::string(p.first.begin(), p.first.end()) != it->first) return 104;
+            if (std::vector<int32_t>(p.second.begin(), p.second.end()) != it->second) return 105;
+            if (p.first.get_allocator().getArena() != &arena) return 106;
+            if (p.second.get_allocator().getArena() != &arena) return 107;
+            ++it;
+        }
+
+        // every node, key and vector comes from the arena, so it holds at least all of their bytes
+        size_t nBytesPayload = 0;
+        for (const auto & p : input) {
+            nBytesPayload += p.first.size() + p.second.size()*sizeof(int32_t);
+        }
+        if (arena.getNumBytesAllocated() < nBytesPayload) return 108;
+        if (arena.getNumBytesReserved() <= 4096) return 109;
+
+        // vectors of strings, and serializing the arena containers back gives the same bytes
+        std::vector<std::string> names(20, "another string that does not fit in place");
+
+        GGSock::SerializationBuffer bufferNames;
+        if (GGSock::Serialize()(names, bufferNames) == false) return 110;
+
+        GGSock::ArenaVector<GGSock::ArenaString> namesOut(arena);
+        if (GGSock::Unserialize()(namesOut, bufferNames) == false) return 111;
+        if (namesOut.size() != names.size() || namesOut.back().get_allocator().getArena() != &arena) return 112;
+
+        GGSock::SerializationBuffer buffer2;
+        if (GGSock::Serialize()(output, buffer2) == false || buffer2 != buffer) return 113;
+        if (GGSock::Serialize()(namesOut, buffer2) == false || buffer2 != bufferNames) return 114;
+
+        // the containers are gone before the arena is reset - the first block is kept
+        output.clear();
+        namesOut.clear();
+        namesOut.shrink_to_fit();
+        arena.reset();
+        if (arena.getNumBytesAllocated() != 0 || arena.getNumBytesReserved() != 4096) return 115;
+    }
+
+    {
+        // a key that repeats in the input, or is already in the map, takes the last value instead of merging into it
+        using TInner = std::map<int32_t, int32_t>;
+
+        GGSock::SerializationBuffer buffer;
+        {
+            GGSock::Serialize serialize;
+            size_t offset = 0;
+            serialize((int32_t) 2, buffer, offset);
+            serialize((int32_t) 1, buffer, offset);
+            serialize(TInner { { 1, 1 }, { 2, 2 } }, buffer, offset);
+            serialize((int32_t) 1, buffer, offset);
+            serialize(TInner { { 3, 3 } }, buffer, offset);
+        }
+
+        std::map<int32_t, TInner> output;
+        if (GGSock::Unserialize()(output, buffer) == false) return 116;
+        if (output.size() != 1 || output[1] != TInner { { 3, 3 } }) return 117;
+
+        GGSock::Arena arena(4096);
+        GGSock::ArenaMap<int32_t, GGSock::ArenaMap<int32_t, int32_t>> outputArena(arena);
+        if (GGSock::Unserialize()(outputArena, buffer) == false) return 118;
+        if (outputArena.size() != 1 || outputArena.begin()->second.size() != 1 || outputArena.begin()->second.begin()->first != 3 ||
+            outputArena.begin()->second.get_allocator().getArena() != &arena) return 119;
+
+        // keys that are not in the input are kept
+        output = { { 1, { { 9, 9 } } }, { 5, { { 5, 5 } } } };
+        if (GGSock::Unserialize()(output, buffer) == false ||
+            output.size() != 2 || output[1] != TInner { { 3, 3 } } || output[5] != TInner { { 5, 5 } }) return 120;
+    }
+
+    {
+        // corrupt length prefixes are rejected before anything is allocated for them
+        auto makePrefix = [](int32_t n, size_t nPadding) {
+            GGSock::SerializationBuffer buffer;
+            GGSock::Serialize()(n, buffer);
+            buffer.resize(buffer.size() + nPadding, 0);
+            return buffer;
+        };
+
+        for (int32_t n : { -1, INT32_MIN, INT32_MAX, 1 << 20 }) {
+            const auto buffer = makePrefix(n, 64);
+
+            GGSock::Unserialize unserialize;
+
+            std::vector<int32_t> values;
+            std::string str;
+            std::map<int32_t, int32_t> m;
+            GGSock::BlobView view;
+            if (unserialize(values, buffer) == true || values.capacity() != 0) return 121;
+            if (unserialize(str, buffer) == true || str.size() != 0) return 122;
+            if (unserialize(m, buffer) == true || m.size() != 0) return 123;
+            if (unserialize(view, buffer) == true) return 124;
+            if (unserialize.nBytesAllocated != 0) return 125;
+        }
+
+        // the bound uses the smallest size an element can take - 4 bytes per fixed int32_t, 1 byte per string
+        {
+            const auto buffer = makePrefix(16, 63);
+
+            std::vector<int32_t> values;
+            if (GGSock::Unserialize()(values, buffer) == true || values.capacity() != 0) return 126;
+
+            std::vector<std::string> strings;
+            if (GGSock::Unserialize()(strings, makePrefix(16, 16*sizeof(int32_t))) == false || strings.size() != 16) return 127;
+        }
+
+        // the prefixes of valid input count towards maxBytesAllocated
+        std::vector<std::vector<int32_t>> nested(10, std::vector<int32_t>(100, 1));
+
+        GGSock::SerializationBuffer buffer;
+        GGSock::Serialize()(nested, buffer);
+
+        GGSock::Unserialize unserialize;
+        std::vector<std::vector<int32_t>> output;
+        if (unserialize(output, buffer) == false) return 128;
+        if (unserialize.nBytesAllocated < 10*100*sizeof(int32_t)) return 129;
+
+        GGSock::Unserialize limited;
+        limited.maxBytesAllocated = 2000;
+        if (limited(output, buffer) == true) return 130;
+    }
+
+    printf("Done!\n");
+
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include "ggsock/record-file.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+    bool exists(const std::string & path) {
+        FILE * f = fopen(path.c_str(), "rb");
+        if (f == nullptr) return false;
+        fclose(f);
+        return true;
+    }
+
+    std::vector<char> readAll(const std::string & path) {
+        std::vector<char> res;
+        FILE * f = fopen(path.c_str(), "rb");
+        if (f == nullptr) return res;
+        char buf[4096];
+        size_t n = 0;
+        while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+            res.insert(res.end(), buf, buf + n);
+        }
+        fclose(f);
+        return res;
+    }
+
+    void writeAll(const std::string & path, const std::vector<char> & content) {
+        FILE * f = fopen(path.c_str(), "wb");
+        if (f == nullptr) return;
+        fwrite(content.data(), 1, content.size(), f);
+        fclose(f);
+    }
+}
+
+int main() {
+    const std::string path = "test7.records";
+    const std::string pathCorrupt = "test7-corrupt.records";
+
+    remove(path.c_str());
+
+    {
+        // the records are written to a temporary file, which replaces path only once it is complete
+        GGSock::RecordFileWriter writer;
+        if (writer.open(path) == false) return 1;
+
+        for (int32_t i = 0; i < 100; ++i) {
+            if (writer.append(std::string("record ") + std::to_string(i)) == false) return 2;
+        }
+        if (writer.getNumRecords() != 100) return 3;
+
+        if (exists(path)) return 4;
+        if (exists(path + ".tmp") == false) return 5;
+
+        if (writer.close() == false) return 6;
+        if (exists(path) == false) return 7;
+        if (exists(path + ".tmp")) return 8;
+    }
+
+    {
+        GGSock::RecordFileReader reader;
+        if (reader.open(path) == false) return 11;
+        if (reader.getNumRecords() != 100) return 12;
+
+        for (int32_t i = 0; i < 100; ++i) {
+            std::string record;
+            if (reader.read(i, record) == false) return 13;
+            if (record != std::string("record ") + std::to_string(i)) return 14;
+        }
+
+        GGSock::StringView view;
+        if (reader.read(100, view) == true) return 15;
+        if (reader.getRecord(100).data != nullptr) return 16;
+    }
+
+    {
+        // while a new version is written, the previous one can still be read
+        GGSock::RecordFileWriter writer;
+        if (writer.open(path) == false) return 21;
+        if (writer.append(std::string("new")) == false) return 22;
+
+        GGSock::RecordFileReader reader;
+        if (reader.open(path) == false || reader.getNumRecords() != 100) return 23;
+        reader.close();
+
+        if (writer.close() == false) return 24;
+        if (reader.open(path) == false || reader.getNumRecords() != 1) return 25;
+    }
+
+    {
+        // corrupt footers and truncated files are rejected when opened
+        const auto content = readAll(path);
+        if (content.size() < 32) return 31;
+
+        GGSock::RecordFileReader reader;
+
+        auto corrupt = content;
+        corrupt.back() ^= 0x01;
+        writeAll(pathCorrupt, corrupt);
+        if (reader.open(pathCorrupt) == true) return 32;
+
+        // number of records past the table
+        corrupt = content;
+        corrupt[corrupt.size() - 20] += 1;
+        writeAll(pathCorrupt, corrupt);
+        if (reader.open(pathCorrupt) == true) return 33;
+
+        // table offset
+        corrupt = content;
+        corrupt[corrupt.size() - 12] ^= 0x40;
+        writeAll(pathCorrupt, corrupt);
+        if (reader.open(pathCorrupt) == true) return 34;
+
+        corrupt = content;
+        corrupt.resize(content.size() - 1);
+        writeAll(pathCorrupt, corrupt);
+        if (reader.open(pathCorrupt) == true) return 35;
+
+        writeAll(pathCorrupt, {});
+        if (reader.open(pathCorrupt) == true) return 36;
+
+        if (reader.open("test7-missing.records") == true) return 37;
+        if (reader.isOpen()) return 38;
+
+        // the original is still fine
+        writeAll(pathCorrupt, content);
+        if (reader.open(pathCorrupt) == false) return 39;
+    }
+
+    remove(path.c_str());
+    remove(pathCorrupt.c_str());
+
+    printf("Done!\n");
+
+    return 0;
+}
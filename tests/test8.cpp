@@ -0,0 +1,258 @@
+#include "ggsock/communicator.h"
+#include "ggsock/file-server.h"
+#include "ggsock/rate-limiter.h"
+#include "ggsock/serialization.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+    using TClock = std::chrono::steady_clock;
+
+    int64_t getElapsed_ms(TClock::time_point tStart) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(TClock::now() - tStart).count();
+    }
+
+    template <typename F>
+    bool waitFor(F && condition, int32_t timeout_ms) {
+        const auto tStart = TClock::now();
+        while (condition() == false) {
+            if (getElapsed_ms(tStart) >= timeout_ms) return false;
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+
+        return true;
+    }
+
+    bool connectPair(GGSock::Communicator & server, GGSock::Communicator & client, GGSock::TPort port) {
+        if (server.listen(port, 0) == false) return false;
+        if (client.connect("127.0.0.1", port, 100) == false) return false;
+
+        while (client.isConnected() == false) {}
+        while (server.isConnected() == false) {}
+
+        // let the hello exchange complete and the bucket refill
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        return true;
+    }
+}
+
+int main() {
+    {
+        // token bucket - burst, refill time, FIFO order of blocked owners, oversized messages and cancel
+        int a = 0;
+        int b = 0;
+
+        GGSock::RateLimiter limiter(10000, 1000);
+        if (limiter.getMaxRate() != 10000 || limiter.getMaxBurst() != 1000) return 1;
+
+        if (limiter.isAvailable(1000) == false) return 2;
+        if (limiter.acquire(&a, 1000) == false) return 3;
+        if (limiter.acquire(&a, 500) == true) return 4;
+
+        const int64_t wait_us = limiter.getTimeToAvailable_us(500);
+        if (wait_us < 40000 || wait_us > 50000) return 5;
+
+        // enough tokens for b, but a has been waiting first
+        std::this_thread::sleep_for(std::chrono::milliseconds(70));
+        if (limiter.acquire(&b, 100) == true) return 6;
+        if (limiter.acquire(&a, 500) == false) return 7;
+        if (limiter.acquire(&b, 100) == false) return 8;
+
+        // a message larger than the burst passes with a full bucket and is paid for by the next ones
+        std::this_thread::sleep_for(std::chrono::milliseconds(120));
+        if (limiter.acquire(&a, 5000) == false) return 9;
+        if (limiter.isAvailable(1)) return 10;
+        if (limiter.getTimeToAvailable_us(1000) < 400000) return 11;
+
+        // a cancelled owner no longer holds back the others
+        GGSock::RateLimiter limiter2(10000, 1000);
+        limiter2.consume(1000);
+        if (limiter2.acquire(&a, 100) == true) return 12;
+        limiter2.cancel(&a);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        if (limiter2.acquire(&b, 100) == false) return 13;
+    }
+
+    {
+        // per-connection limit - the burst goes out at once, after that the rate holds
+        const int64_t maxRate_Bps = 1000000;
+        const int64_t maxBurst_bytes = 100000;
+        const int32_t messageSize = 20000;
+
+        std::vector<char> buf(messageSize);
+        std::atomic<int64_t> nReceived { 0 };
+
+        GGSock::Communicator server(true);
+        server.setMessageCallback(42, [&](const char * , size_t ) {
+            ++nReceived;
+            return 0;
+        });
+
+        GGSock::Communicator client(true);
+        if (client.setRateLimit(maxRate_Bps, maxBurst_bytes) == false) return 21;
+
+        if (connectPair(server, client, 12353) == false) return 22;
+
+        auto tStart = TClock::now();
+        for (int i = 0; i < 4; ++i) {
+            if (client.send(42, buf.data(), buf.size()) == false) return 23;
+        }
+        if (waitFor([&]() { return nReceived == 4; }, 1000) == false) return 24;
+        if (getElapsed_ms(tStart) > 50) return 25;
+        if (client.getStats().nSendsThrottled != 0) return 26;
+
+        // at most one burst can go out faster than the rate
+        const int32_t nMessages = 45;
+        const int64_t nBytes = nMessages*messageSize;
+        const int64_t tMin_ms = 1000*(nBytes - maxBurst_bytes)/maxRate_Bps;
+        const int64_t tMax_ms = 1500*nBytes/maxRate_Bps;
+
+        tStart = TClock::now();
+        for (int i = 0; i < nMessages; ++i) {
+            if (client.send(42, buf.data(), buf.size()) == false) return 27;
+        }
+        if (waitFor([&]() { return nReceived == 4 + nMessages; }, 5000) == false) return 28;
+
+        const int64_t tElapsed_ms = getElapsed_ms(tStart);
+        if (tElapsed_ms < tMin_ms) return 29;
+        if (tElapsed_ms > tMax_ms) return 30;
+        if (client.getStats().nSendsThrottled == 0) return 31;
+
+        client.disconnect();
+        server.disconnect();
+    }
+
+    {
+        // two connections sharing one limiter get an equal share of it and together stay within the rate
+        const int64_t maxRate_Bps = 1000000;
+        const int64_t maxBurst_bytes = 50000;
+        const int32_t messageSize = 10000;
+        const int32_t duration_ms = 500;
+
+        std::vector<char> buf(messageSize);
+        std::atomic<int64_t> nReceived0 { 0 };
+        std::atomic<int64_t> nReceived1 { 0 };
+
+        auto limiter = std::make_shared<GGSock::RateLimiter>(maxRate_Bps, maxBurst_bytes);
+
+        GGSock::Communicator server0(true);
+        GGSock::Communicator server1(true);
+        server0.setMessageCallback(42, [&](const char * , size_t dataSize) {
+            nReceived0 += dataSize;
+            return 0;
+        });
+        server1.setMessageCallback(42, [&](const char * , size_t dataSize) {
+            nReceived1 += dataSize;
+            return 0;
+        });
+
+        GGSock::Communicator client0(true);
+        GGSock::Communicator client1(true);
+        if (client0.setSharedRateLimiter(limiter) == false) return 41;
+        if (client1.setSharedRateLimiter(limiter) == false) return 42;
+
+        if (connectPair(server0, client0, 12353) == false) return 43;
+        if (connectPair(server1, client1, 12354) == false) return 44;
+
+        const auto tStart = TClock::now();
+        while (getElapsed_ms(tStart) < duration_ms) {
+            while (client0.getNumPendingMessages() < 8) client0.send(42, buf.data(), buf.size());
+            while (client1.getNumPendingMessages() < 8) client1.send(42, buf.data(), buf.size());
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        const int64_t n0 = nReceived0;
+        const int64_t n1 = nReceived1;
+        const int64_t tElapsed_ms = getElapsed_ms(tStart);
+
+        if (n0 + n1 > maxRate_Bps*tElapsed_ms/1000 + maxBurst_bytes + 2*messageSize) return 45;
+        if (n0 + n1 < maxRate_Bps*duration_ms/2000) return 46;
+        if (n0 < 4*(n0 + n1)/10 || n1 < 4*(n0 + n1)/10) return 47;
+        if (client0.getStats().nSendsThrottled == 0 || client1.getStats().nSendsThrottled == 0) return 48;
+
+        client0.disconnect();
+        client1.disconnect();
+        server0.disconnect();
+        server1.disconnect();
+    }
+
+    {
+        // file server chunks are paced by the per-client and by the total limit
+        const int64_t maxRate_Bps = 1000000;
+        const int32_t fileSize = 400000;
+        const int32_t nChunks = 40;
+
+        for (int iLimit = 0; iLimit < 2; ++iLimit) {
+            GGSock::FileServer::Parameters parameters;
+            parameters.nWorkerThreads = 1;
+            parameters.nMaxClients = 1;
+            parameters.listenPort = 12355 + iLimit;
+            parameters.maxRatePerClient_Bps = iLimit == 0 ? maxRate_Bps : 0;
+            parameters.maxRateTotal_Bps = iLimit == 1 ? maxRate_Bps : 0;
+
+            GGSock::FileServer server;
+            if (server.init(parameters) == false) return 61;
+
+            GGSock::FileServer::FileData file;
+            file.info.uri = "test-uri";
+            file.info.filename = "test";
+            file.info.nChunks = nChunks;
+            file.data.resize(fileSize);
+            for (int i = 0; i < fileSize; ++i) {
+                file.data[i] = i%101;
+            }
+            if (server.addFile(std::move(file)) == false) return 62;
+            if (server.startListening() == false) return 63;
+
+            std::atomic<int32_t> nChunksReceived { 0 };
+            std::atomic<int32_t> nChunksInvalid { 0 };
+
+            GGSock::Communicator client(true);
+            client.setMessageCallback(GGSock::FileServer::MsgFileChunkResponse, [&](const char * dataBuffer, size_t dataSize) {
+                GGSock::FileServer::FileChunkResponseView data;
+
+                size_t offset = 0;
+                bool isValid = GGSock::Unserialize()(data, dataBuffer, dataSize, offset) && data.data.size == (size_t) data.pLen;
+                for (int64_t i = 0; isValid && i < data.pLen; ++i) {
+                    isValid = data.data.data[i] == (data.pStart + i)%101;
+                }
+                if (isValid == false) ++nChunksInvalid;
+
+                ++nChunksReceived;
+                return 0;
+            });
+
+            if (client.connect("127.0.0.1", parameters.listenPort, -1) == false) return 64;
+            if (waitFor([&]() { return client.isConnected(); }, 2000) == false) return 65;
+            std::this_thread::sleep_for(std::chrono::milliseconds(150));
+
+            const auto tStart = TClock::now();
+            for (int i = 0; i < nChunks; ++i) {
+                GGSock::FileServer::FileChunkRequestData data;
+                data.uri = "test-uri";
+                data.chunkId = i;
+                data.nChunksExpected = nChunks;
+
+                if (client.sendSerialized(GGSock::FileServer::MsgFileChunkRequest, data) == false) return 66;
+            }
+            if (waitFor([&]() { return nChunksReceived == nChunks; }, 5000) == false) return 67;
+
+            // the default burst is 100 ms worth of data, but at least 64 KiB
+            const int64_t tElapsed_ms = getElapsed_ms(tStart);
+            if (tElapsed_ms < 1000*(fileSize - maxRate_Bps/10)/maxRate_Bps) return 68;
+            if (tElapsed_ms > 1500*fileSize/maxRate_Bps) return 69;
+            if (nChunksInvalid != 0) return 70;
+
+            client.disconnect();
+        }
+    }
+
+    printf("Done!\n");
+
+    return 0;
+}
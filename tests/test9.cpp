@@ -0,0 +1,124 @@
+#include "ggsock/communicator.h"
+#include "ggsock/file-server.h"
+#include "ggsock/serialization.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+namespace {
+    template <typename F>
+    bool waitFor(F && condition, int32_t timeout_ms) {
+        const auto tEnd = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        while (condition() == false) {
+            if (std::chrono::steady_clock::now() >= tEnd) return false;
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+
+        return true;
+    }
+
+    GGSock::FileServer::FileData makeFile(const std::string & uri, int32_t size) {
+        GGSock::FileServer::FileData file;
+        file.info.uri = uri;
+        file.info.filename = uri + ".bin";
+        file.data.resize(size);
+        for (int32_t i = 0; i < size; ++i) {
+            file.data[i] = i%101;
+        }
+
+        return file;
+    }
+
+    bool isEqual(const GGSock::FileServer::TFileInfos & a, const GGSock::FileServer::TFileInfos & b) {
+        if (a.size() != b.size()) return false;
+        for (const auto & info : a) {
+            auto it = b.find(info.first);
+            if (it == b.end()) return false;
+            if (info.second.uri != it->second.uri ||
+                info.second.filename != it->second.filename ||
+                info.second.filesize != it->second.filesize ||
+                info.second.nChunks != it->second.nChunks) return false;
+        }
+
+        return true;
+    }
+}
+
+int main() {
+    {
+        // file infos on request and pushed after a file is added, with and without compression
+        for (int iCompression = 0; iCompression < 2; ++iCompression) {
+            GGSock::FileServer::Parameters parameters;
+            parameters.nWorkerThreads = 1;
+            parameters.nMaxClients = 1;
+            parameters.listenPort = 12357 + iCompression;
+            parameters.useCompression = iCompression == 1;
+
+            GGSock::FileServer server;
+            if (server.init(parameters) == false) return 1;
+            if (server.addFile(makeFile("test-uri-0", 64*1024)) == false) return 2;
+            if (server.startListening() == false) return 3;
+
+            std::mutex mutex;
+            int32_t nInfos = 0;
+            GGSock::FileServer::TFileInfos fileInfos;
+
+            auto getNumInfos = [&]() {
+                std::lock_guard<std::mutex> lock(mutex);
+                return nInfos;
+            };
+
+            GGSock::Communicator client(true);
+            if (parameters.useCompression) {
+                if (client.setCompression({}) == false) return 4;
+            }
+            client.setMessageCallback(GGSock::FileServer::MsgFileInfosResponse, [&](const char * dataBuffer, size_t dataSize) {
+                GGSock::FileServer::TFileInfos infos;
+
+                size_t offset = 0;
+                if (GGSock::Unserialize()(infos, dataBuffer, dataSize, offset) == false) return 0;
+
+                std::lock_guard<std::mutex> lock(mutex);
+                fileInfos = std::move(infos);
+                ++nInfos;
+                return 0;
+            });
+
+            if (client.connect("127.0.0.1", parameters.listenPort, -1) == false) return 5;
+            if (waitFor([&]() { return client.isConnected(); }, 2000) == false) return 6;
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+            if (client.send(GGSock::FileServer::MsgFileInfosRequest) == false) return 7;
+            if (waitFor([&]() { return getNumInfos() == 1; }, 2000) == false) return 8;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (fileInfos.size() != 1) return 9;
+                if (isEqual(fileInfos, server.getFileInfos()) == false) return 10;
+            }
+
+            // without another request
+            if (server.addFile(makeFile("test-uri-1", 1024)) == false) return 11;
+            if (waitFor([&]() { return getNumInfos() == 2; }, 2000) == false) return 12;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (fileInfos.size() != 2) return 13;
+                if (isEqual(fileInfos, server.getFileInfos()) == false) return 14;
+            }
+
+            if (server.clearFile("test-uri-0") == false) return 15;
+            if (waitFor([&]() { return getNumInfos() == 3; }, 2000) == false) return 16;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (fileInfos.size() != 1 || fileInfos.begin()->second.uri != "test-uri-1") return 17;
+            }
+
+            client.disconnect();
+        }
+    }
+
+    printf("Done!\n");
+
+    return 0;
+}
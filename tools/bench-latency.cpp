@@ -0,0 +1,271 @@
+#include "ggsock/communicator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ping-pong over loopback - each client keeps one message in flight and the server echoes it back
+
+using GGSock::Communicator;
+using TClock = std::chrono::steady_clock;
+
+namespace {
+    constexpr Communicator::TMessageType kMsgPing = 1;
+    constexpr Communicator::TMessageType kMsgPong = 2;
+
+    enum class Worker {
+        Manual,     // the benchmark thread calls update() on all connections
+        Sleep,      // own worker, WorkerMode::Sleep
+        BusyPoll,   // own worker, WorkerMode::BusyPoll
+    };
+
+    const char * toString(Worker worker) {
+        switch (worker) {
+            case Worker::Manual:   return "manual";
+            case Worker::Sleep:    return "sleep";
+            case Worker::BusyPoll: return "busypoll";
+        };
+        return "";
+    }
+
+    struct Connection {
+        std::unique_ptr<Communicator> server;
+        std::unique_ptr<Communicator> client;
+
+        std::vector<char> payload;
+
+        std::atomic<int32_t> nLeft { 0 };
+        TClock::time_point tSend;
+        std::vector<int64_t> rtt_ns;
+    };
+
+    struct Result {
+        int32_t size = 0;
+        int64_t nMessages = 0;
+        double p50_us = 0.0;
+        double p99_us = 0.0;
+        double p999_us = 0.0;
+        double max_us = 0.0;
+        double messagesPerSecond = 0.0;
+    };
+
+    double getPercentile_us(const std::vector<int64_t> & sorted, double p) {
+        if (sorted.empty()) {
+            return 0.0;
+        }
+
+        size_t idx = (size_t) (p*(sorted.size() - 1) + 0.5);
+        return 1e-3*sorted[idx];
+    }
+
+    std::vector<int32_t> parseSizes(const char * str) {
+        std::vector<int32_t> result;
+        std::string s = str;
+        size_t pos = 0;
+        while (pos < s.size()) {
+            size_t end = s.find(',', pos);
+            if (end == std::string::npos) {
+                end = s.size();
+            }
+            result.push_back(atoi(s.substr(pos, end - pos).c_str()));
+            pos = end + 1;
+        }
+        return result;
+    }
+
+    void update(std::vector<Connection> & connections) {
+        for (auto & connection : connections) {
+            connection.server->update();
+            connection.client->update();
+        }
+    }
+
+    bool connect(std::vector<Connection> & connections, Worker worker, int port) {
+        Communicator::WorkerParameters parameters;
+        parameters.mode = worker == Worker::BusyPoll ? Communicator::WorkerMode::BusyPoll : Communicator::WorkerMode::Sleep;
+
+        const bool startOwnWorker = worker != Worker::Manual;
+
+        for (int i = 0; i < (int) connections.size(); ++i) {
+            auto & connection = connections[i];
+
+            connection.server.reset(new Communicator(startOwnWorker, parameters));
+            connection.client.reset(new Communicator(startOwnWorker, parameters));
+
+            auto & server = *connection.server;
+            server.setMessageCallback(kMsgPing, [&server](const char * dataBuffer, size_t dataSize) {
+                server.send(kMsgPong, dataBuffer, dataSize);
+                return 0;
+            });
+
+            auto & client = connection.client;
+            client->setMessageCallback(kMsgPong, [&connection](const char * , size_t ) {
+                auto tNow = TClock::now();
+                connection.rtt_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(tNow - connection.tSend).count());
+
+                if (--connection.nLeft > 0) {
+                    connection.tSend = TClock::now();
+                    connection.client->send(kMsgPing, connection.payload.data(), connection.payload.size());
+                }
+                return 0;
+            });
+
+            if (server.listen(port + i, 0) == false || client->connect("127.0.0.1", port + i, 0) == false) {
+                fprintf(stderr, "Failed to set up connection %d on port %d\n", i, port + i);
+                return false;
+            }
+        }
+
+        auto tStart = TClock::now();
+        while (TClock::now() - tStart < std::chrono::seconds(10)) {
+            if (worker == Worker::Manual) {
+                update(connections);
+            } else {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            bool isConnected = true;
+            for (auto & connection : connections) {
+                isConnected = isConnected && connection.server->isConnected() && connection.client->isConnected();
+            }
+            if (isConnected) {
+                return true;
+            }
+        }
+
+        fprintf(stderr, "Timeout while connecting\n");
+        return false;
+    }
+
+    Result run(std::vector<Connection> & connections, Worker worker, int32_t size, int32_t nMessages, int32_t nWarmup) {
+        Result result;
+        result.size = size;
+
+        std::vector<int64_t> rtt_ns;
+        TClock::time_point tStart;
+
+        for (int pass = 0; pass < 2; ++pass) {
+            const bool isWarmup = pass == 0;
+
+            // the callbacks run on the workers, so the state is set up before the first message is sent
+            for (auto & connection : connections) {
+                connection.payload.assign(size, 'x');
+                connection.nLeft = isWarmup ? nWarmup : nMessages;
+                connection.rtt_ns.clear();
+                connection.rtt_ns.reserve(isWarmup ? nWarmup : nMessages);
+            }
+
+            tStart = TClock::now();
+            for (auto & connection : connections) {
+                if (connection.nLeft == 0) {
+                    continue;
+                }
+                connection.tSend = TClock::now();
+                connection.client->send(kMsgPing, connection.payload.data(), connection.payload.size());
+            }
+
+            while (true) {
+                if (worker == Worker::Manual) {
+                    update(connections);
+                } else {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+
+                bool isDone = true;
+                for (auto & connection : connections) {
+                    isDone = isDone && (connection.client->isConnected() == false || connection.nLeft == 0);
+                }
+                if (isDone) {
+                    break;
+                }
+            }
+        }
+
+        const double elapsed_s = std::chrono::duration<double>(TClock::now() - tStart).count();
+
+        for (auto & connection : connections) {
+            rtt_ns.insert(rtt_ns.end(), connection.rtt_ns.begin(), connection.rtt_ns.end());
+        }
+        std::sort(rtt_ns.begin(), rtt_ns.end());
+
+        result.nMessages = (int64_t) rtt_ns.size();
+        result.p50_us = getPercentile_us(rtt_ns, 0.50);
+        result.p99_us = getPercentile_us(rtt_ns, 0.99);
+        result.p999_us = getPercentile_us(rtt_ns, 0.999);
+        result.max_us = rtt_ns.empty() ? 0.0 : 1e-3*rtt_ns.back();
+        result.messagesPerSecond = elapsed_s > 0.0 ? rtt_ns.size()/elapsed_s : 0.0;
+
+        return result;
+    }
+}
+
+int main(int argc, char ** argv) {
+    if (argc < 2) {
+        printf("Usage: %s port [sizes] [connections] [messages] [worker] [output]\n", argv[0]);
+        printf("    sizes       - comma-separated message sizes in bytes, default: 16,256,4096,65536\n");
+        printf("    connections - number of concurrent connections, default: 1\n");
+        printf("    messages    - round trips per connection and size, default: 10000\n");
+        printf("    worker      - manual, sleep or busypoll, default: manual\n");
+        printf("    output      - file for the JSON results, default: stdout\n");
+        return -1;
+    }
+
+    const int port = atoi(argv[1]);
+    const std::vector<int32_t> sizes = parseSizes(argc > 2 ? argv[2] : "16,256,4096,65536");
+    const int32_t nConnections = (std::max)(1, argc > 3 ? atoi(argv[3]) : 1);
+    const int32_t nMessages = (std::max)(1, argc > 4 ? atoi(argv[4]) : 10000);
+    const std::string workerName = argc > 5 ? argv[5] : "manual";
+    const char * output = argc > 6 ? argv[6] : nullptr;
+
+    Worker worker = Worker::Manual;
+    if (workerName == "sleep") {
+        worker = Worker::Sleep;
+    } else if (workerName == "busypoll") {
+        worker = Worker::BusyPoll;
+    } else if (workerName != "manual") {
+        fprintf(stderr, "Unknown worker '%s'\n", workerName.c_str());
+        return -1;
+    }
+
+    std::vector<Connection> connections(nConnections);
+    if (connect(connections, worker, port) == false) {
+        return -1;
+    }
+
+    std::vector<Result> results;
+    for (auto size : sizes) {
+        results.push_back(run(connections, worker, size, nMessages, (std::min)(nMessages, 100)));
+
+        const auto & r = results.back();
+        fprintf(stderr, "size = %8d, p50 = %9.1f us, p99 = %9.1f us, p999 = %9.1f us, max = %9.1f us, %10.0f msg/s\n",
+                r.size, r.p50_us, r.p99_us, r.p999_us, r.max_us, r.messagesPerSecond);
+    }
+
+    FILE * fout = output ? fopen(output, "w") : stdout;
+    if (fout == nullptr) {
+        fprintf(stderr, "Failed to open '%s'\n", output);
+        return -1;
+    }
+
+    fprintf(fout, "{\"benchmark\": \"latency\", \"worker\": \"%s\", \"connections\": %d, \"messages\": %d, \"results\": [",
+            toString(worker), nConnections, nMessages);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto & r = results[i];
+        fprintf(fout, "%s\n  {\"size\": %d, \"messages\": %lld, \"p50_us\": %.2f, \"p99_us\": %.2f, \"p999_us\": %.2f, \"max_us\": %.2f, \"msgs_per_s\": %.1f}",
+                i == 0 ? "" : ",", r.size, (long long) r.nMessages, r.p50_us, r.p99_us, r.p999_us, r.max_us, r.messagesPerSecond);
+    }
+    fprintf(fout, "\n]}\n");
+
+    if (fout != stdout) {
+        fclose(fout);
+    }
+
+    return 0;
+}
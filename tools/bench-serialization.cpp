@@ -0,0 +1,278 @@
+#include "ggsock/file-server.h"
+#include "ggsock/serialization.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+// ns/op, GB/s and heap allocations per op for Serialize and Unserialize of whole messages
+// serialize reuses the output buffer, unserialize decodes into a new object every time
+
+namespace {
+    std::atomic<uint64_t> g_nAllocations { 0 };
+}
+
+void * operator new(size_t nBytes) {
+    g_nAllocations.fetch_add(1, std::memory_order_relaxed);
+
+    void * p = malloc(nBytes > 0 ? nBytes : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void * p) noexcept {
+    free(p);
+}
+
+void operator delete(void * p, size_t ) noexcept {
+    free(p);
+}
+
+using GGSock::Encoding;
+using GGSock::FileServer;
+using GGSock::SerializationBuffer;
+using TClock = std::chrono::steady_clock;
+
+namespace {
+    struct Result {
+        std::string name;
+        const char * op = "";
+        size_t size = 0;
+        int64_t nIterations = 0;
+        double ns_per_op = 0.0;
+        double GBps = 0.0;
+        double allocsPerOp = 0.0;
+    };
+
+    // keeps the results of the measured operations alive
+    volatile uint64_t g_sink = 0;
+
+    // doubles the batch of iterations between clock reads until the minimum time has passed
+    template <typename F>
+    Result measure(const std::string & name, const char * op, size_t size, int32_t minTime_ms, F && f) {
+        Result result;
+        result.name = name;
+        result.op = op;
+        result.size = size;
+
+        g_sink += f();
+
+        int64_t n = 0;
+        int64_t batch = 1;
+
+        const uint64_t nAllocations0 = g_nAllocations.load();
+        const auto tStart = TClock::now();
+
+        double elapsed_s = 0.0;
+        while (true) {
+            uint64_t sink = 0;
+            for (int64_t i = 0; i < batch; ++i) {
+                sink += f();
+            }
+            g_sink += sink;
+            n += batch;
+
+            elapsed_s = std::chrono::duration<double>(TClock::now() - tStart).count();
+            if (elapsed_s*1000.0 >= minTime_ms) {
+                break;
+            }
+            batch = (std::min)(2*batch, (int64_t) 1 << 16);
+        }
+
+        result.nIterations = n;
+        result.ns_per_op = 1e9*elapsed_s/n;
+        result.GBps = 1e-9*size*n/elapsed_s;
+        result.allocsPerOp = double(g_nAllocations.load() - nAllocations0)/n;
+
+        return result;
+    }
+
+    template <typename T>
+    void bench(std::vector<Result> & results, const std::string & name, const T & obj, int32_t minTime_ms, Encoding encoding = Encoding::Fixed) {
+        SerializationBuffer buffer;
+        {
+            GGSock::Serialize op;
+            op.encoding = encoding;
+            op(obj, buffer);
+        }
+
+        results.push_back(measure(name, "serialize", buffer.size(), minTime_ms, [&]() {
+            GGSock::Serialize op;
+            op.encoding = encoding;
+            return op(obj, buffer) ? buffer.size() : 0;
+        }));
+
+        results.push_back(measure(name, "unserialize", buffer.size(), minTime_ms, [&]() {
+            T tmp;
+            GGSock::Unserialize op;
+            op.encoding = encoding;
+            return op(tmp, buffer) ? op.nBytesProcessed : 0;
+        }));
+
+        for (size_t i = results.size() - 2; i < results.size(); ++i) {
+            const auto & r = results[i];
+            fprintf(stderr, "%-32s %-12s size = %10zu, %12.1f ns/op, %8.3f GB/s, %8.2f allocs/op\n",
+                    r.name.c_str(), r.op, r.size, r.ns_per_op, r.GBps, r.allocsPerOp);
+        }
+    }
+
+    std::string formatSize(size_t nBytes) {
+        if (nBytes >= 1024*1024) return std::to_string(nBytes/(1024*1024)) + " MiB";
+        if (nBytes >= 1024) return std::to_string(nBytes/1024) + " KiB";
+        return std::to_string(nBytes) + " B";
+    }
+}
+
+int main(int argc, char ** argv) {
+    if (argc > 3) {
+        printf("Usage: %s [min_time_ms] [output]\n", argv[0]);
+        printf("    min_time_ms - minimum time per measurement, default: 200\n");
+        printf("    output      - file for the JSON results, default: stdout\n");
+        return -1;
+    }
+
+    const int32_t minTime_ms = (std::max)(1, argc > 1 ? atoi(argv[1]) : 200);
+    const char * output = argc > 2 ? argv[2] : nullptr;
+
+    std::vector<Result> results;
+
+    // fundamentals
+    bench(results, "int32_t", (int32_t) 12345, minTime_ms);
+    bench(results, "int64_t", (int64_t) 1234567890123, minTime_ms);
+    bench(results, "double", 3.14159, minTime_ms);
+
+    // strings
+    bench(results, "std::string 16 B", std::string(16, 'x'), minTime_ms);
+    bench(results, "std::string 1 KiB", std::string(1024, 'x'), minTime_ms);
+    {
+        const std::string str(1024, 'x');
+        GGSock::StringView view;
+        view.data = str.data();
+        view.size = str.size();
+        bench(results, "StringView 1 KiB", view, minTime_ms);
+    }
+
+    // pair, array, shared_ptr
+    bench(results, "std::pair<int32_t, std::string>", std::make_pair((int32_t) 42, std::string(32, 'x')), minTime_ms);
+    {
+        std::array<double, 1024> values;
+        for (size_t i = 0; i < values.size(); ++i) {
+            values[i] = 0.5*i;
+        }
+        bench(results, "std::array<double, 1024>", values, minTime_ms);
+
+        auto shared = std::make_shared<std::vector<int32_t>>(64*1024, 7);
+        bench(results, "std::shared_ptr<std::vector<int32_t>> 64K", shared, minTime_ms);
+    }
+
+    // binary blobs
+    for (size_t size = 1024; size <= 64*1024*1024; size *= 16) {
+        FileServer::TBinaryBlob blob(size);
+        for (size_t i = 0; i < size; ++i) {
+            blob[i] = (char) (i%251);
+        }
+
+        bench(results, "TBinaryBlob " + formatSize(size), blob, minTime_ms);
+        if (size == 256*1024) {
+            GGSock::BlobView view;
+            view.data = blob.data();
+            view.size = blob.size();
+            bench(results, "BlobView " + formatSize(size), view, minTime_ms);
+        }
+    }
+
+    // vectors of integers, fixed and varint
+    {
+        std::vector<int32_t> values(1024*1024);
+        for (size_t i = 0; i < values.size(); ++i) {
+            values[i] = (int32_t) (i%1000) - 500;
+        }
+
+        bench(results, "std::vector<int32_t> 1M", values, minTime_ms);
+        bench(results, "std::vector<int32_t> 1M varint", values, minTime_ms, Encoding::Varint);
+    }
+
+    // maps with values other than FileInfo
+    {
+        std::map<int32_t, double> numbers;
+        for (int32_t i = 0; i < 10000; ++i) {
+            numbers[i] = 0.25*i;
+        }
+
+        bench(results, "std::map<int32_t, double> 10000", numbers, minTime_ms);
+        bench(results, "std::map<int32_t, double> 10000 varint", numbers, minTime_ms, Encoding::Varint);
+
+        std::map<std::string, std::vector<int32_t>> lists;
+        for (int32_t i = 0; i < 1000; ++i) {
+            lists["list-" + std::to_string(i)] = std::vector<int32_t>(64, i);
+        }
+
+        bench(results, "std::map<std::string, std::vector<int32_t>> 1000", lists, minTime_ms);
+    }
+
+    // file server messages
+    {
+        FileServer::TFileInfos fileInfos;
+        for (int i = 0; i < 1000; ++i) {
+            auto & info = fileInfos[i];
+            info.uri = "file-server-uri-" + std::to_string(i);
+            info.filename = "/path/to/the/shared/file-" + std::to_string(i) + ".bin";
+            info.filesize = 1024*i;
+            info.nChunks = 128;
+        }
+
+        bench(results, "TFileInfos 1000", fileInfos, minTime_ms);
+        bench(results, "TFileInfos 1000 varint", fileInfos, minTime_ms, Encoding::Varint);
+    }
+    {
+        FileServer::FileChunkResponseData chunk;
+        chunk.uri = "file-server-uri-0";
+        chunk.chunkId = 17;
+        chunk.data.assign(64*1024, 'x');
+        chunk.pStart = 17*64*1024;
+        chunk.pLen = 64*1024;
+
+        bench(results, "FileChunkResponseData 64 KiB", chunk, minTime_ms);
+
+        FileServer::FileChunkResponseView view;
+        view.uri = chunk.uri;
+        view.chunkId = chunk.chunkId;
+        view.data.data = chunk.data.data();
+        view.data.size = chunk.data.size();
+        view.pStart = chunk.pStart;
+        view.pLen = chunk.pLen;
+
+        bench(results, "FileChunkResponseView 64 KiB", view, minTime_ms);
+    }
+
+    FILE * fout = output ? fopen(output, "w") : stdout;
+    if (fout == nullptr) {
+        fprintf(stderr, "Failed to open '%s'\n", output);
+        return -1;
+    }
+
+    fprintf(fout, "{\"benchmark\": \"serialization\", \"min_time_ms\": %d, \"results\": [", minTime_ms);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto & r = results[i];
+        fprintf(fout, "%s\n  {\"name\": \"%s\", \"op\": \"%s\", \"size\": %zu, \"iterations\": %lld, \"ns_per_op\": %.2f, \"gb_per_s\": %.4f, \"allocs_per_op\": %.3f}",
+                i == 0 ? "" : ",", r.name.c_str(), r.op, r.size, (long long) r.nIterations, r.ns_per_op, r.GBps, r.allocsPerOp);
+    }
+    fprintf(fout, "\n]}\n");
+
+    if (fout != stdout) {
+        fclose(fout);
+    }
+
+    return 0;
+}
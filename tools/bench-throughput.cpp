@@ -0,0 +1,369 @@
+#include "ggsock/communicator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+// one-way streaming over loopback - the clients keep their send queues filled and the servers count what arrives
+// both ends of every connection live in this process, so the memory figures cover a client and a server
+
+using GGSock::Communicator;
+using TClock = std::chrono::steady_clock;
+
+namespace {
+    constexpr Communicator::TMessageType kMsgData = 1;
+
+    // bytes queued across all connections - larger combinations of message size and connection count are skipped
+    constexpr int64_t kMaxInFlight_bytes = 256*1024*1024;
+    constexpr int32_t kMaxInFlightMessages = 127;
+
+    enum class Worker {
+        Manual,     // the benchmark thread calls update() on the clients and a second thread on the servers
+        Sleep,      // own worker, WorkerMode::Sleep
+        BusyPoll,   // own worker, WorkerMode::BusyPoll
+    };
+
+    const char * toString(Worker worker) {
+        switch (worker) {
+            case Worker::Manual:   return "manual";
+            case Worker::Sleep:    return "sleep";
+            case Worker::BusyPoll: return "busypoll";
+        };
+        return "";
+    }
+
+    struct Connection {
+        std::unique_ptr<Communicator> server;
+        std::unique_ptr<Communicator> client;
+
+        uint64_t nMessagesSent = 0;
+        std::atomic<uint64_t> nMessagesReceived { 0 };
+        std::atomic<uint64_t> nBytesReceived { 0 };
+    };
+
+    struct Result {
+        int32_t nConnections = 0;
+        int32_t size = 0;
+        bool isSkipped = false;
+
+        uint64_t nMessages = 0;
+        uint64_t nBytes = 0;
+        uint64_t nUpdates = 0;
+        double elapsed_s = 0.0;
+        double cpu_s = 0.0;
+        int64_t rssPerConnection_bytes = 0;
+        int64_t heapPerConnection_bytes = 0;
+
+        double getMBps() const { return elapsed_s > 0.0 ? 1e-6*nBytes/elapsed_s : 0.0; }
+        double getMessagesPerSecond() const { return elapsed_s > 0.0 ? nMessages/elapsed_s : 0.0; }
+        double getCpuPerGB() const { return nBytes > 0 ? cpu_s/(1e-9*nBytes) : 0.0; }
+    };
+
+    std::vector<int32_t> parseList(const char * str) {
+        std::vector<int32_t> result;
+        std::string s = str;
+        size_t pos = 0;
+        while (pos < s.size()) {
+            size_t end = s.find(',', pos);
+            if (end == std::string::npos) {
+                end = s.size();
+            }
+            result.push_back(atoi(s.substr(pos, end - pos).c_str()));
+            pos = end + 1;
+        }
+        return result;
+    }
+
+    // resident set size of the process, 0 where not available
+    int64_t getRSS() {
+        int64_t result = 0;
+#ifdef __linux__
+        FILE * fin = fopen("/proc/self/statm", "r");
+        if (fin) {
+            long long nPagesTotal = 0;
+            long long nPagesResident = 0;
+            if (fscanf(fin, "%lld %lld", &nPagesTotal, &nPagesResident) == 2) {
+                result = nPagesResident*sysconf(_SC_PAGESIZE);
+            }
+            fclose(fin);
+        }
+#endif
+        return result;
+    }
+
+    // every connection needs two descriptors in this process
+    void raiseDescriptorLimit() {
+#ifndef _WIN32
+        rlimit limit;
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+            limit.rlim_cur = limit.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &limit);
+        }
+#endif
+    }
+
+    void updateClients(std::vector<Connection> & connections) {
+        for (auto & connection : connections) {
+            connection.client->update();
+        }
+    }
+
+    // sending a frame blocks until it is written, so the receiving ends are updated on their own thread
+    struct ServerUpdater {
+        ServerUpdater(std::vector<Connection> & connections, Worker worker) {
+            if (worker != Worker::Manual) {
+                return;
+            }
+
+            isRunning = true;
+            thread = std::thread([this, &connections]() {
+                while (isRunning) {
+                    for (auto & connection : connections) {
+                        if (connection.server) {
+                            connection.server->update();
+                        }
+                    }
+                }
+            });
+        }
+
+        ~ServerUpdater() {
+            isRunning = false;
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+
+        std::atomic<bool> isRunning { false };
+        std::thread thread;
+    };
+
+    bool setup(std::vector<Connection> & connections, Worker worker, int port) {
+        Communicator::WorkerParameters parameters;
+        parameters.mode = worker == Worker::BusyPoll ? Communicator::WorkerMode::BusyPoll : Communicator::WorkerMode::Sleep;
+
+        const bool startOwnWorker = worker != Worker::Manual;
+
+        for (int i = 0; i < (int) connections.size(); ++i) {
+            auto & connection = connections[i];
+
+            connection.server.reset(new Communicator(startOwnWorker, parameters));
+            connection.client.reset(new Communicator(startOwnWorker, parameters));
+
+            connection.server->setMessageCallback(kMsgData, [&connection](const char * , size_t dataSize) {
+                ++connection.nMessagesReceived;
+                connection.nBytesReceived += dataSize;
+                return 0;
+            });
+
+            if (connection.server->listen(port + i, 0) == false || connection.client->connect("127.0.0.1", port + i, 0) == false) {
+                fprintf(stderr, "Failed to set up connection %d on port %d\n", i, port + i);
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool waitForConnections(std::vector<Connection> & connections, Worker worker) {
+        auto tStart = TClock::now();
+        while (TClock::now() - tStart < std::chrono::seconds(30)) {
+            if (worker == Worker::Manual) {
+                updateClients(connections);
+            } else {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            bool isConnected = true;
+            for (auto & connection : connections) {
+                isConnected = isConnected && connection.server->isConnected() && connection.client->isConnected();
+            }
+            if (isConnected) {
+                return true;
+            }
+        }
+
+        fprintf(stderr, "Timeout while connecting\n");
+        return false;
+    }
+
+    Result run(std::vector<Connection> & connections, Worker worker, int32_t size, int32_t duration_ms, int64_t rssBaseline) {
+        const int32_t nConnections = (int32_t) connections.size();
+
+        Result result;
+        result.nConnections = nConnections;
+        result.size = size;
+
+        const int64_t nInFlight = kMaxInFlight_bytes/((int64_t) (std::max)(size, 1)*nConnections);
+        if (nInFlight < 1) {
+            result.isSkipped = true;
+            return result;
+        }
+
+        const int32_t maxInFlight = (int32_t) (std::min)(nInFlight, (int64_t) kMaxInFlightMessages);
+        const std::vector<char> payload(size, 'x');
+
+        for (auto & connection : connections) {
+            connection.nMessagesSent = 0;
+            connection.nMessagesReceived = 0;
+            connection.nBytesReceived = 0;
+        }
+
+        const auto tStart = TClock::now();
+        const auto tEnd = tStart + std::chrono::milliseconds(duration_ms);
+        const std::clock_t cpuStart = std::clock();
+
+        while (TClock::now() < tEnd) {
+            for (auto & connection : connections) {
+                while (connection.client->getNumPendingMessages() < maxInFlight &&
+                       connection.client->send(kMsgData, payload.data(), payload.size())) {
+                    ++connection.nMessagesSent;
+                }
+            }
+
+            if (worker == Worker::Manual) {
+                updateClients(connections);
+                ++result.nUpdates;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+
+        result.elapsed_s = std::chrono::duration<double>(TClock::now() - tStart).count();
+        result.cpu_s = double(std::clock() - cpuStart)/CLOCKS_PER_SEC;
+
+        int64_t heap = 0;
+        for (auto & connection : connections) {
+            result.nMessages += connection.nMessagesReceived;
+            result.nBytes += connection.nBytesReceived;
+            heap += connection.server->getMemoryUsage() + connection.client->getMemoryUsage();
+        }
+
+        result.rssPerConnection_bytes = (getRSS() - rssBaseline)/nConnections;
+        result.heapPerConnection_bytes = heap/nConnections;
+
+        // drain the queues, so the next run starts clean
+        auto tDrain = TClock::now();
+        while (TClock::now() - tDrain < std::chrono::seconds(30)) {
+            bool isDone = true;
+            for (auto & connection : connections) {
+                isDone = isDone && (connection.client->isConnected() == false || connection.nMessagesReceived == connection.nMessagesSent);
+            }
+            if (isDone) {
+                break;
+            }
+
+            if (worker == Worker::Manual) {
+                updateClients(connections);
+            } else {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        return result;
+    }
+}
+
+int main(int argc, char ** argv) {
+    if (argc < 2) {
+        printf("Usage: %s port [sizes] [connections] [duration] [worker] [output]\n", argv[0]);
+        printf("    sizes       - comma-separated message sizes in bytes, default: 16,256,4096,65536,1048576,67108864\n");
+        printf("    connections - comma-separated connection counts, default: 1,10,100,1000,10000\n");
+        printf("    duration    - measurement time per size and connection count in ms, default: 1000\n");
+        printf("    worker      - manual, sleep or busypoll, default: manual\n");
+        printf("    output      - file for the JSON results, default: stdout\n");
+        return -1;
+    }
+
+    const int port = atoi(argv[1]);
+    const std::vector<int32_t> sizes = parseList(argc > 2 ? argv[2] : "16,256,4096,65536,1048576,67108864");
+    const std::vector<int32_t> connectionCounts = parseList(argc > 3 ? argv[3] : "1,10,100,1000,10000");
+    const int32_t duration_ms = (std::max)(1, argc > 4 ? atoi(argv[4]) : 1000);
+    const std::string workerName = argc > 5 ? argv[5] : "manual";
+    const char * output = argc > 6 ? argv[6] : nullptr;
+
+    Worker worker = Worker::Manual;
+    if (workerName == "sleep") {
+        worker = Worker::Sleep;
+    } else if (workerName == "busypoll") {
+        worker = Worker::BusyPoll;
+    } else if (workerName != "manual") {
+        fprintf(stderr, "Unknown worker '%s'\n", workerName.c_str());
+        return -1;
+    }
+
+    raiseDescriptorLimit();
+
+    std::vector<Result> results;
+    for (auto nConnections : connectionCounts) {
+        nConnections = (std::max)(1, nConnections);
+
+        const int64_t rssBaseline = getRSS();
+
+        std::vector<Connection> connections(nConnections);
+        const bool isSetup = setup(connections, worker, port);
+
+        ServerUpdater serverUpdater(connections, worker);
+        const bool isConnected = isSetup && waitForConnections(connections, worker);
+
+        for (auto size : sizes) {
+            Result result;
+            if (isConnected) {
+                result = run(connections, worker, size, duration_ms, rssBaseline);
+            } else {
+                result.nConnections = nConnections;
+                result.size = size;
+                result.isSkipped = true;
+            }
+            results.push_back(result);
+
+            const auto & r = results.back();
+            if (r.isSkipped) {
+                fprintf(stderr, "connections = %6d, size = %9d, skipped\n", r.nConnections, r.size);
+                continue;
+            }
+            fprintf(stderr, "connections = %6d, size = %9d, %10.1f MB/s, %10.0f msg/s, %6.2f cpu s/GB, %8lld B/conn rss, %8lld B/conn heap\n",
+                    r.nConnections, r.size, r.getMBps(), r.getMessagesPerSecond(), r.getCpuPerGB(),
+                    (long long) r.rssPerConnection_bytes, (long long) r.heapPerConnection_bytes);
+        }
+    }
+
+    FILE * fout = output ? fopen(output, "w") : stdout;
+    if (fout == nullptr) {
+        fprintf(stderr, "Failed to open '%s'\n", output);
+        return -1;
+    }
+
+    fprintf(fout, "{\"benchmark\": \"throughput\", \"worker\": \"%s\", \"duration_ms\": %d, \"results\": [", toString(worker), duration_ms);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto & r = results[i];
+        fprintf(fout, "%s\n  {\"connections\": %d, \"size\": %d, \"skipped\": %s", i == 0 ? "" : ",", r.nConnections, r.size, r.isSkipped ? "true" : "false");
+        if (r.isSkipped == false) {
+            fprintf(fout, ", \"messages\": %llu, \"bytes\": %llu, \"updates\": %llu, \"elapsed_s\": %.3f, \"MB_per_s\": %.2f, \"msgs_per_s\": %.1f, "
+                    "\"cpu_s_per_GB\": %.3f, \"rss_per_connection_bytes\": %lld, \"heap_per_connection_bytes\": %lld",
+                    (unsigned long long) r.nMessages, (unsigned long long) r.nBytes, (unsigned long long) r.nUpdates, r.elapsed_s,
+                    r.getMBps(), r.getMessagesPerSecond(), r.getCpuPerGB(),
+                    (long long) r.rssPerConnection_bytes, (long long) r.heapPerConnection_bytes);
+        }
+        fprintf(fout, "}");
+    }
+    fprintf(fout, "\n]}\n");
+
+    if (fout != stdout) {
+        fclose(fout);
+    }
+
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include "ggsock/communicator.h"
+#include "ggsock/coroutines.h"
+#include "ggsock/file-server.h"
+#include "ggsock/serialization.h"
+
+#include <cstring>
+#include <map>
+
+using GGSock::FileServer;
+
+GGSock::Co::Task<bool> downloadAll(GGSock::Co::Connection & connection, std::map<FileServer::TURI, FileServer::FileData> & files) {
+    co_await connection.send(FileServer::MsgFileInfosRequest);
+
+    auto response = co_await connection.receive(FileServer::MsgFileInfosResponse, 5000);
+    if (response.isValid == false) {
+        printf("Timeout waiting for the file infos\n");
+        co_return false;
+    }
+
+    FileServer::TFileInfos fileInfos;
+    GGSock::Unserialize()(fileInfos, response.data);
+
+    int nChunks = 0;
+    for (const auto & info : fileInfos) {
+        printf("    - %s : %s (size = %d, chunks = %d)\n", info.second.uri.c_str(), info.second.filename.c_str(), (int) info.second.filesize, (int) info.second.nChunks);
+        files[info.second.uri].info = info.second;
+        files[info.second.uri].data.resize(info.second.filesize);
+
+        for (int i = 0; i < info.second.nChunks; ++i) {
+            FileServer::FileChunkRequestData request;
+            request.uri = info.second.uri;
+            request.chunkId = i;
+            request.nChunksHave = 0;
+            request.nChunksExpected = info.second.nChunks;
+
+            GGSock::SerializationBuffer buffer;
+            GGSock::Serialize()(request, buffer);
+            if (co_await connection.send(FileServer::MsgFileChunkRequest, buffer.data(), (GGSock::Communicator::TBufferSize) buffer.size()) == false) {
+                co_return false;
+            }
+            ++nChunks;
+        }
+    }
+
+    for (int i = 0; i < nChunks; ++i) {
+        auto chunk = co_await connection.receive(FileServer::MsgFileChunkResponse, 5000);
+        if (chunk.isValid == false) {
+            printf("Timeout waiting for chunk %d / %d\n", i, nChunks);
+            co_return false;
+        }
+
+        FileServer::FileChunkResponseView data;
+        if (GGSock::Unserialize()(data, chunk.data) == false) {
+            co_return false;
+        }
+
+        auto & file = files[data.uri];
+        if (data.pStart < 0 || data.pLen < 0 || data.pLen > (int64_t) data.data.size || data.pStart + data.pLen > (int64_t) file.data.size()) {
+            co_return false;
+        }
+        std::memcpy(file.data.data() + data.pStart, data.data.data, data.pLen);
+    }
+
+    co_return true;
+}
+
+GGSock::Co::Task<> run(GGSock::Co::Scheduler & scheduler, GGSock::Co::Connection & connection, std::string ip, int port, int & result) {
+    printf("Connecting to %s : %d\n", ip.c_str(), port);
+    if (co_await connection.connect(ip, port, 5000) == false) {
+        printf("Failed to connect\n");
+        result = -2;
+        scheduler.stop();
+        co_return;
+    }
+
+    std::map<FileServer::TURI, FileServer::FileData> files;
+    if (co_await downloadAll(connection, files) == false) {
+        result = -3;
+        scheduler.stop();
+        co_return;
+    }
+
+    for (const auto & file : files) {
+        bool ok = true;
+        if (file.first == "test-uri-0") {
+            for (int i = 0; i < (int) file.second.data.size(); ++i) ok &= file.second.data[i] == i%101;
+        }
+        if (file.first == "test-uri-1") {
+            for (int i = 0; i < (int) file.second.data.size(); ++i) ok &= file.second.data[i] == (3*i + 1)%103;
+        }
+        printf("Received '%s', %d bytes - %s\n", file.first.c_str(), (int) file.second.data.size(), ok ? "ok" : "corrupted");
+        if (ok == false) {
+            result = -4;
+        }
+    }
+
+    scheduler.stop();
+}
+
+int main(int argc, char ** argv) {
+    printf("Usage: %s ip port\n", argv[0]);
+    if (argc < 3) {
+        return -1;
+    }
+
+    std::string ip = argv[1];
+    int port = atoi(argv[2]);
+
+    GGSock::Communicator client(true);
+    client.setErrorCallback([](GGSock::Communicator::TErrorCode code) {
+        printf("Disconnected with code = %d\n", code);
+    });
+
+    GGSock::Co::Scheduler scheduler;
+    GGSock::Co::Connection connection(scheduler, client, { FileServer::MsgFileInfosResponse, FileServer::MsgFileChunkResponse });
+
+    int result = 0;
+    GGSock::Co::spawn(scheduler, run(scheduler, connection, ip, port, result));
+
+    scheduler.run();
+
+    return result;
+}
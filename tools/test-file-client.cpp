@@ -55,13 +55,15 @@ int main(int argc, char ** argv) {
     });
 
     client.setMessageCallback(GGSock::FileServer::MsgFileChunkResponse, [&](const char * dataBuffer, size_t dataSize) {
-        GGSock::FileServer::FileChunkResponseData data;
+        GGSock::FileServer::FileChunkResponseView data;
 
         size_t offset = 0;
-        GGSock::Unserialize()(data, dataBuffer, dataSize, offset);
+        if (GGSock::Unserialize()(data, dataBuffer, dataSize, offset) == false) {
+            return 0;
+        }
 
-        printf("Received chunk %d for file '%s', size = %d\n", data.chunkId, data.uri.c_str(), (int) data.data.size());
-        std::memcpy(files[data.uri].data.data() + data.pStart, data.data.data(), data.pLen);
+        printf("Received chunk %d for file '%s', size = %d\n", data.chunkId, data.uri.c_str(), (int) data.data.size);
+        std::memcpy(files[data.uri].data.data() + data.pStart, data.data.data, data.pLen);
 
         if (data.chunkId == files[data.uri].info.nChunks - 1) {
             if (data.uri == "test-uri-0") {